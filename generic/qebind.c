@@ -83,6 +83,11 @@ typedef struct BindValue {
 	int detail; /* Misc. other information, or 0 for none */
 	ClientData object;
 	char *command;
+	Tcl_Obj *cmdObj; /* The command as an object when it has no %-chars
+					  * or was bound with -args, otherwise NULL. Keeping
+					  * it lets Tcl reuse the compiled script. */
+	char *argChars; /* %-chars whose values are passed to cmdObj as
+					 * extra arguments, or NULL for a plain script */
 	int specific; /* For less-specific events (detail=0), this is 1
 				   * if a more-specific event (detail>0) exists. */
 	struct BindValue *nextValue; /* list of BindValues matching event */
@@ -129,9 +134,21 @@ typedef struct EventInfo {
 	int dynamic; /* Created by QE_InstallCmd() */
 	char *command; /* Tcl command to expand percents, or NULL */
 #endif
+	QE_FlushProc flushProc; /* Callback to generate deferred events, or
+							 * NULL if the event can't be deferred */
+	ClientData flushData; /* Passed to flushProc */
+	int coalesce; /* -coalesce option */
+	int maxRate; /* -maxrate option, 0 for no limit */
+	int flushPending; /* FLUSH_IDLE or FLUSH_TIMER when flushProc is
+					   * scheduled to be called, otherwise 0 */
+	Tcl_TimerToken timer; /* For FLUSH_TIMER */
+	Tcl_Time lastFlush; /* When flushProc was last called */
 	struct EventInfo *next; /* List of all EventInfos */
 } EventInfo;
 
+#define FLUSH_IDLE 1
+#define FLUSH_TIMER 2
+
 typedef struct GenerateField {
 	char which; /* The %-char */
 	char *string; /* Replace %-char with it */
@@ -144,6 +161,14 @@ typedef struct GenerateData {
 	char *command; /* Tcl command to expand percents, or NULL */
 } GenerateData;
 
+typedef struct BindCall {
+	Tcl_Obj *objPtr; /* Script, or list of command words if isList */
+	int isList; /* 1 if objPtr holds the words of a command */
+	int type; /* Event type of the binding */
+	int detail; /* Detail of the binding, or 0 for none */
+	ClientData object; /* Object the binding is for */
+} BindCall;
+
 typedef struct BindingTable {
 	Tcl_Interp *interp;
 	Tcl_HashTable patternTable; /* Key: PatternTableKey, Value: (BindValue *) */
@@ -156,8 +181,15 @@ typedef struct BindingTable {
 #endif
 	EventInfo *eventList; /* List of all EventInfos */
 	int nextEventId; /* Next unique EventInfo.type */
+	unsigned long *bound; /* Indexed by event type. Bit N is set if
+						   * patternTable has an entry for detail N.
+						   * The last bit stands for every detail
+						   * that doesn't have a bit of its own. */
+	int boundSpace; /* Number of words at bound[] */
 } BindingTable;
 
+#define BOUND_BITS ((int) (sizeof(unsigned long) * 8))
+
 static void ExpandPercents(BindingTable *bindPtr, ClientData object, char *command,
 	QE_Event *eventPtr, QE_ExpandProc expandProc, Tcl_DString *result);
 static int ParseEventDescription(BindingTable *bindPtr, char *eventPattern,
@@ -174,6 +206,11 @@ typedef struct PercentsData {
 	Detail *detailPtr;
 } PercentsData;
 #endif
+static int CreateBinding(BindingTable *bindPtr, ClientData object,
+	char *eventString, char *command, int append, char *argChars);
+static void SetBound(BindingTable *bindPtr, int eventType, int detail,
+	int bound);
+static void CancelFlush(EventInfo *eiPtr);
 static int DeleteBinding(BindingTable *bindPtr, BindValue *valuePtr);
 static EventInfo *FindEvent(BindingTable *bindPtr, int eventType);
 
@@ -231,6 +268,13 @@ int QE_InstallEvent(QE_BindingTable bindingTable, char *name, QE_ExpandProc expa
 	eiPtr->dynamic = 0;
 	eiPtr->command = NULL;
 #endif
+	eiPtr->flushProc = NULL;
+	eiPtr->flushData = NULL;
+	eiPtr->coalesce = 0;
+	eiPtr->maxRate = 0;
+	eiPtr->flushPending = 0;
+	eiPtr->timer = NULL;
+	eiPtr->lastFlush.sec = eiPtr->lastFlush.usec = 0;
 
 	Tcl_SetHashValue(hPtr, (ClientData) eiPtr);
 
@@ -325,6 +369,8 @@ static void DeleteEvent(BindingTable *bindPtr, EventInfo *eiPtr)
 		Tcl_Free((char *) dPtr);
 	}
 
+	CancelFlush(eiPtr);
+
 	if (bindPtr->eventList == eiPtr)
 		bindPtr->eventList = eiPtr->next;
 	else
@@ -522,6 +568,8 @@ QE_BindingTable QE_CreateBindingTable(Tcl_Interp *interp)
 #endif
 	bindPtr->nextEventId = 1;
 	bindPtr->eventList = NULL;
+	bindPtr->bound = NULL;
+	bindPtr->boundSpace = 0;
 
 	return (QE_BindingTable) bindPtr;
 }
@@ -542,6 +590,10 @@ void QE_DeleteBindingTable(QE_BindingTable bindingTable)
 		{
 			BindValue *nextValue = valuePtr->nextValue;
 			Tcl_Free((char *) valuePtr->command);
+			if (valuePtr->cmdObj != NULL)
+				Tcl_DecrRefCount(valuePtr->cmdObj);
+			if (valuePtr->argChars != NULL)
+				Tcl_Free(valuePtr->argChars);
 			memset((char *) valuePtr, 0xAA, sizeof(BindValue));
 			Tcl_Free((char *) valuePtr);
 			valuePtr = nextValue;
@@ -550,6 +602,8 @@ void QE_DeleteBindingTable(QE_BindingTable bindingTable)
 	}
 	Tcl_DeleteHashTable(&bindPtr->patternTable);
 	Tcl_DeleteHashTable(&bindPtr->objectTable);
+	if (bindPtr->bound != NULL)
+		Tcl_Free((char *) bindPtr->bound);
 
 	for (eiPtr = bindPtr->eventList;
 		eiPtr != NULL;
@@ -571,6 +625,8 @@ void QE_DeleteBindingTable(QE_BindingTable bindingTable)
 			Tcl_Free((char *) dPtr);
 		}
 
+		CancelFlush(eiPtr);
+
 		/* Free EventInfo */
 		Tcl_Free(eiPtr->name);
 #ifdef ALLOW_INSTALL
@@ -603,10 +659,166 @@ void QE_DeleteBindingTable(QE_BindingTable bindingTable)
 	Tcl_Free((char *) bindPtr);
 }
 
+/* Called when the first binding for a type/detail is created and when the
+ * last one is deleted. */
+static void SetBound(BindingTable *bindPtr, int eventType, int detail,
+	int bound)
+{
+	int bit = (detail < BOUND_BITS - 1) ? detail : BOUND_BITS - 1;
+
+	if (eventType >= bindPtr->boundSpace)
+	{
+		int space = bindPtr->boundSpace ? bindPtr->boundSpace : 16;
+
+		if (!bound)
+			return;
+		while (space <= eventType)
+			space *= 2;
+		bindPtr->bound = (unsigned long *) Tcl_Realloc(
+			(char *) bindPtr->bound, space * sizeof(unsigned long));
+		memset(bindPtr->bound + bindPtr->boundSpace, '\0',
+			(space - bindPtr->boundSpace) * sizeof(unsigned long));
+		bindPtr->boundSpace = space;
+	}
+	if (bound)
+		bindPtr->bound[eventType] |= 1UL << bit;
+
+	/* The last bit is shared, so it is left set. */
+	else if (bit < BOUND_BITS - 1)
+		bindPtr->bound[eventType] &= ~(1UL << bit);
+}
+
+/*
+ * Return 1 if generating the given event could invoke any binding, 0 if
+ * it certainly won't. This is cheap enough that callers may use it to
+ * avoid gathering %-substitution data that nobody will see.
+ */
+int QE_IsBound(QE_BindingTable bindingTable, int eventType, int detail)
+{
+	BindingTable *bindPtr = (BindingTable *) bindingTable;
+	unsigned long bits;
+	PatternTableKey key;
+
+	if (eventType >= bindPtr->boundSpace)
+		return 0;
+	bits = bindPtr->bound[eventType];
+
+	/* A binding without a detail matches every detail */
+	if (bits & 1UL)
+		return 1;
+	if (detail == 0)
+		return 0;
+	if (detail < BOUND_BITS - 1)
+		return (bits & (1UL << detail)) != 0;
+	if (!(bits & (1UL << (BOUND_BITS - 1))))
+		return 0;
+	key.type = eventType;
+	key.detail = detail;
+	return Tcl_FindHashEntry(&bindPtr->patternTable, (char *) &key) != NULL;
+}
+
+/*
+ * Allow an event to be deferred. When the -coalesce or -maxrate option of
+ * the event is set, QE_DeferEvent() schedules a call to flushProc, which
+ * should generate the event with whatever data the caller saved.
+ */
+int QE_SetFlushProc(QE_BindingTable bindingTable, int eventType,
+	QE_FlushProc flushProc, ClientData clientData)
+{
+	BindingTable *bindPtr = (BindingTable *) bindingTable;
+	EventInfo *eiPtr;
+
+	eiPtr = FindEvent(bindPtr, eventType);
+	if (eiPtr == NULL)
+		return TCL_ERROR;
+	eiPtr->flushProc = flushProc;
+	eiPtr->flushData = clientData;
+	return TCL_OK;
+}
+
+static void FlushEvent(EventInfo *eiPtr)
+{
+	eiPtr->flushPending = 0;
+	eiPtr->timer = NULL;
+	Tcl_GetTime(&eiPtr->lastFlush);
+	(*eiPtr->flushProc)(eiPtr->flushData);
+}
+
+static void FlushIdleProc(ClientData clientData)
+{
+	FlushEvent((EventInfo *) clientData);
+}
+
+static void FlushTimerProc(ClientData clientData)
+{
+	FlushEvent((EventInfo *) clientData);
+}
+
+static void CancelFlush(EventInfo *eiPtr)
+{
+	if (eiPtr->flushPending == FLUSH_IDLE)
+		Tcl_CancelIdleCall(FlushIdleProc, (ClientData) eiPtr);
+	else if (eiPtr->flushPending == FLUSH_TIMER)
+		Tcl_DeleteTimerHandler(eiPtr->timer);
+	eiPtr->flushPending = 0;
+	eiPtr->timer = NULL;
+}
+
+/*
+ * Return 1 if the caller should save the event data instead of generating
+ * the event now, 0 otherwise. A call to the event's flushProc is
+ * scheduled for when the application is idle, or for when -maxrate allows
+ * the next event to be generated.
+ */
+int QE_DeferEvent(QE_BindingTable bindingTable, int eventType)
+{
+	BindingTable *bindPtr = (BindingTable *) bindingTable;
+	EventInfo *eiPtr;
+	Tcl_Time now;
+	long ms, interval;
+
+	eiPtr = FindEvent(bindPtr, eventType);
+	if (eiPtr == NULL || eiPtr->flushProc == NULL)
+		return 0;
+	if (!eiPtr->coalesce && (eiPtr->maxRate <= 0))
+		return 0;
+	if (eiPtr->flushPending)
+		return 1;
+
+	if (eiPtr->maxRate > 0)
+	{
+		interval = 1000 / eiPtr->maxRate;
+		Tcl_GetTime(&now);
+		ms = (now.sec - eiPtr->lastFlush.sec) * 1000 +
+			(now.usec - eiPtr->lastFlush.usec) / 1000;
+		if (ms >= 0 && ms < interval)
+		{
+			eiPtr->timer = Tcl_CreateTimerHandler((int) (interval - ms),
+				FlushTimerProc, (ClientData) eiPtr);
+			eiPtr->flushPending = FLUSH_TIMER;
+			return 1;
+		}
+	}
+	Tcl_DoWhenIdle(FlushIdleProc, (ClientData) eiPtr);
+	eiPtr->flushPending = FLUSH_IDLE;
+	return 1;
+}
+
 int QE_CreateBinding(QE_BindingTable bindingTable, ClientData object,
 	char *eventString, char *command, int append)
 {
-	BindingTable *bindPtr = (BindingTable *) bindingTable;
+	return CreateBinding((BindingTable *) bindingTable, object, eventString,
+		command, append, NULL);
+}
+
+/*
+ * If argChars is not NULL, command is a list of words to which the values
+ * of the given %-chars are appended when the event is generated. The
+ * command isn't parsed for %-chars.
+ */
+static int CreateBinding(BindingTable *bindPtr, ClientData object,
+	char *eventString, char *command, int append, char *argChars)
+{
 	BindValue *valuePtr;
 	int isNew, length;
 	char *cmdOld, *cmdNew;
@@ -614,6 +826,13 @@ int QE_CreateBinding(QE_BindingTable bindingTable, ClientData object,
 	if (FindSequence(bindPtr, object, eventString, 1, &isNew, &valuePtr) != TCL_OK)
 		return TCL_ERROR;
 
+	if (append && (valuePtr->argChars != NULL))
+	{
+		Tcl_AppendResult(bindPtr->interp, "can't append to a binding ",
+			"created with -args", (char *) NULL);
+		return TCL_ERROR;
+	}
+
 	/* created a new objectTable entry */
 	if (isNew)
 	{
@@ -669,6 +888,10 @@ int QE_CreateBinding(QE_BindingTable bindingTable, ClientData object,
 		{
 			valuePtr->nextValue = (BindValue *) Tcl_GetHashValue(hPtr);
 		}
+		else
+		{
+			SetBound(bindPtr, key.type, key.detail, 1);
+		}
 		Tcl_SetHashValue(hPtr, (ClientData) valuePtr);
 	}
 
@@ -690,10 +913,33 @@ int QE_CreateBinding(QE_BindingTable bindingTable, ClientData object,
 
 	/* Free the old command, if any */
 	if (cmdOld) Tcl_Free(cmdOld);
+	if (valuePtr->cmdObj != NULL)
+	{
+		Tcl_DecrRefCount(valuePtr->cmdObj);
+		valuePtr->cmdObj = NULL;
+	}
+	if (valuePtr->argChars != NULL)
+	{
+		Tcl_Free(valuePtr->argChars);
+		valuePtr->argChars = NULL;
+	}
 
 	/* Save command associated with this binding */
 	valuePtr->command = cmdNew;
 
+	if (argChars != NULL)
+	{
+		valuePtr->argChars = Tcl_Alloc((unsigned) strlen(argChars) + 1);
+		(void) strcpy(valuePtr->argChars, argChars);
+	}
+
+	/* Commands with nothing to substitute are evaluated as objects */
+	if ((argChars != NULL) || (strchr(cmdNew, '%') == NULL))
+	{
+		valuePtr->cmdObj = Tcl_NewStringObj(cmdNew, -1);
+		Tcl_IncrRefCount(valuePtr->cmdObj);
+	}
+
 	return TCL_OK;
 }
 
@@ -790,6 +1036,7 @@ static int DeleteBinding(BindingTable *bindPtr, BindValue *valuePtr)
 					valuePtr->type, valuePtr->detail);
 
 			Tcl_DeleteHashEntry(hPtr);
+			SetBound(bindPtr, valuePtr->type, valuePtr->detail, 0);
 		}
 		/* The next BindValue is the new head of the list */
 		else
@@ -840,6 +1087,10 @@ static int DeleteBinding(BindingTable *bindPtr, BindValue *valuePtr)
 #endif
 
 	Tcl_Free((char *) valuePtr->command);
+	if (valuePtr->cmdObj != NULL)
+		Tcl_DecrRefCount(valuePtr->cmdObj);
+	if (valuePtr->argChars != NULL)
+		Tcl_Free(valuePtr->argChars);
 	memset((char *) valuePtr, 0xAA, sizeof(BindValue));
 	Tcl_Free((char *) valuePtr);
 
@@ -1046,6 +1297,55 @@ static void ExpandPercents(BindingTable *bindPtr, ClientData object,
 	}
 }
 
+/*
+ * Append the value of each %-char in chars to listObj as a separate
+ * element, without the quoting ExpandPercents adds for scripts.
+ */
+static void ExpandArgs(BindingTable *bindPtr, ClientData object,
+	char *chars, QE_Event *eventPtr, QE_ExpandProc expandProc,
+	Tcl_Obj *listObj)
+{
+	QE_ExpandArgs expandArgs;
+	Tcl_DString value;
+	Tcl_Obj *valueObj, *elemObj;
+	int count;
+
+	Tcl_DStringInit(&value);
+
+	expandArgs.bindingTable = (QE_BindingTable) bindPtr;
+	expandArgs.object = object;
+	expandArgs.event = eventPtr->type;
+	expandArgs.detail = eventPtr->detail;
+	expandArgs.result = &value;
+	expandArgs.clientData = eventPtr->clientData;
+
+	for (; *chars != 0; chars++)
+	{
+		Tcl_DStringSetLength(&value, 0);
+		expandArgs.which = *chars;
+		(*expandProc)(&expandArgs);
+
+		/* The expansion is a single list element, unless the %-char
+		 * expands to several words like %? does. */
+		valueObj = Tcl_NewStringObj(Tcl_DStringValue(&value),
+			Tcl_DStringLength(&value));
+		Tcl_IncrRefCount(valueObj);
+		if ((Tcl_ListObjLength(NULL, valueObj, &count) == TCL_OK) &&
+			(count == 1))
+		{
+			Tcl_ListObjIndex(NULL, valueObj, 0, &elemObj);
+			Tcl_ListObjAppendElement(NULL, listObj, elemObj);
+		}
+		else
+		{
+			Tcl_ListObjAppendElement(NULL, listObj, valueObj);
+		}
+		Tcl_DecrRefCount(valueObj);
+	}
+
+	Tcl_DStringFree(&value);
+}
+
 static void BindEvent(BindingTable *bindPtr, QE_Event *eventPtr, int wantDetail,
 	EventInfo *eiPtr, Detail *dPtr, GenerateData *gdPtr)
 {
@@ -1053,9 +1353,13 @@ static void BindEvent(BindingTable *bindPtr, QE_Event *eventPtr, int wantDetail,
 	BindValue *valuePtr;
 	ObjectTableKey keyObj;
 	PatternTableKey key;
-	Tcl_DString scripts, savedResult;
-	int code;
-	char *p, *end;
+	Tcl_DString script, savedResult;
+	BindCall staticCall[10], *calls = staticCall, *callPtr;
+	int numCalls = 0, callSpace = 10;
+	int code, i, objc;
+	Tcl_Obj **objv;
+	QE_ExpandProc expandProc;
+	PercentsData data;
 	char *command = gdPtr ? gdPtr->command : NULL;
 
 	/* Find the first BindValue for this event */
@@ -1065,10 +1369,10 @@ static void BindEvent(BindingTable *bindPtr, QE_Event *eventPtr, int wantDetail,
 	if (hPtr == NULL)
 		return;
 
-	/* Collect all scripts, with % expanded, separated by null characters.
+	/* Collect all scripts, with % expanded, as Tcl objects.
 	 * Do it this way because anything could happen while evaluating, including
 	 * uninstalling events/details, even the interpreter being deleted. */
-	Tcl_DStringInit(&scripts);
+	Tcl_DStringInit(&script);
 
 	for (valuePtr = (BindValue *) Tcl_GetHashValue(hPtr);
 		valuePtr; valuePtr = valuePtr->nextValue)
@@ -1128,15 +1432,12 @@ static void BindEvent(BindingTable *bindPtr, QE_Event *eventPtr, int wantDetail,
 		/* called by QE_GenerateCmd */
 		if (command != NULL)
 		{
-			PercentsData data;
-
 			data.gdPtr = gdPtr;
 			data.command = command;
 			data.eventPtr = eiPtr;
 			data.detailPtr = dPtr;
 			eventPtr->clientData = (ClientData) &data;
-			ExpandPercents(bindPtr, valuePtr->object, valuePtr->command,
-				eventPtr, Percents_Command, &scripts);
+			expandProc = Percents_Command;
 		}
 
 		/* called by QE_GenerateCmd */
@@ -1148,34 +1449,65 @@ static void BindEvent(BindingTable *bindPtr, QE_Event *eventPtr, int wantDetail,
 			 *    no percentsCommand argument
 			 */
 			eventPtr->clientData = (ClientData) gdPtr;
-			ExpandPercents(bindPtr, valuePtr->object, valuePtr->command,
-				eventPtr, Percents_CharMap, &scripts);
+			expandProc = Percents_CharMap;
 		}
 		else
 		{
-			QE_ExpandProc expandProc =
-				((dPtr != NULL) && (dPtr->expandProc != NULL)) ?
+			expandProc = ((dPtr != NULL) && (dPtr->expandProc != NULL)) ?
 				dPtr->expandProc : eiPtr->expandProc;
-
-			ExpandPercents(bindPtr, valuePtr->object, valuePtr->command,
-				eventPtr, expandProc, &scripts);
 		}
 
-		/* Separate each script by '\0' */
-		Tcl_DStringAppend(&scripts, "", 1);
-
-		Tcl_DStringAppend(&scripts, eiPtr->name, -1);
-		Tcl_DStringAppend(&scripts, "", 1);
+		if (numCalls == callSpace)
+		{
+			callSpace *= 2;
+			if (calls == staticCall)
+			{
+				calls = (BindCall *) Tcl_Alloc(sizeof(BindCall) * callSpace);
+				memcpy(calls, staticCall, sizeof(staticCall));
+			}
+			else
+			{
+				calls = (BindCall *) Tcl_Realloc((char *) calls,
+					sizeof(BindCall) * callSpace);
+			}
+		}
+		callPtr = &calls[numCalls++];
+		callPtr->type = valuePtr->type;
+		callPtr->detail = valuePtr->detail;
+		callPtr->object = valuePtr->object;
 
-		Tcl_DStringAppend(&scripts, (valuePtr->detail && dPtr) ? dPtr->name : "", -1);
-		Tcl_DStringAppend(&scripts, "", 1);
+		/* Bound with -args: the command words followed by the values */
+		if (valuePtr->argChars != NULL)
+		{
+			Tcl_ListObjGetElements(NULL, valuePtr->cmdObj, &objc, &objv);
+			callPtr->objPtr = Tcl_NewListObj(objc, objv);
+			callPtr->isList = 1;
+			ExpandArgs(bindPtr, valuePtr->object, valuePtr->argChars,
+				eventPtr, expandProc, callPtr->objPtr);
+		}
 
-		Tcl_DStringAppend(&scripts, valuePtr->object, -1);
-		Tcl_DStringAppend(&scripts, "", 1);
+		/* Nothing to substitute: reuse the compiled script */
+		else if (valuePtr->cmdObj != NULL)
+		{
+			callPtr->objPtr = valuePtr->cmdObj;
+			callPtr->isList = 0;
+		}
+		else
+		{
+			Tcl_DStringSetLength(&script, 0);
+			ExpandPercents(bindPtr, valuePtr->object, valuePtr->command,
+				eventPtr, expandProc, &script);
+			callPtr->objPtr = Tcl_NewStringObj(Tcl_DStringValue(&script),
+				Tcl_DStringLength(&script));
+			callPtr->isList = 0;
+		}
+		Tcl_IncrRefCount(callPtr->objPtr);
 	}
 
-	/* Nothing to do. No need to call Tcl_DStringFree(&scripts) */
-	if (Tcl_DStringLength(&scripts) == 0)
+	Tcl_DStringFree(&script);
+
+	/* Nothing to do */
+	if (numCalls == 0)
 		return;
 
 	/*
@@ -1186,14 +1518,19 @@ static void BindEvent(BindingTable *bindPtr, QE_Event *eventPtr, int wantDetail,
 	Tcl_DStringInit(&savedResult);
 	Tcl_DStringGetResult(bindPtr->interp, &savedResult);
 
-	p = Tcl_DStringValue(&scripts);
-	end = p + Tcl_DStringLength(&scripts);
-
-	while (p < end)
+	for (i = 0; i < numCalls; i++)
 	{
-		code = Tcl_GlobalEval(bindPtr->interp, p);
-		p += strlen(p);
-		p++;
+		callPtr = &calls[i];
+		if (callPtr->isList)
+		{
+			Tcl_ListObjGetElements(NULL, callPtr->objPtr, &objc, &objv);
+			code = Tcl_EvalObjv(bindPtr->interp, objc, objv, TCL_EVAL_GLOBAL);
+		}
+		else
+		{
+			code = Tcl_EvalObjEx(bindPtr->interp, callPtr->objPtr,
+				TCL_EVAL_GLOBAL);
+		}
 
 		if (code != TCL_OK)
 		{
@@ -1207,28 +1544,26 @@ static void BindEvent(BindingTable *bindPtr, QE_Event *eventPtr, int wantDetail,
 			}
 			else
 			{
-				char buf[256];
-				char *eventName = p;
-				char *detailName = p + strlen(p) + 1;
-				char *object = detailName + strlen(detailName) + 1;
-
-				(void) sprintf(buf, "\n    (<%s%s%s> binding on %s)",
-					eventName, detailName[0] ? "-" : "", detailName, object);
-				Tcl_AddErrorInfo(bindPtr->interp, buf);
+				Tcl_DString where;
+
+				/* The event or detail may have been uninstalled by now */
+				Tcl_DStringInit(&where);
+				Tcl_DStringAppend(&where, "\n    (", -1);
+				QE_ExpandPattern((QE_BindingTable) bindPtr, callPtr->type,
+					callPtr->detail, &where);
+				Tcl_DStringAppend(&where, " binding on ", -1);
+				Tcl_DStringAppend(&where, (char *) callPtr->object, -1);
+				Tcl_DStringAppend(&where, ")", -1);
+				Tcl_AddErrorInfo(bindPtr->interp, Tcl_DStringValue(&where));
+				Tcl_DStringFree(&where);
 				Tcl_BackgroundError(bindPtr->interp);
 			}
 		}
-
-		/* Skip event\0detail\0object\0 */
-		p += strlen(p);
-		p++;
-		p += strlen(p);
-		p++;
-		p += strlen(p);
-		p++;
+		Tcl_DecrRefCount(callPtr->objPtr);
 	}
 
-	Tcl_DStringFree(&scripts);
+	if (calls != staticCall)
+		Tcl_Free((char *) calls);
 
 	/* Restore the interpreter result */
 	Tcl_DStringResult(bindPtr->interp, &savedResult);
@@ -1240,6 +1575,10 @@ static int BindEventWrapper(QE_BindingTable bindingTable, QE_Event *eventPtr, Ge
 	Detail *dPtr = NULL;
 	EventInfo *eiPtr;
 
+	/* Nothing is bound to this event */
+	if (!QE_IsBound(bindingTable, eventPtr->type, eventPtr->detail))
+		return TCL_OK;
+
 	/* Find the event */
 	eiPtr = FindEvent(bindPtr, eventPtr->type);
 	if (eiPtr == NULL)
@@ -1425,6 +1764,8 @@ static int FindSequence(BindingTable *bindPtr, ClientData object,
 			valuePtr->detail = pats.detail;
 			valuePtr->object = object;
 			valuePtr->command = NULL;
+			valuePtr->cmdObj = NULL;
+			valuePtr->argChars = NULL;
 			valuePtr->specific = 0;
 			valuePtr->nextValue = NULL;
 #if BIND_ACTIVE
@@ -1534,6 +1875,48 @@ void QE_ExpandPattern(QE_BindingTable bindingTable, int eventType, int detail, T
 	Tcl_DStringAppend(result, ">", 1);
 }
 
+/* Create a binding for [bind -args]. Each element of charListObj is a
+ * %-char whose value is appended to the command words in cmdObj. */
+static int BindArgs(BindingTable *bindPtr, ClientData object,
+	char *eventString, Tcl_Obj *cmdObj, Tcl_Obj *charListObj)
+{
+	char staticChars[20], *chars = staticChars, *t;
+	int i, length, listObjc, result;
+	Tcl_Obj **listObjv;
+
+	if (Tcl_ListObjGetElements(bindPtr->interp, charListObj,
+		&listObjc, &listObjv) != TCL_OK)
+		return TCL_ERROR;
+
+	/* The command is evaluated as a list of words */
+	if (Tcl_ListObjLength(bindPtr->interp, cmdObj, &length) != TCL_OK)
+		return TCL_ERROR;
+
+	if (listObjc >= (int) sizeof(staticChars))
+		chars = Tcl_Alloc((unsigned) listObjc + 1);
+	for (i = 0; i < listObjc; i++)
+	{
+		t = Tcl_GetStringFromObj(listObjv[i], &length);
+		if (length != 1)
+		{
+			Tcl_AppendResult(bindPtr->interp, "invalid percent char \"", t,
+				"\"", NULL);
+			result = TCL_ERROR;
+			goto done;
+		}
+		chars[i] = t[0];
+	}
+	chars[listObjc] = '\0';
+
+	result = CreateBinding(bindPtr, object, eventString,
+		Tcl_GetString(cmdObj), 0, chars);
+
+done:
+	if (chars != staticChars)
+		Tcl_Free(chars);
+	return result;
+}
+
 int QE_BindCmd(QE_BindingTable bindingTable, int objOffset, int objc,
 	Tcl_Obj *CONST objv[])
 {
@@ -1543,6 +1926,15 @@ int QE_BindCmd(QE_BindingTable bindingTable, int objOffset, int objc,
 	Tk_Window tkwin = Tk_MainWindow(bindPtr->interp);
 	ClientData object;
 	char *string;
+	Tcl_Obj *argsObj = NULL;
+
+	/* bind -args $charList $object $pattern $script */
+	if ((objC == 6) && !strcmp(Tcl_GetString(objV[1]), "-args"))
+	{
+		argsObj = objV[2];
+		objV += 2;
+		objC -= 2;
+	}
 
 	if ((objC < 1) || (objC > 4))
 	{
@@ -1584,6 +1976,10 @@ int QE_BindCmd(QE_BindingTable bindingTable, int objOffset, int objc,
 		{
 			return QE_DeleteBinding(bindingTable, object, sequence);
 		}
+		if (argsObj != NULL)
+		{
+			return BindArgs(bindPtr, object, sequence, objV[3], argsObj);
+		}
 		if (script[0] == '+')
 		{
 			script++;
@@ -1776,6 +2172,112 @@ done:
 
 #if BIND_ACTIVE
 
+/* qeconfigure <Scroll> -maxrate 30 */
+
+static int
+EventConfigure(BindingTable *bindPtr, int objOffset, int objc,
+	Tcl_Obj *CONST objv[])
+{
+	Tcl_Interp *interp = bindPtr->interp;
+	static CONST char *configSwitch[] = {"-coalesce", "-maxrate", NULL};
+	Tcl_Obj *CONST *objPtr;
+	Tcl_Obj *listObj;
+	EventInfo *eiPtr;
+	Pattern pats;
+	int index, coalesce, maxRate;
+
+	if (ParseEventDescription(bindPtr, Tcl_GetString(objv[objOffset + 1]),
+		&pats, &eiPtr, NULL) != TCL_OK)
+		return TCL_ERROR;
+	if (pats.detail != 0)
+	{
+		Tcl_AppendResult(interp, "can't configure a detail of an event",
+			NULL);
+		return TCL_ERROR;
+	}
+	if (eiPtr->flushProc == NULL)
+	{
+		Tcl_AppendResult(interp, "event \"", eiPtr->name,
+			"\" has no configuration options", NULL);
+		return TCL_ERROR;
+	}
+
+	objPtr = objv + objOffset + 2;
+	objc -= objOffset + 2;
+
+	if (objc == 0)
+	{
+		listObj = Tcl_NewListObj(0, NULL);
+		Tcl_ListObjAppendElement(interp, listObj, Tcl_NewStringObj("-coalesce", -1));
+		Tcl_ListObjAppendElement(interp, listObj, Tcl_NewBooleanObj(eiPtr->coalesce));
+		Tcl_ListObjAppendElement(interp, listObj, Tcl_NewStringObj("-maxrate", -1));
+		Tcl_ListObjAppendElement(interp, listObj, Tcl_NewIntObj(eiPtr->maxRate));
+		Tcl_SetObjResult(interp, listObj);
+		return TCL_OK;
+	}
+
+	if (objc == 1)
+	{
+		if (Tcl_GetIndexFromObj(interp, objPtr[0], configSwitch,
+			"option", 0, &index) != TCL_OK)
+		{
+			return TCL_ERROR;
+		}
+		switch (index)
+		{
+			case 0: /* -coalesce */
+				Tcl_SetObjResult(interp, Tcl_NewBooleanObj(eiPtr->coalesce));
+				break;
+			case 1: /* -maxrate */
+				Tcl_SetObjResult(interp, Tcl_NewIntObj(eiPtr->maxRate));
+				break;
+		}
+		return TCL_OK;
+	}
+
+	/* Don't change anything unless every value is valid */
+	coalesce = eiPtr->coalesce;
+	maxRate = eiPtr->maxRate;
+	while (objc > 1)
+	{
+		if (Tcl_GetIndexFromObj(interp, objPtr[0], configSwitch,
+			"option", 0, &index) != TCL_OK)
+		{
+			return TCL_ERROR;
+		}
+		switch (index)
+		{
+			case 0: /* -coalesce */
+				if (Tcl_GetBooleanFromObj(interp, objPtr[1], &coalesce)
+					!= TCL_OK)
+				{
+					return TCL_ERROR;
+				}
+				break;
+			case 1: /* -maxrate */
+				if (Tcl_GetIntFromObj(interp, objPtr[1], &maxRate)
+					!= TCL_OK)
+				{
+					return TCL_ERROR;
+				}
+				if (maxRate < 0)
+				{
+					Tcl_AppendResult(interp, "bad rate \"",
+						Tcl_GetString(objPtr[1]),
+						"\": must be >= 0", NULL);
+					return TCL_ERROR;
+				}
+				break;
+		}
+		objPtr += 2;
+		objc -= 2;
+	}
+	eiPtr->coalesce = coalesce;
+	eiPtr->maxRate = maxRate;
+
+	return TCL_OK;
+}
+
 /* qeconfigure $win <Term-fresh> -active no */
 
 int
@@ -1794,6 +2296,10 @@ QE_ConfigureCmd(QE_BindingTable bindingTable, int objOffset, int objc,
 	int index;
 	ClientData object;
 
+	/* Options of the event itself */
+	if ((objC >= 2) && (Tcl_GetString(objV[1])[0] == '<'))
+		return EventConfigure(bindPtr, objOffset, objc, objv);
+
 	if (objC < 3)
 	{
 		Tcl_WrongNumArgs(interp, objOffset + 1, objv,
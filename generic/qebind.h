@@ -42,6 +42,7 @@ typedef struct QE_ExpandArgs {
 } QE_ExpandArgs;
 
 typedef void (*QE_ExpandProc)(QE_ExpandArgs *args);
+typedef void (*QE_FlushProc)(ClientData clientData);
 
 MODULE_SCOPE int debug_bindings;
 
@@ -64,6 +65,10 @@ MODULE_SCOPE int QE_GetAllBindings(QE_BindingTable bindingTable,
 MODULE_SCOPE int QE_GetEventNames(QE_BindingTable bindingTable);
 MODULE_SCOPE int QE_GetDetailNames(QE_BindingTable bindingTable, char *eventName);
 MODULE_SCOPE int QE_BindEvent(QE_BindingTable bindingTable, QE_Event *eventPtr);
+MODULE_SCOPE int QE_IsBound(QE_BindingTable bindingTable, int eventType, int detail);
+MODULE_SCOPE int QE_SetFlushProc(QE_BindingTable bindingTable, int eventType,
+	QE_FlushProc flushProc, ClientData clientData);
+MODULE_SCOPE int QE_DeferEvent(QE_BindingTable bindingTable, int eventType);
 MODULE_SCOPE void QE_ExpandDouble(double number, Tcl_DString *result);
 MODULE_SCOPE void QE_ExpandNumber(long number, Tcl_DString *result);
 MODULE_SCOPE void QE_ExpandString(char *string, Tcl_DString *result);
@@ -14,6 +14,7 @@ typedef struct TreeColumn_ TreeColumn_;
 
 typedef struct ColumnSpan ColumnSpan;
 typedef struct SpanArray SpanArray;
+typedef struct PendingWidth PendingWidth;
 struct SpanArray
 {
     ColumnSpan **spans;
@@ -31,12 +32,22 @@ struct ColumnSpan
 				 * or header. */
     int widthOfColumns;		/* Sum of the calculated display widths of
 				 * the columns. */
+    TreeItem maxItem;		/* The item or header that first requested
+				 * maxNeededWidth, or NULL. */
     SpanArray spansToRight;	/* List of spans following this one. */
     ColumnSpan *next;		/* Head is TreeColumnPriv_.spans. */
     ColumnSpan *nextCur;	/* Head is TreeColumnPriv_.spansCur. */
     int sumOfSpans;
 };
 
+/* A structure of the following type is kept for each item whose requested
+ * width changed in one column, see TreeColumns_InvalidateWidthOfItem. */
+struct PendingWidth
+{
+    int itemId;			/* Unique id of the item. */
+    TreeColumn column;		/* Column whose style changed. */
+};
+
 /* A structure of the following type is kept for each TreeColumn.
  * This is used when calculating the requested width of styles. */
 typedef struct ColumnReqData ColumnReqData;
@@ -50,6 +61,10 @@ struct ColumnReqData
 			 * in a single item in this column. */
     int maxSingleSpanWidth; /* The widest span of 1. */
     int maxSingleItemWidth; /* The widest span of 1 in items. */
+    TreeItem maxSingleItem; /* The item that first requested
+			 * maxSingleItemWidth, or NULL. */
+    int redistribute;	/* TRUE if the span records in this column's
+			 * group grew since the last layout. */
     int maxSingleHeaderWidth; /* The widest span of 1 in headers. */
     SpanArray spans;	/* Array of span pointers touching this column.*/
     TreeColumn spanMin;		/* Any span that includes this column */
@@ -76,8 +91,25 @@ struct TreeColumnPriv_
 				 * update. */
     int allSpansAreOne;		/* TRUE if all spans cover exactly one column,
 				 * otherwise FALSE. */
+    PendingWidth *pending;	/* Items whose requested width changed in
+				 * a single column since the last layout. */
+    int pendingCount;		/* Number of useful elements in pending[]. */
+    int pendingAlloc;		/* Number of elements allocated in
+				 * pending[]. */
+    TreeColumn *byIndex;	/* Every column except the tail, indexed
+				 * by TreeColumn.index. */
+    int byIndexCount;		/* Number of useful elements in
+				 * byIndex[]. */
+    int byIndexAlloc;		/* Number of elements allocated in
+				 * byIndex[]. */
+    int byIndexInvalid;		/* TRUE if byIndex[] must be rebuilt
+				 * before use, otherwise FALSE. */
 };
 
+/* Beyond this many changed items it is cheaper to ask every item for its
+ * width again. */
+#define PENDING_WIDTH_MAX 500
+
 #ifdef UNIFORM_GROUP
 typedef struct UniformGroup {
     Tcl_HashEntry *hPtr;	/* Entry in TreeCtrl.uniformGroupHash */
@@ -745,8 +777,10 @@ Qualifiers_Scan(
 	    }
 	    case QUAL_TAG: {
 		if (tree->columnTagExpr) {
-		    if (q->exprOK)
+		    if (q->exprOK) {
 			TagExpr_Free(&q->expr);
+			q->exprOK = FALSE;
+		    }
 		    if (TagExpr_Init(tree, objv[j + 1], &q->expr) != TCL_OK)
 			return TCL_ERROR;
 		    q->exprOK = TRUE;
@@ -773,8 +807,10 @@ Qualifiers_Scan(
     }
     return TCL_OK;
 errorExit:
-    if (q->exprOK)
+    if (q->exprOK) {
 	TagExpr_Free(&q->expr);
+	q->exprOK = FALSE;
+    }
     return TCL_ERROR;
 }
 
@@ -1528,7 +1564,8 @@ TreeColumn_ToObj(
  *	Token for the N'th column.
  *
  * Side effects:
- *	None.
+ *	The array of columns indexed by TreeColumn.index may be
+ *	rebuilt.
  *
  *----------------------------------------------------------------------
  */
@@ -1539,10 +1576,38 @@ Tree_FindColumn(
     int columnIndex		/* 0-based index of the column to return. */
     )
 {
-    TreeColumn column = tree->columns;
+    TreeColumnPriv priv = tree->columnPriv;
+    TreeColumn column;
 
-if (columnIndex == tree->columnTail->index) return tree->columnTail;
+    if (columnIndex == tree->columnTail->index)
+	return tree->columnTail;
+    if (columnIndex < 0)
+	return NULL;
+
+    if (priv->byIndexInvalid) {
+	if (priv->byIndexAlloc < tree->columnCount) {
+	    priv->byIndex = (TreeColumn *) ckrealloc((char *) priv->byIndex,
+		sizeof(TreeColumn) * tree->columnCount);
+	    priv->byIndexAlloc = tree->columnCount;
+	}
+	priv->byIndexCount = 0;
+	for (column = tree->columns;
+		column != NULL && priv->byIndexCount < priv->byIndexAlloc;
+		column = column->next) {
+	    priv->byIndex[priv->byIndexCount++] = column;
+	}
+	priv->byIndexInvalid = FALSE;
+    }
+    if (columnIndex < priv->byIndexCount) {
+	column = priv->byIndex[columnIndex];
+	if (column->index == columnIndex)
+	    return column;
+    }
 
+    /* The columns are being created, moved or renumbered. Walk the list
+     * and rebuild the array next time. */
+    priv->byIndexInvalid = TRUE;
+    column = tree->columns;
     while (column != NULL) {
 	if (column->index == columnIndex)
 	    break;
@@ -1551,6 +1616,90 @@ if (columnIndex == tree->columnTail->index) return tree->columnTail;
     return column;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * Tree_ColumnsInRange --
+ *
+ *	Find the columns of one lock that overlap a horizontal range.
+ *	A binary search over the column offsets is used so the cost
+ *	does not depend on the number of columns to the left of the
+ *	range.
+ *
+ * Results:
+ *	If any column with the given lock overlaps the range
+ *	[minX,maxX) of column offsets (as returned by
+ *	TreeColumn_Offset) the first and last such columns are
+ *	returned and the result is 1. Otherwise the result is 0.
+ *
+ * Side effects:
+ *	Column layout may be updated.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+Tree_ColumnsInRange(
+    TreeCtrl *tree,		/* Widget info. */
+    int lock,			/* Which columns. */
+    int minX, int maxX,		/* Range of column offsets. */
+    TreeColumn *firstPtr,	/* Returned first column. */
+    TreeColumn *lastPtr		/* Returned last column. */
+    )
+{
+    TreeColumn first, next, column;
+    int lo, hi, mid, lastIndex;
+
+    first = Tree_FirstColumn(tree, lock, FALSE);
+    if (first == NULL || minX >= maxX)
+	return 0;
+    switch (lock) {
+	case COLUMN_LOCK_LEFT:
+	    next = tree->columnLockNone ? tree->columnLockNone :
+		tree->columnLockRight;
+	    break;
+	case COLUMN_LOCK_NONE:
+	    next = tree->columnLockRight;
+	    break;
+	default:
+	    next = NULL;
+	    break;
+    }
+    lastIndex = (next ? next->index : tree->columnTail->index) - 1;
+
+    /* Update layout if needed */
+    (void) Tree_WidthOfColumns(tree);
+
+    /* The first column whose right edge is past minX. */
+    lo = first->index, hi = lastIndex + 1;
+    while (lo < hi) {
+	mid = (lo + hi) / 2;
+	column = Tree_FindColumn(tree, mid);
+	if (column->offset + column->useWidth > minX)
+	    hi = mid;
+	else
+	    lo = mid + 1;
+    }
+    if (lo > lastIndex)
+	return 0;
+    (*firstPtr) = Tree_FindColumn(tree, lo);
+
+    /* The last column whose left edge is before maxX. */
+    hi = lastIndex + 1;
+    while (lo < hi) {
+	mid = (lo + hi) / 2;
+	column = Tree_FindColumn(tree, mid);
+	if (column->offset < maxX)
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+    if (lo - 1 < (*firstPtr)->index)
+	return 0;
+    (*lastPtr) = Tree_FindColumn(tree, lo - 1);
+    return 1;
+}
+
 TreeColumn
 Tree_FirstColumn(
     TreeCtrl *tree,
@@ -2248,6 +2397,7 @@ Column_Free(
     tree->columnCount--;
     if (tree->columnCount == 0)
 	tree->nextColumnId = 0;
+    tree->columnPriv->byIndexInvalid = TRUE;
     return next;
 }
 
@@ -3294,6 +3444,7 @@ TreeColumnCmd(
 			TreeDisplay_ColumnDeleted(tree, column);
 			TreeHeader_ColumnDeleted(tree, column);
 			TreeGradient_ColumnDeleted(tree, column);
+			TreeElement_ColumnDeleted(tree, column);
 #if COLUMNGRID == 1
 			if (column->visible &&
 				(column->gridLeftColor != NULL ||
@@ -3349,6 +3500,7 @@ TreeColumnCmd(
 		TreeDisplay_ColumnDeleted(tree, column);
 		TreeHeader_ColumnDeleted(tree, column);
 		TreeGradient_ColumnDeleted(tree, column);
+		TreeElement_ColumnDeleted(tree, column);
 #if COLUMNGRID == 1
 		if (column->visible &&
 			(column->gridLeftColor != NULL ||
@@ -3753,6 +3905,7 @@ AddColumnSpan(
     TreeColumn spanMin,		/* First column in the span. */
     TreeColumn spanMax,		/* Last column in the span. */
     int neededWidth,		/* Width needed by the span. */
+    TreeItem item,		/* Item or header requesting the width. */
     int doHeaders		/* TRUE if this span is in a header, FALSE
 				 * if the span is in an item. */
     )
@@ -3776,15 +3929,20 @@ AddColumnSpan(
 	if (spanPrev != NULL && priv->spansInvalid == TRUE)
 	    SpanArray_Add(&spanPrev->spansToRight, cs);
 
-	cs->maxNeededWidth = MAX(cs->maxNeededWidth, neededWidth);
+	if (neededWidth > cs->maxNeededWidth) {
+	    cs->maxNeededWidth = neededWidth;
+	    cs->maxItem = item;
+	}
 
 	/* Remember the widest span of 1 in this column. */
 	if (spanMin == spanMax) {
 	    cd->maxSingleSpanWidth = MAX(cd->maxSingleSpanWidth, neededWidth);
 	    if (doHeaders)
 		cd->maxSingleHeaderWidth = MAX(cd->maxSingleHeaderWidth, neededWidth);
-	    else
-		cd->maxSingleItemWidth = MAX(cd->maxSingleItemWidth, neededWidth);
+	    else if (neededWidth > cd->maxSingleItemWidth) {
+		cd->maxSingleItemWidth = neededWidth;
+		cd->maxSingleItem = item;
+	    }
 	}
 	return cs;
     }
@@ -3804,6 +3962,7 @@ AddColumnSpan(
     cs->start = spanMin;
     cs->end = spanMax;
     cs->maxNeededWidth = neededWidth;
+    cs->maxItem = item;
     cs->spansToRight.count = 0;
 
     cs->next = priv->spans;
@@ -3841,8 +4000,10 @@ AddColumnSpan(
 	    cd->maxSingleSpanWidth = MAX(cd->maxSingleSpanWidth, neededWidth);
 	    if (doHeaders)
 		cd->maxSingleHeaderWidth = MAX(cd->maxSingleHeaderWidth, neededWidth);
-	    else
-		cd->maxSingleItemWidth = MAX(cd->maxSingleItemWidth, neededWidth);
+	    else if (neededWidth > cd->maxSingleItemWidth) {
+		cd->maxSingleItemWidth = neededWidth;
+		cd->maxSingleItem = item;
+	    }
 	} else
 	    priv->allSpansAreOne = FALSE;
     }
@@ -4136,7 +4297,8 @@ TreeItem_RequestWidthInColumns(
 		    indent = doHeaders ? 0 : TreeItem_Indent(tree, treeColumn, item);
 		    width += indent;
 		}
-		csPrev = AddColumnSpan(csPrev, treeColumn, treeColumn, width, doHeaders);
+		csPrev = AddColumnSpan(csPrev, treeColumn, treeColumn, width,
+		    item, doHeaders);
 	    }
 	    treeColumn = TreeColumn_Next(treeColumn);
 	    if (itemColumn != NULL)
@@ -4181,7 +4343,8 @@ TreeItem_RequestWidthInColumns(
 		indent = doHeaders ? 0 : TreeItem_Indent(tree, treeColumn, item);
 		width += indent;
 	    }
-	    csPrev = AddColumnSpan(csPrev, treeColumn, lastColumnInSpan, width, doHeaders);
+	    csPrev = AddColumnSpan(csPrev, treeColumn, lastColumnInSpan, width,
+		item, doHeaders);
 	}
 
 	treeColumn = TreeColumn_Next(lastColumnInSpan);
@@ -4342,6 +4505,238 @@ DistributeSpanWidthToColumns(
     }
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * InvalidateSpanGroup --
+ *
+ *	Marks the width requested by items as out-of-date in every
+ *	column whose spans overlap any of the spans that include the
+ *	given column.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+InvalidateSpanGroup(
+    TreeColumn column		/* Column token. */
+    )
+{
+    TreeColumn columnMin = column->reqData.spanMin;
+    TreeColumn columnMax = column->reqData.spanMax;
+
+    columnMin->widthOfItems = -1;
+
+    /* Must recalculate the width of items in every span that overlaps
+     * any of the spans that include this column. */
+    while ((columnMin->prev != NULL) &&
+	    (columnMin->prev->reqData.spanMax->index >= columnMin->index)) {
+	columnMin = columnMin->prev->reqData.spanMin;
+	columnMin->widthOfItems = -1;
+    }
+    while ((columnMax->next != NULL) &&
+	    (columnMax->next->reqData.spanMin->index <= columnMax->index)) {
+	columnMax = columnMax->next->reqData.spanMax;
+	columnMax->reqData.spanMin->widthOfItems = -1;
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * RequestWidthOfItem --
+ *
+ *	Updates the span record for the span of a single item that
+ *	includes the given column, without asking any other item for
+ *	its width.  This is only possible when the width needed by the
+ *	span didn't shrink below the widest span of any item or header.
+ *
+ * Results:
+ *	1 if the span record got wider, 0 if nothing changed, or -1 if
+ *	every item must be asked for its width again.
+ *
+ * Side effects:
+ *	The size of elements and styles in the item will be updated if
+ *	they are marked out-of-date.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+RequestWidthOfItem(
+    TreeCtrl *tree,		/* Widget info. */
+    TreeItem item,		/* Item token. */
+    TreeColumn column		/* Column whose style changed. */
+    )
+{
+    int *spans = TreeItem_GetSpans(tree, item);
+    TreeColumn start = column, end = column;
+    TreeItemColumn itemColumn;
+    ColumnReqData *cd;
+    ColumnSpan *cs = NULL;
+    int i, width = 0;
+
+    if (spans != NULL) {
+	while (start->index > spans[column->index])
+	    start = start->prev;
+	while (end->next != NULL && spans[end->next->index] == start->index)
+	    end = end->next;
+    }
+
+    cd = &start->reqData;
+    if (!cd->vis)
+	return 0;
+
+    itemColumn = TreeItem_FindColumn(tree, item, start->index);
+    if (itemColumn != NULL) {
+	width = TreeItemColumn_NeededWidth(tree, item, itemColumn);
+	width += TreeItem_Indent(tree, start, item);
+    }
+
+    for (i = 0; i < cd->spans.count; i++) {
+	cs = cd->spans.spans[i];
+	if ((cs->start == start) && (cs->end == end))
+	    break;
+    }
+    if (i == cd->spans.count)
+	return -1;
+
+    if (width > cs->maxNeededWidth) {
+	cs->maxNeededWidth = width;
+	cs->maxItem = item;
+	if (start == end) {
+	    cd->maxSingleSpanWidth = MAX(cd->maxSingleSpanWidth, width);
+	    if (width > cd->maxSingleItemWidth) {
+		cd->maxSingleItemWidth = width;
+		cd->maxSingleItem = item;
+	    }
+	}
+	return 1;
+    }
+    if ((width < cs->maxNeededWidth) && (cs->maxItem == item))
+	return -1;
+    if (start == end) {
+	if (width > cd->maxSingleItemWidth) {
+	    cd->maxSingleItemWidth = width;
+	    cd->maxSingleItem = item;
+	    return 1;
+	}
+	if ((width < cd->maxSingleItemWidth) && (cd->maxSingleItem == item))
+	    return -1;
+    }
+    return 0;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * UpdatePendingWidths --
+ *
+ *	Handles the items passed to TreeColumns_InvalidateWidthOfItem
+ *	since the last layout.  Span records that only got wider are
+ *	updated in place and their columns are redistributed; otherwise
+ *	the columns are marked out-of-date so every item is asked for
+ *	its width again.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The widthOfItems field of columns may change.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+UpdatePendingWidths(
+    TreeCtrl *tree		/* Widget info. */
+    )
+{
+    TreeColumnPriv priv = tree->columnPriv;
+    TreeColumn column, columnMin, columnMax;
+    Tcl_HashEntry *hPtr;
+    TreeItem item;
+    ColumnSpan *cs;
+    int i, count = priv->pendingCount;
+
+    priv->pendingCount = 0;
+    if (priv->spansInvalid)
+	return;
+
+    InitColumnReqData(tree);
+    TreeElement_Batch(tree, ELEMENT_BATCH_NEEDED, TRUE);
+    for (i = 0; i < count; i++) {
+	column = priv->pending[i].column;
+	if (column->reqData.spanMin->widthOfItems < 0)
+	    continue;
+	hPtr = Tcl_FindHashEntry(&tree->itemHash,
+	    (char *) INT2PTR(priv->pending[i].itemId));
+	if (hPtr == NULL)
+	    continue;
+	item = (TreeItem) Tcl_GetHashValue(hPtr);
+	if (!TreeItem_ReallyVisible(tree, item))
+	    continue;
+	switch (RequestWidthOfItem(tree, item, column)) {
+	    case -1:
+		InvalidateSpanGroup(column);
+		break;
+	    case 1:
+		column->reqData.spanMin->reqData.redistribute = TRUE;
+		break;
+	}
+    }
+    TreeElement_Batch(tree, ELEMENT_BATCH_NEEDED, FALSE);
+
+    /* Distribute the wider spans again, one group of overlapping spans
+     * at a time. */
+    for (column = tree->columns; column != NULL; column = columnMax->next) {
+	columnMin = column->reqData.spanMin;
+	columnMax = column->reqData.spanMax;
+	while ((columnMax->next != NULL) &&
+		(columnMax->next->reqData.spanMin->index <= columnMax->index)) {
+	    columnMax = columnMax->next->reqData.spanMax;
+	}
+	for (column = columnMin; column != columnMax->next;
+		column = column->next) {
+	    if (column->reqData.redistribute)
+		break;
+	}
+	if (column == columnMax->next)
+	    continue;
+	for (column = columnMin; column != columnMax->next;
+		column = column->next) {
+	    column->reqData.redistribute = FALSE;
+	    if (column->reqData.spanMin->widthOfItems < 0)
+		break;
+	}
+	if (column != columnMax->next)
+	    continue;
+
+	priv->spansCur = NULL;
+	for (cs = priv->spans; cs != NULL; cs = cs->next) {
+	    if (cs->start->index < columnMin->index ||
+		    cs->end->index > columnMax->index) {
+		continue;
+	    }
+	    cs->nextCur = priv->spansCur;
+	    priv->spansCur = cs;
+	}
+	for (column = columnMin; column != columnMax->next;
+		column = column->next) {
+	    column->widthOfItems = 0;
+	    column->reqData.fat = TRUE;
+	}
+	DistributeSpanWidthToColumns(columnMin, columnMax);
+	TrimTheFat(columnMin, columnMax);
+    }
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -4373,6 +4768,9 @@ TreeColumn_WidthOfItems(
     if (IS_TAIL(column))
 	return 0;
 
+    if (priv->pendingCount > 0)
+	UpdatePendingWidths(tree);
+
     if (priv->spansInvalid) {
 	columnMin = tree->columns;
 	columnMax = tree->columnLast;
@@ -4409,6 +4807,7 @@ TreeColumn_WidthOfItems(
 		continue;
 	    }
 	    cs->maxNeededWidth = 0;
+	    cs->maxItem = NULL;
 	    cs->nextCur = priv->spansCur;
 	    priv->spansCur = cs;
 	}
@@ -4422,6 +4821,8 @@ TreeColumn_WidthOfItems(
 	    column2->reqData.maxSingleSpanWidth = 0;
 	    column2->reqData.maxSingleHeaderWidth = 0;
 	    column2->reqData.maxSingleItemWidth = 0;
+	    column2->reqData.maxSingleItem = NULL;
+	    column2->reqData.redistribute = FALSE;
 	    column2->reqData.fat = TRUE;
 	    if (priv->spansInvalid) {
 		column2->reqData.spanMin = column2->reqData.spanMax = column2;
@@ -4435,8 +4836,10 @@ TreeColumn_WidthOfItems(
 		priv->allSpansAreOne);
 #endif
 	InitColumnReqData(tree);
+	TreeElement_Batch(tree, ELEMENT_BATCH_NEEDED, TRUE);
 	TreeHeaders_RequestWidthInColumns(tree, columnMin, columnMax);
 	TreeItems_RequestWidthInColumns(tree, columnMin, columnMax);
+	TreeElement_Batch(tree, ELEMENT_BATCH_NEEDED, FALSE);
 	priv->spansInvalid = FALSE; /* Clear this *after* the above call. */
 	DistributeSpanWidthToColumns(columnMin, columnMax);
 	TrimTheFat(columnMin, columnMax);
@@ -4515,6 +4918,7 @@ TreeColumns_InvalidateSpans(
     )
 {
     tree->columnPriv->spansInvalid = TRUE;
+    tree->columnPriv->pendingCount = 0;
 }
 
 /*
@@ -4555,24 +4959,58 @@ TreeColumns_InvalidateWidthOfItems(
 	}
     } else if (!priv->spansInvalid &&
 	    column->reqData.spanMin != NULL) { /* spanMin/Max can be NULL during creation when spansInvalid hasn't been set TRUE yet */
-	TreeColumn columnMin = column->reqData.spanMin;
-	TreeColumn columnMax = column->reqData.spanMax;
-	columnMin->widthOfItems = -1;
+	InvalidateSpanGroup(column);
+    }
+    TreeColumns_InvalidateWidth(tree);
+}
 
-	/* Must recalculate the width of items in every span that overlaps
-	 * any of the spans that include this column. */
-	while ((columnMin->prev != NULL) &&
-		(columnMin->prev->reqData.spanMax->index >= columnMin->index)) {
-	    columnMin = columnMin->prev->reqData.spanMin;
-	    columnMin->widthOfItems = -1;
-	}
-	while ((columnMax->next != NULL) &&
-		(columnMax->next->reqData.spanMin->index <= columnMax->index)) {
-	    columnMax = columnMax->next->reqData.spanMax;
-	    columnMax->reqData.spanMin->widthOfItems = -1;
-	}
+/*
+ *----------------------------------------------------------------------
+ *
+ * TreeColumns_InvalidateWidthOfItem --
+ *
+ *	Marks the width requested by a single item in a single column
+ *	as out-of-date.  Unlike TreeColumns_InvalidateWidthOfItems,
+ *	the other items don't have to be asked for their width again
+ *	unless the item was the widest one in a span.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Memory may be allocated.  Idle task may be scheduled.
+ *
+ *----------------------------------------------------------------------
+ */
 
+void
+TreeColumns_InvalidateWidthOfItem(
+    TreeCtrl *tree,		/* Widget info. */
+    TreeItem item,		/* Item token. */
+    TreeColumn column		/* Column whose style changed. */
+    )
+{
+    TreeColumnPriv priv = tree->columnPriv;
+    PendingWidth *pw;
+
+    if (priv->spansInvalid || IS_TAIL(column) ||
+	    (column->reqData.spanMin == NULL) ||
+	    (column->reqData.spanMin->widthOfItems < 0) ||
+	    (TreeItem_GetHeader(tree, item) != NULL) ||
+	    (priv->pendingCount >= PENDING_WIDTH_MAX)) {
+	TreeColumns_InvalidateWidthOfItems(tree, column);
+	return;
+    }
+
+    if (priv->pendingAlloc < priv->pendingCount + 1) {
+	priv->pendingAlloc = priv->pendingCount + 10;
+	priv->pending = (PendingWidth *) ckrealloc((char *) priv->pending,
+	    sizeof(PendingWidth) * priv->pendingAlloc);
     }
+    pw = &priv->pending[priv->pendingCount++];
+    pw->itemId = TreeItem_GetID(tree, item);
+    pw->column = column;
+
     TreeColumns_InvalidateWidth(tree);
 }
 
@@ -5170,6 +5608,7 @@ TreeColumns_InvalidateCounts(
     tree->columnCountVis = -1;
     tree->columnCountVisLeft = -1;
     tree->columnCountVisRight = -1;
+    tree->columnPriv->byIndexInvalid = TRUE;
 }
 
 /*
@@ -5196,6 +5635,9 @@ TreeColumn_InitWidget(
 {
     TreeColumn column;
 
+    tree->columnPriv = (TreeColumnPriv) ckalloc(sizeof(struct TreeColumnPriv_));
+    memset((char *) tree->columnPriv, 0, sizeof(struct TreeColumnPriv_));
+
     column = Column_Alloc(tree);
     column->id = -1;
     column->reqData.spanMin = column->reqData.spanMax = column;
@@ -5212,9 +5654,6 @@ TreeColumn_InitWidget(
 #ifdef UNIFORM_GROUP
     Tcl_InitHashTable(&tree->uniformGroupHash, TCL_STRING_KEYS);
 #endif
-
-    tree->columnPriv = (TreeColumnPriv) ckalloc(sizeof(struct TreeColumnPriv_));
-    memset((char *) tree->columnPriv, 0, sizeof(struct TreeColumnPriv_));
 }
 
 /*
@@ -5266,6 +5705,10 @@ TreeColumn_FreeWidget(
 	    ckfree((char *) cs->spansToRight.spans);
 	ckfree((char *) cs);
     }
+    if (priv->pending != NULL)
+	ckfree((char *) priv->pending);
+    if (priv->byIndex != NULL)
+	ckfree((char *) priv->byIndex);
 
     ckfree((char *) priv);
 }
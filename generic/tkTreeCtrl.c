@@ -36,13 +36,27 @@
 #define TK_PHOTOPUTZOOMEDBLOCK	Tk_PhotoPutZoomedBlock
 #endif
 
+/* This structure is used for tinted copies of a photo image. */
+typedef struct TreeImageVariant TreeImageVariant;
+struct TreeImageVariant {
+    unsigned short red, green, blue; /* Tint color. */
+    Tk_Uid name;		/* Name of the tinted photo. */
+    Tk_Image image;		/* Instance of the tinted photo. */
+    TreeImageVariant *next;	/* Next variant of the same image. */
+};
+
 /* This structure is used for reference-counted images. */
 typedef struct TreeImageRef {
     int count;			/* Reference count. */
     Tk_Image image;		/* Image token. */
     Tcl_HashEntry *hPtr;	/* Entry in tree->imageNameHash. */
+    TreeCtrl *tree;		/* Widget info. */
+    TreeImageVariant *variants;	/* Tinted copies of the image created by
+				 * Tree_GetImageTinted(), or NULL. */
 } TreeImageRef;
 
+static void ImageRef_FreeVariants(TreeImageRef *ref);
+
 static CONST char *bgModeST[] = {
     "column", "order", "ordervisible", "row",
 #ifdef DEPRECATED
@@ -132,6 +146,9 @@ static Tk_OptionSpec optionSpecs[] = {
      Tk_Offset(TreeCtrl, canvasPadYObj),
      Tk_Offset(TreeCtrl, canvasPadY),
      0, (ClientData) &TreeCtrlCO_pad, TREE_CONF_RELAYOUT},
+    {TK_OPTION_BOOLEAN, "-coalesceselection", "coalesceSelection",
+     "CoalesceSelection", "0", -1, Tk_Offset(TreeCtrl, coalesceSelection),
+     0, (ClientData) NULL, 0},
     {TK_OPTION_STRING, "-columnprefix", "columnPrefix", "ColumnPrefix",
      "", -1, Tk_Offset(TreeCtrl, columnPrefix), 0, (ClientData) NULL, 0},
     {TK_OPTION_PIXELS, "-columnproxy", "columnProxy", "ColumnProxy",
@@ -452,7 +469,11 @@ TreeObjCmd(
 
     tree->configStateDomain = -1;
 
-    Tcl_InitHashTable(&tree->selection, TCL_ONE_WORD_KEYS);
+    TreeIdSet_Init(&tree->selection);
+    TreeIdSet_Init(&tree->selectPending);
+    TreeIdSet_Init(&tree->deselectPending);
+    TreeIdSet_Init(&tree->visiblePending);
+    TreeIdSet_Init(&tree->hiddenPending);
 
     /* Do this before Tree_InitColumns() which does Tk_InitOptions(), which
      * calls Tk_GetOption() which relies on the window class */
@@ -672,6 +693,10 @@ static int TreeWidgetCmd(
     Tcl_Preserve((ClientData) tree);
     Tree_PreserveItems(tree);
 
+    /* Apply any writes to -textvariable variables before the command
+     * looks at item sizes. */
+    TreeElement_UpdateTextVars(tree);
+
     switch (index) {
 	case COMMAND_ACTIVATE: {
 	    TreeItem active, item;
@@ -1203,6 +1228,8 @@ TreeConfigure(
     TreeCtrl saved;
     Tk_SavedOptions savedOptions;
     int oldShowRoot = tree->showRoot;
+    char *oldItemPrefix = tree->itemPrefix;
+    int oldItemTagExpr = tree->itemTagExpr;
     int buttonWidth, buttonHeight;
     int mask, maskFree = 0;
     XGCValues gcValues;
@@ -1461,6 +1488,10 @@ badWrap:
     }
 
     tree->itemPrefixLen = (int) strlen(tree->itemPrefix);
+    if ((tree->itemPrefix != oldItemPrefix) ||
+	    (tree->itemTagExpr != oldItemTagExpr)) {
+	TreeItem_InvalidateDescriptions(tree);
+    }
     tree->columnPrefixLen = (int) strlen(tree->columnPrefix);
 
     Tk_SetWindowBackground(tree->tkwin,
@@ -1838,6 +1869,7 @@ TreeDestroy(
     while (tree->regionStackLen > 0)
 	TkDestroyRegion(tree->regionStack[--tree->regionStackLen]);
 
+    TreeNotify_FreeWidget(tree);
     QE_DeleteBindingTable(tree->bindingTable);
 
     domainPtr = &tree->stateDomain[STATE_DOMAIN_ITEM];
@@ -1859,6 +1891,7 @@ TreeDestroy(
     hPtr = Tcl_FirstHashEntry(&tree->imageNameHash, &search);
     while (hPtr != NULL) {
 	TreeImageRef *ref = (TreeImageRef *) Tcl_GetHashValue(hPtr);
+	ImageRef_FreeVariants(ref);
 	Tk_FreeImage(ref->image);
 	ckfree((char *) ref);
 	hPtr = Tcl_NextHashEntry(&search);
@@ -1866,7 +1899,7 @@ TreeDestroy(
     Tcl_DeleteHashTable(&tree->imageNameHash);
     Tcl_DeleteHashTable(&tree->imageTokenHash);
 
-    Tcl_DeleteHashTable(&tree->selection);
+    TreeIdSet_Free(&tree->selection);
 
     /* Must be done after all gradient users are freed */
     TreeGradient_FreeWidget(tree);
@@ -2062,6 +2095,7 @@ Tree_AddItem(
     hPtr = Tcl_CreateHashEntry(&tree->itemHash, (char *) INT2PTR(id), &isNew);
     Tcl_SetHashValue(hPtr, item);
     tree->itemCount++;
+    tree->itemGeneration++;
 }
 
 /*
@@ -2102,7 +2136,13 @@ Tree_RemoveItem(
 	    (char *) INT2PTR(TreeItem_GetID(tree, item)));
     Tcl_DeleteHashEntry(hPtr);
     tree->itemCount--;
-    if (tree->itemCount == 1)
+    tree->itemGeneration++;
+
+    /* Don't reuse IDs that may still be reported by a coalesced
+     * <Selection> or <ItemVisibility> event. */
+    if (tree->itemCount == 1 && !tree->selectNotifyPending &&
+	    !TreeIdSet_Count(&tree->visiblePending) &&
+	    !TreeIdSet_Count(&tree->hiddenPending))
 	tree->nextItemId = TreeItem_GetID(tree, tree->root) + 1;
 }
 
@@ -2196,7 +2236,7 @@ Tree_RemoveHeader(
 
 static void
 ImageChangedProc(
-    ClientData clientData,		/* Widget info. */
+    ClientData clientData,		/* TreeImageRef. */
     int x, int y,			/* Upper left pixel (within image)
 					 * that must be redisplayed. */
     int width, int height,		/* Dimensions of area to redisplay
@@ -2205,7 +2245,11 @@ ImageChangedProc(
     )
 {
     /* I would like to know the image was deleted... */
-    TreeCtrl *tree = clientData;
+    TreeImageRef *ref = clientData;
+    TreeCtrl *tree = ref->tree;
+
+    /* Any tinted copies are out-of-date. */
+    ImageRef_FreeVariants(ref);
 
     /* FIXME: any image elements need to have their size invalidated
      * and items relayout'd accordingly. */
@@ -2254,16 +2298,19 @@ Tree_GetImage(
 
     hPtr = Tcl_CreateHashEntry(&tree->imageNameHash, imageName, &isNew);
     if (isNew) {
+	ref = (TreeImageRef *) ckalloc(sizeof(TreeImageRef));
 	image = Tk_GetImage(tree->interp, tree->tkwin, imageName,
-		ImageChangedProc, (ClientData) tree);
+		ImageChangedProc, (ClientData) ref);
 	if (image == NULL) {
+	    ckfree((char *) ref);
 	    Tcl_DeleteHashEntry(hPtr);
 	    return NULL;
 	}
-	ref = (TreeImageRef *) ckalloc(sizeof(TreeImageRef));
 	ref->count = 0;
 	ref->image = image;
 	ref->hPtr = hPtr;
+	ref->tree = tree;
+	ref->variants = NULL;
 	Tcl_SetHashValue(hPtr, ref);
 
 	h2Ptr = Tcl_CreateHashEntry(&tree->imageTokenHash, (char *) image,
@@ -2309,6 +2356,7 @@ Tree_FreeImage(
     if (hPtr != NULL) {
 	ref = (TreeImageRef *) Tcl_GetHashValue(hPtr);
 	if (--ref->count == 0) {
+	    ImageRef_FreeVariants(ref);
 	    Tcl_DeleteHashEntry(ref->hPtr); /* imageNameHash */
 	    Tcl_DeleteHashEntry(hPtr);
 	    Tk_FreeImage(ref->image);
@@ -2317,6 +2365,185 @@ Tree_FreeImage(
     }
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * ImageRef_FreeVariants --
+ *
+ *	Free every tinted copy of an image.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Photo images are deleted. Memory is freed.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+ImageRef_FreeVariants(
+    TreeImageRef *ref		/* Image whose variants are freed. */
+    )
+{
+    TreeImageVariant *variant;
+
+    while (ref->variants != NULL) {
+	variant = ref->variants;
+	ref->variants = variant->next;
+	Tk_FreeImage(variant->image);
+	Tk_DeleteImage(ref->tree->interp, variant->name);
+	ckfree((char *) variant);
+    }
+}
+
+static void
+VariantChangedProc(
+    ClientData clientData,		/* Not used. */
+    int x, int y,			/* Upper left pixel (within image)
+					 * that must be redisplayed. */
+    int width, int height,		/* Dimensions of area to redisplay
+					 * (may be <= 0). */
+    int imageWidth, int imageHeight	/* New dimensions of image. */
+    )
+{
+    /* The variants are never changed once created. */
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * Tree_GetImageTinted --
+ *
+ *	Return a copy of a photo image with every pixel blended 50% with
+ *	the given color. This is used to draw selected or disabled
+ *	versions of an image without the application having to create
+ *	and manage a second photo image for each one.
+ *
+ *	The copies are created once and remembered with the
+ *	reference-counted image until it is freed or changed, so drawing
+ *	a tinted image costs the same as drawing the original. Tk keeps
+ *	the pixels of each copy in a server-side pixmap.
+ *
+ * Results:
+ *	Token for the tinted image. If the image was not returned by
+ *	Tree_GetImage(), is not a photo image or the copy could not be
+ *	created, the original image token is returned.
+ *
+ * Side effects:
+ *	A photo image named "::TreeCtrl::ImageTint..." may be created.
+ *
+ *----------------------------------------------------------------------
+ */
+
+Tk_Image
+Tree_GetImageTinted(
+    TreeCtrl *tree,		/* Widget info. */
+    Tk_Image image,		/* Image from Tree_GetImage(). */
+    XColor *color		/* Tint color. */
+    )
+{
+    Tcl_HashEntry *hPtr;
+    TreeImageRef *ref;
+    TreeImageVariant *variant;
+    Tk_PhotoHandle photoH, tintH;
+    Tk_PhotoImageBlock block, tintBlock;
+    Tcl_DString dString;
+    Tcl_Obj *objv[4];
+    unsigned char *src, *dst;
+    int r = color->red >> 8, g = color->green >> 8, b = color->blue >> 8;
+    int x, y, result;
+    char buf[32];
+
+    hPtr = Tcl_FindHashEntry(&tree->imageTokenHash, (char *) image);
+    if (hPtr == NULL)
+	return image;
+    ref = (TreeImageRef *) Tcl_GetHashValue(hPtr);
+
+    for (variant = ref->variants; variant != NULL; variant = variant->next) {
+	if ((variant->red == color->red) && (variant->green == color->green) &&
+		(variant->blue == color->blue))
+	    return variant->image;
+    }
+
+    photoH = Tk_FindPhoto(tree->interp,
+	    Tcl_GetHashKey(&tree->imageNameHash, ref->hPtr));
+    if (photoH == NULL)
+	return image;
+    Tk_PhotoGetImage(photoH, &block);
+    if ((block.width <= 0) || (block.height <= 0) || (block.pixelSize != 4))
+	return image;
+
+    /* The name is unique for each widget, image and color. */
+    Tcl_DStringInit(&dString);
+    Tcl_DStringAppend(&dString, "::TreeCtrl::ImageTint", -1);
+    Tcl_DStringAppend(&dString, Tk_PathName(tree->tkwin), -1);
+    sprintf(buf, ",%04x%04x%04x,", color->red, color->green, color->blue);
+    Tcl_DStringAppend(&dString, buf, -1);
+    Tcl_DStringAppend(&dString,
+	    Tcl_GetHashKey(&tree->imageNameHash, ref->hPtr), -1);
+
+    objv[0] = Tcl_NewStringObj("image", -1);
+    objv[1] = Tcl_NewStringObj("create", -1);
+    objv[2] = Tcl_NewStringObj("photo", -1);
+    objv[3] = Tcl_NewStringObj(Tcl_DStringValue(&dString),
+	    Tcl_DStringLength(&dString));
+    for (x = 0; x < 4; x++)
+	Tcl_IncrRefCount(objv[x]);
+    result = Tcl_EvalObjv(tree->interp, 4, objv, TCL_EVAL_GLOBAL);
+    for (x = 0; x < 4; x++)
+	Tcl_DecrRefCount(objv[x]);
+    Tcl_ResetResult(tree->interp);
+    tintH = (result == TCL_OK) ?
+	Tk_FindPhoto(tree->interp, Tcl_DStringValue(&dString)) : NULL;
+    if (tintH == NULL) {
+	Tcl_DStringFree(&dString);
+	return image;
+    }
+
+    tintBlock = block;
+    tintBlock.pitch = block.width * 4;
+    tintBlock.offset[0] = 0;
+    tintBlock.offset[1] = 1;
+    tintBlock.offset[2] = 2;
+    tintBlock.offset[3] = 3;
+    tintBlock.pixelPtr = (unsigned char *) ckalloc(tintBlock.pitch *
+	    block.height);
+    for (y = 0; y < block.height; y++) {
+	src = block.pixelPtr + y * block.pitch;
+	dst = tintBlock.pixelPtr + y * tintBlock.pitch;
+	for (x = 0; x < block.width; x++) {
+	    dst[0] = (src[block.offset[0]] + r) / 2;
+	    dst[1] = (src[block.offset[1]] + g) / 2;
+	    dst[2] = (src[block.offset[2]] + b) / 2;
+	    dst[3] = src[block.offset[3]];
+	    src += 4;
+	    dst += 4;
+	}
+    }
+    TK_PHOTOPUTBLOCK(tree->interp, tintH, &tintBlock, 0, 0,
+	    block.width, block.height, TK_PHOTO_COMPOSITE_SET);
+    ckfree((char *) tintBlock.pixelPtr);
+
+    variant = (TreeImageVariant *) ckalloc(sizeof(TreeImageVariant));
+    variant->red = color->red;
+    variant->green = color->green;
+    variant->blue = color->blue;
+    variant->name = Tk_GetUid(Tcl_DStringValue(&dString));
+    variant->image = Tk_GetImage(tree->interp, tree->tkwin, variant->name,
+	    VariantChangedProc, (ClientData) NULL);
+    Tcl_DStringFree(&dString);
+    if (variant->image == NULL) {
+	Tk_DeleteImage(tree->interp, variant->name);
+	ckfree((char *) variant);
+	Tcl_ResetResult(tree->interp);
+	return image;
+    }
+    variant->next = ref->variants;
+    ref->variants = variant;
+    return variant->image;
+}
+
 /*
  *--------------------------------------------------------------
  *
@@ -2991,6 +3218,7 @@ Tree_StateCmd(
 	    }
 	    domainPtr->stateNames[slot] = ckalloc(length + 1);
 	    strcpy(domainPtr->stateNames[slot], string);
+	    TreeItem_InvalidateDescriptions(tree);
 	    break;
 	}
 
@@ -3042,6 +3270,7 @@ Tree_StateCmd(
 		ckfree(domainPtr->stateNames[index]);
 		domainPtr->stateNames[index] = NULL;
 	    }
+	    TreeItem_InvalidateDescriptions(tree);
 	    break;
 	}
     }
@@ -3054,7 +3283,7 @@ Tree_StateCmd(
  *
  * Tree_AddToSelection --
  *
- *	Add an item to the hash table of selected items. Turn on the
+ *	Add an item to the set of selected items. Turn on the
  *	STATE_ITEM_SELECTED state for the item.
  *
  * Results:
@@ -3072,8 +3301,6 @@ Tree_AddToSelection(
     TreeItem item		/* Item to add to the selection. */
     )
 {
-    int isNew;
-
 #ifdef SELECTION_VISIBLE
     if (!TreeItem_ReallyVisible(tree, item))
 	panic("Tree_AddToSelection: item %d not ReallyVisible",
@@ -3086,9 +3313,8 @@ Tree_AddToSelection(
 	panic("Tree_AddToSelection: item %d not enabled",
 		TreeItem_GetID(tree, item));
     TreeItem_ChangeState(tree, item, 0, STATE_ITEM_SELECTED);
-    Tcl_CreateHashEntry(&tree->selection, (char *) item, &isNew);
-    if (!isNew)
-	panic("Tree_AddToSelection: item %d already in selection hash table",
+    if (!TreeIdSet_Add(&tree->selection, TreeItem_GetID(tree, item)))
+	panic("Tree_AddToSelection: item %d already in selection set",
 		TreeItem_GetID(tree, item));
     tree->selectCount++;
 }
@@ -3098,7 +3324,7 @@ Tree_AddToSelection(
  *
  * Tree_RemoveFromSelection --
  *
- *	Remove an item from the hash table of selected items. Turn off the
+ *	Remove an item from the set of selected items. Turn off the
  *	STATE_ITEM_SELECTED state for the item.
  *
  * Results:
@@ -3116,20 +3342,51 @@ Tree_RemoveFromSelection(
     TreeItem item		/* Item to remove from the selection. */
     )
 {
-    Tcl_HashEntry *hPtr;
-
     if (!TreeItem_GetSelected(tree, item))
 	panic("Tree_RemoveFromSelection: item %d isn't selected",
 		TreeItem_GetID(tree, item));
     TreeItem_ChangeState(tree, item, STATE_ITEM_SELECTED, 0);
-    hPtr = Tcl_FindHashEntry(&tree->selection, (char *) item);
-    if (hPtr == NULL)
-	panic("Tree_RemoveFromSelection: item %d not found in selection hash table",
+    if (!TreeIdSet_Remove(&tree->selection, TreeItem_GetID(tree, item)))
+	panic("Tree_RemoveFromSelection: item %d not found in selection set",
 		TreeItem_GetID(tree, item));
-    Tcl_DeleteHashEntry(hPtr);
     tree->selectCount--;
 }
 
+/*
+ *--------------------------------------------------------------
+ *
+ * Tree_GetSelection --
+ *
+ *	Append every selected item to a list, in order of increasing
+ *	item id.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	None.
+ *
+ *--------------------------------------------------------------
+ */
+
+void
+Tree_GetSelection(
+    TreeCtrl *tree,		/* Widget info */
+    TreeItemList *items		/* Initialized list to append to. */
+    )
+{
+    Tcl_HashEntry *hPtr;
+    int id;
+
+    TreePtrList_Grow(items, TreeItemList_Count(items) + tree->selectCount);
+    for (id = TreeIdSet_Next(&tree->selection, 0);
+	    id != -1;
+	    id = TreeIdSet_Next(&tree->selection, id + 1)) {
+	hPtr = Tcl_FindHashEntry(&tree->itemHash, (char *) INT2PTR(id));
+	TreeItemList_Append(items, (TreeItem) Tcl_GetHashValue(hPtr));
+    }
+}
+
 /*
  *--------------------------------------------------------------
  *
@@ -3270,8 +3527,6 @@ doneADD:
 	case COMMAND_CLEAR: {
 	    int i, count;
 	    TreeItemList items;
-	    Tcl_HashEntry *hPtr;
-	    Tcl_HashSearch search;
 
 	    if (objc > 5) {
 		Tcl_WrongNumArgs(interp, 3, objv, "?first? ?last?");
@@ -3299,12 +3554,7 @@ doneADD:
 		if (objc >= 4) TreeItemList_Free(&itemsFirst);
 		if (objc == 5) TreeItemList_Free(&itemsLast);
 		TreeItemList_Init(tree, &items, tree->selectCount);
-		hPtr = Tcl_FirstHashEntry(&tree->selection, &search);
-		while (hPtr != NULL) {
-		    item = (TreeItem) Tcl_GetHashKey(&tree->selection, hPtr);
-		    TreeItemList_Append(&items, item);
-		    hPtr = Tcl_NextHashEntry(&search);
-		}
+		Tree_GetSelection(tree, &items);
 		count = TreeItemList_Count(&items);
 		for (i = 0; i < count; i++)
 		    Tree_RemoveFromSelection(tree, TreeItemList_Nth(&items, i));
@@ -3359,7 +3609,6 @@ doneCLEAR:
 	    TreeItem item;
 	    Tcl_Obj *listObj;
 	    Tcl_HashEntry *hPtr;
-	    Tcl_HashSearch search;
 
 #ifdef SELECTION_VISIBLE
 	    if (objc < 3 || objc > 5) {
@@ -3390,12 +3639,7 @@ doneCLEAR:
 
 		/* Build a list of selected items. */
 		TreeItemList_Init(tree, &items, tree->selectCount);
-		hPtr = Tcl_FirstHashEntry(&tree->selection, &search);
-		while (hPtr != NULL) {
-		    item = (TreeItem) Tcl_GetHashKey(&tree->selection, hPtr);
-		    TreeItemList_Append(&items, item);
-		    hPtr = Tcl_NextHashEntry(&search);
-		}
+		Tree_GetSelection(tree, &items);
 
 		/* Sort it. */
 		TreeItemList_Sort(&items);
@@ -3428,12 +3672,13 @@ doneCLEAR:
 	    if (tree->selectCount < 1)
 		break;
 	    listObj = Tcl_NewListObj(0, NULL);
-	    hPtr = Tcl_FirstHashEntry(&tree->selection, &search);
-	    while (hPtr != NULL) {
-		item = (TreeItem) Tcl_GetHashKey(&tree->selection, hPtr);
+	    for (index = TreeIdSet_Next(&tree->selection, 0);
+		    index != -1;
+		    index = TreeIdSet_Next(&tree->selection, index + 1)) {
+		hPtr = Tcl_FindHashEntry(&tree->itemHash, (char *) INT2PTR(index));
+		item = (TreeItem) Tcl_GetHashValue(hPtr);
 		Tcl_ListObjAppendElement(interp, listObj,
 			TreeItem_ToObj(tree, item));
-		hPtr = Tcl_NextHashEntry(&search);
 	    }
 	    Tcl_SetObjResult(interp, listObj);
 	    break;
@@ -3455,7 +3700,9 @@ doneCLEAR:
 	    int i, j, k, objcS, objcD;
 	    Tcl_Obj **objvS, **objvD;
 	    Tcl_HashEntry *hPtr;
+#ifndef SELECTION_VISIBLE
 	    Tcl_HashSearch search;
+#endif
 	    TreeItem item;
 	    TreeItemList items;
 	    TreeItemList itemS, itemD, newS, newD;
@@ -3575,9 +3822,11 @@ doneCLEAR:
 	    /* Deselect all */
 	    if (allD) {
 		TreeItemList_Init(tree, &newD, tree->selectCount);
-		hPtr = Tcl_FirstHashEntry(&tree->selection, &search);
-		while (hPtr != NULL) {
-		    item = (TreeItem) Tcl_GetHashKey(&tree->selection, hPtr);
+		for (i = TreeIdSet_Next(&tree->selection, 0);
+			i != -1;
+			i = TreeIdSet_Next(&tree->selection, i + 1)) {
+		    hPtr = Tcl_FindHashEntry(&tree->itemHash, (char *) INT2PTR(i));
+		    item = (TreeItem) Tcl_GetHashValue(hPtr);
 		    /* Don't deselect an item in the select list */
 		    for (j = 0; j < TreeItemList_Count(&itemS); j++) {
 			if (item == TreeItemList_Nth(&itemS, j))
@@ -3586,7 +3835,6 @@ doneCLEAR:
 		    if (j == TreeItemList_Count(&itemS)) {
 			TreeItemList_Append(&newD, item);
 		    }
-		    hPtr = Tcl_NextHashEntry(&search);
 		}
 	    }
 
@@ -238,6 +238,18 @@ struct TreePtrList {
 				 * where the list is small. */
 };
 
+/*
+ * A TreeIdSet is a bitset of non-negative integers such as item ids.
+ * Zero words are skipped when walking the set, so a few ids spread over
+ * a large range are cheap to enumerate.
+ */
+typedef struct TreeIdSet TreeIdSet;
+struct TreeIdSet {
+    unsigned long *words;	/* One bit per id, NULL if never grown. */
+    int numWords;		/* Number of words at words[]. */
+    int count;			/* Number of ids in the set. */
+};
+
 enum { LEFT, TOP, RIGHT, BOTTOM };
 
 /* A structure of the following type is kept for each TreeCtrl to hold the
@@ -372,6 +384,7 @@ struct TreeCtrl
     int indent;			/* pixels: offset of child relative to
 				 * parent */
     char *selectMode;		/* -selectmode: used by scripts only */
+    int coalesceSelection;	/* -coalesceselection */
     Tcl_Obj *itemHeightObj;	/* -itemheight: Fixed height for all items
                                     (unless overridden) */
     int itemHeight;		/* -itemheight */
@@ -449,6 +462,8 @@ struct TreeCtrl
     int gotFocus;		/* flag */
     int deleted;		/* flag */
     int updateIndex;		/* flag */
+    int itemGeneration;		/* Changes whenever an item is created,
+				 * deleted or moved. */
     int isActive;		/* flag: mac & win "active" toplevel */
     struct {
 	int left;
@@ -523,6 +538,8 @@ struct TreeCtrl
     int nextColumnId;
     Tcl_HashTable itemHash;	/* TreeItem.id -> TreeItem */
     Tcl_HashTable itemSpansHash; /* TreeItem -> nothing */
+    Tcl_HashTable itemTagHash;	/* Tag -> items with that tag, see
+				 * TagIndex_Init */
     Tcl_HashTable elementHash;	/* Element.name -> Element */
     Tcl_HashTable styleHash;	/* Style.name -> Style */
     Tcl_HashTable imageNameHash;  /* image name -> TreeImageRef */
@@ -536,7 +553,19 @@ struct TreeCtrl
     TreeMarquee marquee;
     TreeDInfo dInfo;
     int selectCount;		/* Number of selected items */
-    Tcl_HashTable selection;	/* Selected items */
+    TreeIdSet selection;	/* IDs of selected items */
+    TreeIdSet selectPending;	/* IDs of items selected or deselected */
+    TreeIdSet deselectPending;	/* since the last coalesced <Selection>
+				 * event. */
+    int selectNotifyPending;	/* TRUE if a coalesced <Selection> event
+				 * is scheduled. */
+    double scrollPending[4];	/* Fractions for the deferred <Scroll-x>
+				 * and <Scroll-y> events. */
+    int scrollPendingMask;	/* 1 if <Scroll-x> is deferred, 2 if
+				 * <Scroll-y> is deferred. */
+    TreeIdSet visiblePending;	/* IDs of items that became visible or */
+    TreeIdSet hiddenPending;	/* hidden since the last deferred
+				 * <ItemVisibility> event. */
 
 #define TREE_WRAP_NONE 0
 #define TREE_WRAP_ITEMS 1
@@ -582,6 +611,7 @@ struct TreeCtrl
     int preserveItemRefCnt;	/* Ref count so items-in-use aren't freed. */
     TreeItemList preserveItemList;	/* List of items to be deleted when
 				 * preserveItemRefCnt==0. */
+    int elementBatchDepth;	/* Nesting of TreeElement_Batch() calls. */
 
     struct {
 	Tcl_Obj *yObj;
@@ -601,6 +631,8 @@ struct TreeCtrl
 
     int itemTagExpr;		/* Enable/disable operators in item tags */
     int columnTagExpr;		/* Enable/disable operators in column tags */
+    int itemDescGeneration;	/* Changes when item descriptions must be
+				 * parsed again. */
 
     Tk_OptionTable gradientOptionTable;
     Tcl_HashTable gradientHash;	/* TreeGradient.name -> TreeGradient */
@@ -613,6 +645,9 @@ struct TreeCtrl
     int headerCount;
     int nextHeaderId;
     Tcl_HashTable headerHash;	/* TreeItem.id -> TreeItem */
+    int headerCacheEpoch;	/* Header-column pixmaps drawn in an earlier
+				 * epoch are out-of-date. */
+    int headerCacheCount;	/* Number of header-column pixmaps. */
     int tailExtend;		/* This is the distance the tail column
 				 * extends past the right edge of the
 				 * content area. */
@@ -640,6 +675,19 @@ struct TreeCtrl
     Tcl_Obj *stringClockObj;	/* clock */
     Tcl_Obj *stringFormatObj;	/* format */
     Tcl_Obj *optionFormatObj;	/* -format */
+    Tcl_HashTable textFormatHash; /* -format strings of text elements,
+				 * parsed by TextFormat_Get(). */
+    char *textFormatTZ;		/* Value of $TZ when the C library's
+				 * timezone was last set, or NULL. */
+    Tcl_HashTable textVarHash;	/* Text elements whose -textvariable was
+				 * written since the last call to
+				 * TreeElement_UpdateTextVars(). */
+    struct ImageRequest *imageRequests; /* Pending -imagecommand calls
+				 * for image elements, oldest first. */
+    Tcl_HashTable imageCalledHash; /* Item id -> list of cells whose
+				 * -imagecommand was already called. */
+    struct WindowRequest *windowRequests; /* Pending -windowcommand calls
+				 * for window elements, oldest first. */
 
     TreeColumnPriv columnPriv;
     ClientData itemSpanPriv;
@@ -675,10 +723,13 @@ MODULE_SCOPE void Tree_AddHeader(TreeCtrl *tree, TreeItem item);
 MODULE_SCOPE void Tree_RemoveHeader(TreeCtrl *tree, TreeItem item);
 MODULE_SCOPE Tk_Image Tree_GetImage(TreeCtrl *tree, char *imageName);
 MODULE_SCOPE void Tree_FreeImage(TreeCtrl *tree, Tk_Image image);
+MODULE_SCOPE Tk_Image Tree_GetImageTinted(TreeCtrl *tree, Tk_Image image,
+    XColor *color);
 MODULE_SCOPE void Tree_UpdateScrollbarX(TreeCtrl *tree);
 MODULE_SCOPE void Tree_UpdateScrollbarY(TreeCtrl *tree);
 MODULE_SCOPE void Tree_AddToSelection(TreeCtrl *tree, TreeItem item);
 MODULE_SCOPE void Tree_RemoveFromSelection(TreeCtrl *tree, TreeItem item);
+MODULE_SCOPE void Tree_GetSelection(TreeCtrl *tree, TreeItemList *items);
 MODULE_SCOPE void Tree_PreserveItems(TreeCtrl *tree);
 MODULE_SCOPE void Tree_ReleaseItems(TreeCtrl *tree);
 
@@ -776,6 +827,8 @@ MODULE_SCOPE int TreeHeaderColumn_StateChanged(TreeHeader header,
     TreeHeaderColumn column, TreeColumn treeColumn, int state1, int state2);
 MODULE_SCOPE int TreeHeaderColumn_DragBounds(TreeHeader header,
     TreeHeaderColumn column, StyleDrawArgs *drawArgs, int dragPosition);
+MODULE_SCOPE void TreeHeader_InvalidateDrawCache(TreeCtrl *tree,
+    TreeItem item, TreeColumn treeColumn);
 MODULE_SCOPE void TreeHeaderColumn_Draw(TreeHeader header,
     TreeHeaderColumn column, int visIndex, StyleDrawArgs *drawArgs,
     int dragPosition);
@@ -800,6 +853,7 @@ MODULE_SCOPE Tk_ObjCustomOption TreeCtrlCO_header;
 #define IFO_LIST_ALL	0x0010	/* ItemFromObj flag: return "all" as list */
 MODULE_SCOPE int TreeItemList_FromObj(TreeCtrl *tree, Tcl_Obj *objPtr, TreeItemList *items, int flags);
 MODULE_SCOPE int TreeItem_FromObj(TreeCtrl *tree, Tcl_Obj *objPtr, TreeItem *itemPtr, int flags);
+MODULE_SCOPE void TreeItem_InvalidateDescriptions(TreeCtrl *tree);
 
 typedef struct ItemForEach ItemForEach;
 struct ItemForEach {
@@ -978,6 +1032,13 @@ MODULE_SCOPE void TreeItems_RequestWidthInColumns(TreeCtrl *tree,
 MODULE_SCOPE int TreeElement_InitInterp(Tcl_Interp *interp);
 MODULE_SCOPE int TreeElement_InitWidget(TreeCtrl *tree);
 MODULE_SCOPE void TreeElement_FreeWidget(TreeCtrl *tree);
+MODULE_SCOPE void TreeElement_ItemDeleted(TreeCtrl *tree, TreeItem item);
+MODULE_SCOPE void TreeElement_ColumnDeleted(TreeCtrl *tree, TreeColumn column);
+#define ELEMENT_BATCH_DISPLAY 0
+#define ELEMENT_BATCH_NEEDED 1
+MODULE_SCOPE void TreeElement_UpdateTextVars(TreeCtrl *tree);
+MODULE_SCOPE void TreeElement_UpdateWindowPool(TreeCtrl *tree);
+MODULE_SCOPE void TreeElement_Batch(TreeCtrl *tree, int what, int begin);
 MODULE_SCOPE int TreeStateFromObj(TreeCtrl *tree, int domain, Tcl_Obj *obj, int *stateOff, int *stateOn);
 MODULE_SCOPE int StringTableCO_Init(Tk_OptionSpec *optionTable, CONST char *optionName, CONST char **tablePtr);
 
@@ -1053,15 +1114,18 @@ MODULE_SCOPE void Tree_UndefineState(TreeCtrl *tree, int domain, int state);
 MODULE_SCOPE int TreeStyle_NumElements(TreeCtrl *tree, TreeStyle style_);
 MODULE_SCOPE int TreeStyle_IsHeaderStyle(TreeCtrl *tree, TreeStyle style);
 MODULE_SCOPE int TreeStyle_HasHeaderElement(TreeCtrl *tree, TreeStyle style);
+MODULE_SCOPE int TreeStyle_HasWindowElement(TreeCtrl *tree, TreeStyle style);
 MODULE_SCOPE TreeStyle Tree_MakeHeaderStyle(TreeCtrl *tree, HeaderStyleParams *params);
 MODULE_SCOPE void TreeStyle_UpdateWindowPositions(StyleDrawArgs *drawArgs);
-MODULE_SCOPE void TreeStyle_OnScreen(TreeCtrl *tree, TreeStyle style_, int onScreen);
+MODULE_SCOPE void TreeStyle_OnScreen(TreeCtrl *tree, TreeItem item,
+    TreeColumn column, TreeStyle style_, int onScreen);
 
 MODULE_SCOPE void Tree_ButtonMaxSize(TreeCtrl *tree, int *maxWidth, int *maxHeight);
 MODULE_SCOPE int Tree_ButtonHeight(TreeCtrl *tree, int state);
 
 /* tkTreeNotify.c */
 MODULE_SCOPE int TreeNotify_InitWidget(TreeCtrl *tree);
+MODULE_SCOPE void TreeNotify_FreeWidget(TreeCtrl *tree);
 MODULE_SCOPE void TreeNotify_OpenClose(TreeCtrl *tree, TreeItem item, int isOpen, int before);
 MODULE_SCOPE void TreeNotify_Selection(TreeCtrl *tree, TreeItemList *select, TreeItemList *deselect);
 MODULE_SCOPE int TreeNotifyCmd(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *CONST objv[]);
@@ -1076,6 +1140,8 @@ MODULE_SCOPE Tk_ObjCustomOption TreeCtrlCO_column_NOT_TAIL;
 MODULE_SCOPE int TreeColumn_InitInterp(Tcl_Interp *interp);
 MODULE_SCOPE void TreeColumn_InitWidget(TreeCtrl *tree);
 MODULE_SCOPE TreeColumn Tree_FindColumn(TreeCtrl *tree, int columnIndex);
+MODULE_SCOPE int Tree_ColumnsInRange(TreeCtrl *tree, int lock, int minX,
+    int maxX, TreeColumn *firstPtr, TreeColumn *lastPtr);
 MODULE_SCOPE int TreeColumn_FirstAndLast(TreeColumn *first, TreeColumn *last);
 
 #define COLUMN_ALL ((TreeColumn) -1)	/* Every column. */
@@ -1154,6 +1220,8 @@ MODULE_SCOPE int TreeColumn_WidthOfHeaders(TreeColumn column_);
 MODULE_SCOPE void TreeColumn_InvalidateWidth(TreeColumn column_);
 MODULE_SCOPE void TreeColumn_FreeWidget(TreeCtrl *tree);
 MODULE_SCOPE void TreeColumns_InvalidateWidthOfItems(TreeCtrl *tree, TreeColumn column);
+MODULE_SCOPE void TreeColumns_InvalidateWidthOfItem(TreeCtrl *tree, TreeItem item,
+    TreeColumn column);
 MODULE_SCOPE void TreeColumns_InvalidateWidth(TreeCtrl *tree);
 MODULE_SCOPE void TreeColumns_InvalidateSpans(TreeCtrl *tree);
 MODULE_SCOPE int TreeColumn_Bbox(TreeColumn column, int *x, int *y, int *w, int *h);
@@ -1491,6 +1559,14 @@ MODULE_SCOPE void TreePtrList_Free(TreePtrList *tilPtr);
 #define TreeItemList_Count(L) ((L)->count)
 MODULE_SCOPE void TreeItemList_Sort(TreeItemList *items);
 
+MODULE_SCOPE void TreeIdSet_Init(TreeIdSet *set);
+MODULE_SCOPE void TreeIdSet_Free(TreeIdSet *set);
+MODULE_SCOPE int TreeIdSet_Add(TreeIdSet *set, int id);
+MODULE_SCOPE int TreeIdSet_Remove(TreeIdSet *set, int id);
+MODULE_SCOPE int TreeIdSet_Contains(TreeIdSet *set, int id);
+MODULE_SCOPE int TreeIdSet_Next(TreeIdSet *set, int id);
+#define TreeIdSet_Count(S) ((S)->count)
+
 #define TreeColumnList_Init TreePtrList_Init
 #define TreeColumnList_Append TreePtrList_Append
 #define TreeColumnList_Concat TreePtrList_Concat
@@ -1525,31 +1601,28 @@ MODULE_SCOPE Tk_ObjCustomOption TreeCtrlCO_tagInfo;
 /*
  * This struct holds information about a tag expression.
  */
+typedef struct TagExprCode TagExprCode;
 typedef struct TagExpr {
     TreeCtrl *tree;
-
-    Tk_Uid *uids;		/* expresion compiled to an array of uids */
-    Tk_Uid staticUids[15];
-    int allocated;		/* available space for array of uids */
-    int length;			/* number of uids */
-    int index;			/* current position in expression evaluation */
-
-    int simple;			/* TRUE if expr is single tag */
-    Tk_Uid uid;			/* single tag if 'simple' is TRUE */
-
-    char *string;		/* tag expression string */
-    int stringIndex;		/* current position in string scan */
-    int stringLength;		/* length of tag expression string */
-
-    char *rewritebuffer;	/* tag string (after removing escapes) */
-    char staticRWB[100];
+    TagExprCode *code;		/* Compiled expression, shared with the
+				 * Tcl_Obj it came from. */
 } TagExpr;
 
 MODULE_SCOPE int TagExpr_Init(TreeCtrl *tree, Tcl_Obj *exprObj, TagExpr *expr);
-MODULE_SCOPE int TagExpr_Scan(TagExpr *expr);
 MODULE_SCOPE int TagExpr_Eval(TagExpr *expr, TagInfo *tags);
+MODULE_SCOPE int TagExpr_Candidates(TagExpr *expr, Tcl_HashTable *tagIndex,
+    TreePtrList *owners);
 MODULE_SCOPE void TagExpr_Free(TagExpr *expr);
 
+MODULE_SCOPE void TagIndex_Init(Tcl_HashTable *tagIndex);
+MODULE_SCOPE void TagIndex_Free(Tcl_HashTable *tagIndex);
+MODULE_SCOPE void TagIndex_Add(Tcl_HashTable *tagIndex, ClientData owner,
+    Tk_Uid tags[], int numTags);
+MODULE_SCOPE void TagIndex_Remove(Tcl_HashTable *tagIndex, ClientData owner,
+    Tk_Uid tags[], int numTags);
+MODULE_SCOPE int TagIndex_Find(Tcl_HashTable *tagIndex, Tk_Uid tags[],
+    int numTags, TreePtrList *owners);
+
 MODULE_SCOPE Tk_OptionSpec *Tree_FindOptionSpec(Tk_OptionSpec *optionTable, CONST char *optionName);
 
 MODULE_SCOPE Tk_ObjCustomOption *PerStateCO_Alloc(CONST char *optionName,
@@ -1565,7 +1638,8 @@ typedef struct DynamicOption DynamicOption;
 struct DynamicOption
 {
     int id;			/* Unique id. */
-    DynamicOption *next;	/* Linked list. */
+    DynamicOption *next;	/* Linked list. The first record is an index
+				 * used to find the others quickly. */
     char data[1];		/* Actual size will be > 1 */
 };
 
@@ -2957,7 +2957,7 @@ GetOnScreenColumnsForItem(
  *
  * Results:
  *	Hides window elements for columns that are no longer
- *	onscreen.
+ *	onscreen, and tells elements in newly-onscreen columns.
  *
  * Side effects:
  *	Memory may be allocated.
@@ -3012,6 +3012,16 @@ TrackOnScreenColumnsForItem(
 		else
 		    DStringAppendf(&dString, " +%d", TreeColumn_GetID(column));
 	    }
+	    if (column != tree->columnTail) {
+		TreeItemColumn itemColumn = TreeItem_FindColumn(tree, item,
+		    TreeColumn_Index(column));
+		if (itemColumn != NULL) {
+		    TreeStyle style = TreeItemColumn_GetStyle(tree,
+			itemColumn);
+		    if (style != NULL)
+			TreeStyle_OnScreen(tree, item, column, style, TRUE);
+		}
+	    }
 	    n++;
 	}
     }
@@ -3029,7 +3039,8 @@ TrackOnScreenColumnsForItem(
 	    if (itemColumn != NULL) {
 		TreeStyle style = TreeItemColumn_GetStyle(tree, itemColumn);
 		if (style != NULL)
-		    TreeStyle_OnScreen(tree, style, FALSE);
+		    TreeStyle_OnScreen(tree, item, column, style,
+			    FALSE);
 	    }
 	    if (tree->debug.enable && tree->debug.span) {
 		if (column == tree->columnTail)
@@ -6904,6 +6915,10 @@ TrackItemVisibility(
 	}
     }
 
+    /* Bind or release pooled windows of window elements. */
+    if (!tree->deleted)
+	TreeElement_UpdateWindowPool(tree);
+
     TreeItemList_Free(&newV);
     TreeItemList_Free(&newH);
 
@@ -7053,9 +7068,13 @@ Tree_Display(
      * label. */
     Tcl_Preserve((ClientData) tree);
     Tree_PreserveItems(tree);
+    TreeElement_Batch(tree, ELEMENT_BATCH_DISPLAY, TRUE);
 
 displayRetry:
 
+    /* A script run since the last pass may have written a -textvariable. */
+    TreeElement_UpdateTextVars(tree);
+
     SetBuffering(tree);
 
     /* Some change requires selection changes */
@@ -7716,6 +7735,11 @@ displayExit:
     }
 #endif
     dInfo->flags &= ~(DINFO_REDRAW_PENDING);
+    /* A -textvariable was written after the last retry; it would otherwise
+     * be displayed with its old size until something else redraws. */
+    if (!tree->deleted && tree->textVarHash.numEntries != 0)
+	Tree_EventuallyRedraw(tree);
+    TreeElement_Batch(tree, ELEMENT_BATCH_DISPLAY, FALSE);
     Tree_ReleaseItems(tree);
     Tcl_Release((ClientData) tree);
 }
@@ -8700,6 +8724,7 @@ Tree_FreeItemDInfo(
 	    tree->headerHeight = -1;
 	    dInfo->flags |= DINFO_DRAW_HEADER;
 	    dItemHeadPtr = &dInfo->dItemHeader;
+	    TreeHeader_InvalidateDrawCache(tree, NULL, NULL);
 	}
 	dItem = (DItem *) TreeItem_GetDInfo(tree, item);
 	if (dItem != NULL) {
@@ -8753,6 +8778,8 @@ Tree_InvalidateItemDInfo(
 
     if (item != NULL && TreeItem_GetHeader(tree, item) != NULL) {
 	dInfo->flags |= DINFO_DRAW_HEADER;
+	TreeHeader_InvalidateDrawCache(tree,
+	    (item2 == NULL || item2 == item1) ? item1 : NULL, column);
     }
 
     if (dInfo->flags & (DINFO_INVALIDATE | DINFO_REDO_COLUMN_WIDTH))
@@ -9052,6 +9079,8 @@ Tree_DInfoChanged(
 {
     TreeDInfo dInfo = tree->dInfo;
 
+    if (flags & DINFO_INVALIDATE)
+	TreeHeader_InvalidateDrawCache(tree, NULL, NULL);
     dInfo->flags |= flags;
     Tree_EventuallyRedraw(tree);
 }
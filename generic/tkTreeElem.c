@@ -617,6 +617,502 @@ static void AdjustForSticky(int sticky, int cavityWidth, int cavityHeight,
 
 /*****/
 
+typedef struct ElementBar ElementBar;
+
+struct ElementBar
+{
+    TreeElement_ header;
+    Tcl_Obj *dataObj;		/* -data */
+    double *values;		/* -data converted to numbers, or NULL. */
+    int numValues;		/* Size of values[]. */
+    Tcl_Obj *minObj;		/* -min */
+    double min;
+    Tcl_Obj *maxObj;		/* -max */
+    double max;
+    PerStateInfo fill;		/* -fill */
+    int lineWidth;		/* -linewidth */
+    Tcl_Obj *lineWidthObj;
+    int width;			/* -width */
+    Tcl_Obj *widthObj;
+    int height;			/* -height */
+    Tcl_Obj *heightObj;
+};
+
+#define BAR_CONF_DATA 0x0001
+#define BAR_CONF_RANGE 0x0002
+#define BAR_CONF_FILL 0x0004
+#define BAR_CONF_LINEWIDTH 0x0008
+#define BAR_CONF_SIZE 0x0010
+
+static Tk_OptionSpec barOptionSpecs[] = {
+    {TK_OPTION_STRING, "-data", (char *) NULL, (char *) NULL,
+     (char *) NULL, Tk_Offset(ElementBar, dataObj), -1,
+     TK_OPTION_NULL_OK, (ClientData) NULL, BAR_CONF_DATA},
+    {TK_OPTION_CUSTOM, "-fill", (char *) NULL, (char *) NULL,
+     (char *) NULL,
+     Tk_Offset(ElementBar, fill.obj), Tk_Offset(ElementBar, fill),
+     TK_OPTION_NULL_OK, (ClientData) NULL, BAR_CONF_FILL},
+    {TK_OPTION_PIXELS, "-height", (char *) NULL, (char *) NULL,
+     (char *) NULL, Tk_Offset(ElementBar, heightObj),
+     Tk_Offset(ElementBar, height),
+     TK_OPTION_NULL_OK, (ClientData) NULL, BAR_CONF_SIZE},
+    {TK_OPTION_PIXELS, "-linewidth", (char *) NULL, (char *) NULL,
+     (char *) NULL, Tk_Offset(ElementBar, lineWidthObj),
+     Tk_Offset(ElementBar, lineWidth),
+     TK_OPTION_NULL_OK, (ClientData) NULL, BAR_CONF_LINEWIDTH},
+    {TK_OPTION_STRING, "-max", (char *) NULL, (char *) NULL,
+     (char *) NULL, Tk_Offset(ElementBar, maxObj), -1,
+     TK_OPTION_NULL_OK, (ClientData) NULL, BAR_CONF_RANGE},
+    {TK_OPTION_STRING, "-min", (char *) NULL, (char *) NULL,
+     (char *) NULL, Tk_Offset(ElementBar, minObj), -1,
+     TK_OPTION_NULL_OK, (ClientData) NULL, BAR_CONF_RANGE},
+    {TK_OPTION_PIXELS, "-width", (char *) NULL, (char *) NULL,
+     (char *) NULL, Tk_Offset(ElementBar, widthObj),
+     Tk_Offset(ElementBar, width),
+     TK_OPTION_NULL_OK, (ClientData) NULL, BAR_CONF_SIZE},
+    {TK_OPTION_END, (char *) NULL, (char *) NULL, (char *) NULL,
+     (char *) NULL, 0, -1, 0, (ClientData) NULL, 0}
+};
+
+/* Get a finite number for -data, -min or -max. Inf and NaN would make
+ * BarFraction() return NaN, which can't be converted to a coordinate. */
+static int
+BarGetDouble(
+    Tcl_Interp *interp,
+    Tcl_Obj *objPtr,
+    double *doublePtr
+    )
+{
+    double d;
+
+    if (Tcl_GetDoubleFromObj(interp, objPtr, &d) != TCL_OK)
+	return TCL_ERROR;
+    /* Only false for Inf and NaN. */
+    if ((d - d) != 0.0) {
+	FormatResult(interp, "bad number \"%s\": must be finite",
+	    Tcl_GetString(objPtr));
+	return TCL_ERROR;
+    }
+    *doublePtr = d;
+    return TCL_OK;
+}
+
+/* Check that a -height, -linewidth or -width is not negative. */
+static int
+BarCheckPixels(
+    Tcl_Interp *interp,
+    Tcl_Obj *objPtr,
+    int pixels
+    )
+{
+    if ((objPtr != NULL) && (pixels < 0)) {
+	FormatResult(interp, "bad screen distance \"%s\": must be >= 0",
+	    Tcl_GetString(objPtr));
+	return TCL_ERROR;
+    }
+    return TCL_OK;
+}
+
+/* Convert the -data option to an array of numbers. */
+static int
+BarParseData(
+    Tcl_Interp *interp,
+    Tcl_Obj *dataObj,
+    double **valuesPtr,
+    int *countPtr
+    )
+{
+    Tcl_Obj **objv;
+    double *values = NULL;
+    int i, objc = 0;
+
+    if ((dataObj != NULL) &&
+	    (Tcl_ListObjGetElements(interp, dataObj, &objc, &objv) != TCL_OK))
+	return TCL_ERROR;
+    if (objc > 0) {
+	values = (double *) ckalloc(sizeof(double) * objc);
+	for (i = 0; i < objc; i++) {
+	    if (BarGetDouble(interp, objv[i], &values[i]) != TCL_OK) {
+		ckfree((char *) values);
+		return TCL_ERROR;
+	    }
+	}
+    }
+    *valuesPtr = values;
+    *countPtr = objc;
+    return TCL_OK;
+}
+
+/* Return the fraction of the -min to -max range covered by a value. */
+static double
+BarFraction(
+    double value,
+    double min,
+    double max
+    )
+{
+    double f;
+
+    if (max <= min)
+	return 0.0;
+    f = (value - min) / (max - min);
+    return (f < 0.0) ? 0.0 : (f > 1.0) ? 1.0 : f;
+}
+
+static void DeleteProcBar(TreeElementArgs *args)
+{
+    ElementBar *elemX = (ElementBar *) args->elem;
+
+    if (elemX->values != NULL)
+	ckfree((char *) elemX->values);
+}
+
+static int WorldChangedProcBar(TreeElementArgs *args)
+{
+    int flagM = args->change.flagMaster;
+    int flagS = args->change.flagSelf;
+    int mask = 0;
+
+    if ((flagS | flagM) & BAR_CONF_SIZE)
+	mask |= CS_DISPLAY | CS_LAYOUT;
+
+    if ((flagS | flagM) & (BAR_CONF_DATA | BAR_CONF_RANGE | BAR_CONF_FILL |
+	    BAR_CONF_LINEWIDTH))
+	mask |= CS_DISPLAY;
+
+    return mask;
+}
+
+static int ConfigProcBar(TreeElementArgs *args)
+{
+    TreeCtrl *tree = args->tree;
+    TreeElement elem = args->elem;
+    ElementBar *elemX = (ElementBar *) elem;
+    Tk_SavedOptions savedOptions;
+    int error;
+    Tcl_Obj *errorResult = NULL;
+    double *values = NULL, min = 0.0, max = 0.0;
+    int numValues = 0;
+
+    for (error = 0; error <= 1; error++) {
+	if (error == 0) {
+	    if (Tree_SetOptions(tree, elem->stateDomain, elemX,
+			elem->typePtr->optionTable,
+			args->config.objc, args->config.objv,
+			&savedOptions, &args->config.flagSelf) != TCL_OK) {
+		args->config.flagSelf = 0;
+		continue;
+	    }
+
+	    if (BarCheckPixels(tree->interp, elemX->heightObj,
+		    elemX->height) != TCL_OK ||
+		    BarCheckPixels(tree->interp, elemX->lineWidthObj,
+		    elemX->lineWidth) != TCL_OK ||
+		    BarCheckPixels(tree->interp, elemX->widthObj,
+		    elemX->width) != TCL_OK)
+		continue;
+	    if ((elemX->minObj != NULL) && (BarGetDouble(tree->interp,
+		    elemX->minObj, &min) != TCL_OK))
+		continue;
+	    if ((elemX->maxObj != NULL) && (BarGetDouble(tree->interp,
+		    elemX->maxObj, &max) != TCL_OK))
+		continue;
+	    if ((args->config.flagSelf & BAR_CONF_DATA) &&
+		    (BarParseData(tree->interp, elemX->dataObj, &values,
+		    &numValues) != TCL_OK))
+		continue;
+
+	    Tk_FreeSavedOptions(&savedOptions);
+	    break;
+	} else {
+	    errorResult = Tcl_GetObjResult(tree->interp);
+	    Tcl_IncrRefCount(errorResult);
+	    Tk_RestoreSavedOptions(&savedOptions);
+
+	    Tcl_SetObjResult(tree->interp, errorResult);
+	    Tcl_DecrRefCount(errorResult);
+	    return TCL_ERROR;
+	}
+    }
+
+    elemX->min = min;
+    elemX->max = max;
+    if (args->config.flagSelf & BAR_CONF_DATA) {
+	if (elemX->values != NULL)
+	    ckfree((char *) elemX->values);
+	elemX->values = values;
+	elemX->numValues = numValues;
+    }
+
+    return TCL_OK;
+}
+
+static int CreateProcBar(TreeElementArgs *args)
+{
+    return TCL_OK;
+}
+
+static void DisplayProcBar(TreeElementArgs *args)
+{
+    TreeCtrl *tree = args->tree;
+    TreeElement elem = args->elem;
+    ElementBar *elemX = (ElementBar *) elem;
+    ElementBar *masterX = (ElementBar *) elem->master;
+    int state = args->state;
+    int x = args->display.x, y = args->display.y;
+    int width = args->display.width, height = args->display.height;
+    int match, match2;
+    TreeColor *tc;
+    TreeRectangle tr, trBrush;
+    TreeClip clip, *clipPtr = &clip;
+    double *values = elemX->values, min, max;
+    int i, numValues = elemX->numValues, lineWidth = 1;
+
+    if ((elemX->dataObj == NULL) && (masterX != NULL)) {
+	values = masterX->values;
+	numValues = masterX->numValues;
+    }
+    if (numValues == 0)
+	return;
+
+    TREECOLOR_FOR_STATE(tc, fill, state)
+    if (tc == NULL)
+	return;
+
+    if (elemX->widthObj != NULL)
+	width = elemX->width;
+    else if ((masterX != NULL) && (masterX->widthObj != NULL))
+	width = masterX->width;
+
+    if (elemX->heightObj != NULL)
+	height = elemX->height;
+    else if ((masterX != NULL) && (masterX->heightObj != NULL))
+	height = masterX->height;
+
+    if (elemX->lineWidthObj != NULL)
+	lineWidth = elemX->lineWidth;
+    else if ((masterX != NULL) && (masterX->lineWidthObj != NULL))
+	lineWidth = masterX->lineWidth;
+
+    /* Unless -min and -max are given, the range is from the smallest
+     * value (or zero) to the largest value. */
+    min = MIN(values[0], 0.0);
+    max = values[0];
+    for (i = 1; i < numValues; i++) {
+	min = MIN(min, values[i]);
+	max = MAX(max, values[i]);
+    }
+    if (elemX->minObj != NULL)
+	min = elemX->min;
+    else if ((masterX != NULL) && (masterX->minObj != NULL))
+	min = masterX->min;
+    if (elemX->maxObj != NULL)
+	max = elemX->max;
+    else if ((masterX != NULL) && (masterX->maxObj != NULL))
+	max = masterX->max;
+
+    AdjustForSticky(args->display.sticky,
+	args->display.width, args->display.height,
+	TRUE, TRUE,
+	&x, &y, &width, &height);
+
+    if ((width < 1) || (height < 1))
+	return;
+
+    if (ELEMENT_TYPE_MATCHES(elem->typePtr, &treeElemTypeSparkline)) {
+	XPoint staticPoints[STATIC_SIZE], *points = staticPoints;
+	int numPoints = MAX(numValues, 2);
+	int inset = lineWidth / 2;
+	XGCValues gcValues;
+	GC gc;
+
+	/* Gradients can't be used to draw lines. */
+	if (tc->color == NULL)
+	    return;
+	width -= inset * 2 + 1;
+	height -= inset * 2 + 1;
+	if ((width < 0) || (height < 0))
+	    return;
+
+	STATIC_ALLOC(points, XPoint, numPoints);
+	for (i = 0; i < numPoints; i++) {
+	    double value = values[MIN(i, numValues - 1)];
+	    points[i].x = x + inset + (width * i) / (numPoints - 1);
+	    points[i].y = y + inset + height -
+		(int) (BarFraction(value, min, max) * height + 0.5);
+	}
+	gcValues.foreground = tc->color->pixel;
+	gcValues.line_width = lineWidth;
+	gcValues.cap_style = CapRound;
+	gcValues.join_style = JoinRound;
+	gc = Tree_GetGC(tree, GCForeground | GCLineWidth | GCCapStyle |
+		GCJoinStyle, &gcValues);
+	XDrawLines(tree->display, args->display.drawable, gc, points,
+		numPoints, CoordModeOrigin);
+	STATIC_FREE(points, XPoint, numPoints);
+	return;
+    }
+
+#if USE_ITEM_PIXMAP == 0
+    clip.type = TREE_CLIP_RECT;
+    clip.tr = args->display.bounds;
+#else
+    clipPtr = NULL;
+#endif
+
+    /* The brush covers the whole element so a gradient is revealed as
+     * the bar grows. */
+    TreeRect_SetXYWH(tr, x, y, width, height);
+    TreeColor_GetBrushBounds(tree, tc, tr,
+	    tree->drawableXOrigin, tree->drawableYOrigin,
+	    args->display.column, args->display.item, &trBrush);
+
+    /* A single value is drawn as a horizontal bar; a list of values is
+     * drawn as a column of the same width for each value. */
+    if (numValues == 1) {
+	int w = (int) (BarFraction(values[0], min, max) * width + 0.5);
+	if (w > 0) {
+	    TreeRect_SetXYWH(tr, x, y, w, height);
+	    TreeColor_FillRect(tree, args->display.td, clipPtr, tc, trBrush, tr);
+	}
+	return;
+    }
+    for (i = 0; i < numValues; i++) {
+	int x1 = x + (width * i) / numValues;
+	int x2 = x + (width * (i + 1)) / numValues;
+	int h = (int) (BarFraction(values[i], min, max) * height + 0.5);
+
+	/* Leave a gap between columns if there is room. */
+	if (x2 - x1 > 2)
+	    x2--;
+	if (h > 0) {
+	    TreeRect_SetXYWH(tr, x1, y + height - h, x2 - x1, h);
+	    TreeColor_FillRect(tree, args->display.td, clipPtr, tc, trBrush, tr);
+	}
+    }
+}
+
+static void NeededProcBar(TreeElementArgs *args)
+{
+    TreeElement elem = args->elem;
+    ElementBar *elemX = (ElementBar *) elem;
+    ElementBar *masterX = (ElementBar *) elem->master;
+    int width = 0, height = 0;
+
+    if (elemX->widthObj != NULL)
+	width = elemX->width;
+    else if ((masterX != NULL) && (masterX->widthObj != NULL))
+	width = masterX->width;
+
+    if (elemX->heightObj != NULL)
+	height = elemX->height;
+    else if ((masterX != NULL) && (masterX->heightObj != NULL))
+	height = masterX->height;
+
+    args->needed.width = width;
+    args->needed.height = height;
+}
+
+static int StateProcBar(TreeElementArgs *args)
+{
+    TreeCtrl *tree = args->tree;
+    TreeElement elem = args->elem;
+    ElementBar *elemX = (ElementBar *) elem;
+    ElementBar *masterX = (ElementBar *) elem->master;
+    int match, match2;
+    TreeColor *tc1, *tc2;
+
+    /* If either the -draw or -visible layout option is false for the
+     * current state, then changes to colors etc don't warrant a redisplay. */
+    if (!args->states.visible2 || !args->states.draw2)
+	return 0;
+
+    TREECOLOR_FOR_STATE(tc1, fill, args->states.state1)
+    TREECOLOR_FOR_STATE(tc2, fill, args->states.state2)
+    if (TREECOLOR_CMP(tc1, tc2))
+	return CS_DISPLAY;
+
+    return 0;
+}
+
+static int UndefProcBar(TreeElementArgs *args)
+{
+    TreeCtrl *tree = args->tree;
+    TreeElement elem = args->elem;
+    ElementBar *elemX = (ElementBar *) elem;
+
+    return PerStateInfo_Undefine(tree, &pstColor, &elemX->fill,
+	elem->stateDomain, args->state);
+}
+
+static int ActualProcBar(TreeElementArgs *args)
+{
+    TreeCtrl *tree = args->tree;
+    ElementBar *elemX = (ElementBar *) args->elem;
+    ElementBar *masterX = (ElementBar *) args->elem->master;
+    static CONST char *optionName[] = {
+	"-fill",
+	(char *) NULL };
+    enum optionEnum {
+	OPT_FILL
+    };
+    int index, match, matchM;
+    Tcl_Obj *obj = NULL;
+
+    if (Tcl_GetIndexFromObj(tree->interp, args->actual.obj, optionName,
+		"option", 0, &index) != TCL_OK)
+	return TCL_ERROR;
+
+    switch ((enum optionEnum) index) {
+	case OPT_FILL: {
+	    OBJECT_FOR_STATE(obj, pstColor, fill, args->state)
+	    break;
+	}
+    }
+    if (obj != NULL)
+	Tcl_SetObjResult(tree->interp, obj);
+    return TCL_OK;
+}
+
+TreeElementType treeElemTypeBar = {
+    "bar",
+    sizeof(ElementBar),
+    barOptionSpecs,
+    NULL,
+    CreateProcBar,
+    DeleteProcBar,
+    ConfigProcBar,
+    DisplayProcBar,
+    NeededProcBar,
+    NULL, /* heightProc */
+    WorldChangedProcBar,
+    StateProcBar,
+    UndefProcBar,
+    ActualProcBar,
+    NULL /* onScreenProc */
+};
+
+/* Same as a bar element, but the values are drawn as a polyline. */
+TreeElementType treeElemTypeSparkline = {
+    "sparkline",
+    sizeof(ElementBar),
+    barOptionSpecs,
+    NULL,
+    CreateProcBar,
+    DeleteProcBar,
+    ConfigProcBar,
+    DisplayProcBar,
+    NeededProcBar,
+    NULL, /* heightProc */
+    WorldChangedProcBar,
+    StateProcBar,
+    UndefProcBar,
+    ActualProcBar,
+    NULL /* onScreenProc */
+};
+
+/*****/
+
 typedef struct ElementBitmap ElementBitmap;
 
 struct ElementBitmap
@@ -2479,6 +2975,7 @@ typedef struct ElementImageSize
 #ifdef DEPRECATED
 #define IMAGE_CONF_DRAW 0x0008
 #endif
+#define IMAGE_CONF_COMMAND 0x0010
 
 static Tk_OptionSpec imageOptionSpecs[] = {
 #ifdef DEPRECATED
@@ -2493,9 +2990,15 @@ static Tk_OptionSpec imageOptionSpecs[] = {
      (char *) NULL,
      Tk_Offset(ElementImage, image.obj), Tk_Offset(ElementImage, image),
      TK_OPTION_NULL_OK, (ClientData) NULL, IMAGE_CONF_IMAGE},
+    {TK_OPTION_CUSTOM, "-imagecommand", (char *) NULL, (char *) NULL,
+     (char *) NULL, -1, Tk_Offset(TreeElement_, options),
+     TK_OPTION_NULL_OK, (ClientData) NULL, IMAGE_CONF_COMMAND},
     {TK_OPTION_CUSTOM, "-tiled", (char *) NULL, (char *) NULL,
      (char *) NULL, -1, Tk_Offset(TreeElement_, options),
      TK_OPTION_NULL_OK, (ClientData) NULL, IMAGE_CONF_DISPLAY},
+    {TK_OPTION_CUSTOM, "-tint", (char *) NULL, (char *) NULL,
+     (char *) NULL, -1, Tk_Offset(TreeElement_, options),
+     TK_OPTION_NULL_OK, (ClientData) NULL, IMAGE_CONF_DISPLAY},
     {TK_OPTION_CUSTOM, "-width", (char *) NULL, (char *) NULL,
      (char *) NULL, -1, Tk_Offset(TreeElement_, options),
      TK_OPTION_NULL_OK, (ClientData) NULL, IMAGE_CONF_SIZE},
@@ -2503,11 +3006,415 @@ static Tk_OptionSpec imageOptionSpecs[] = {
      (char *) NULL, 0, -1, 0, (ClientData) NULL, 0}
 };
 
-static void DeleteProcImage(TreeElementArgs *args)
+/*
+ * An image element with an -imagecommand asks the script for its image
+ * the first time it is drawn with no -image of its own.  The requests are
+ * queued here and serviced one per idle callback, so a screenful of
+ * thumbnails doesn't block the first redraw.  Once the command has been
+ * called for a cell it is remembered in TreeCtrl.imageCalledHash so the
+ * command isn't called again on every redraw when it sets no image.
+ */
+
+typedef struct ImageCalled ImageCalled;
+
+struct ImageCalled
 {
-/*    TreeCtrl *tree = args->tree;
+    int columnId;		/* Column the element is displayed in. */
+    Tk_Uid elemName;		/* Name of the master element. */
+    ImageCalled *next;		/* Next cell in the same item. */
+};
+
+typedef struct ImageRequest ImageRequest;
+
+struct ImageRequest
+{
+    int itemId;			/* Item the element is displayed in. */
+    int columnId;		/* Column the element is displayed in. */
+    Tk_Uid elemName;		/* Name of the master element. */
+    Tcl_Obj *cmdObj;		/* -imagecommand at the time of the
+				 * request. */
+    ImageRequest *next;
+};
+
+static void ImageRequest_Proc(ClientData clientData);
+static void ImageRequest_Forget(TreeCtrl *tree, int itemId, int columnId,
+    Tk_Uid elemName);
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ImageCalled_Find --
+ *
+ *	Return the record saying an image element's -imagecommand was
+ *	called for an item and column.
+ *
+ * Results:
+ *	Pointer to the record, or NULL if the command wasn't called.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static ImageCalled *
+ImageCalled_Find(
+    TreeCtrl *tree,		/* Widget info. */
+    int itemId,			/* Item the element is displayed in. */
+    int columnId,		/* Column the element is displayed in. */
+    Tk_Uid elemName		/* Name of the master element. */
+    )
+{
+    Tcl_HashEntry *hPtr;
+    ImageCalled *ic;
+
+    hPtr = Tcl_FindHashEntry(&tree->imageCalledHash, (char *) INT2PTR(itemId));
+    if (hPtr == NULL)
+	return NULL;
+    for (ic = Tcl_GetHashValue(hPtr); ic != NULL; ic = ic->next) {
+	if (ic->columnId == columnId && ic->elemName == elemName)
+	    return ic;
+    }
+    return NULL;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ImageCalled_Set --
+ *
+ *	Remember that an image element's -imagecommand was called for
+ *	an item and column.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Memory may be allocated.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+ImageCalled_Set(
+    TreeCtrl *tree,		/* Widget info. */
+    int itemId,			/* Item the element is displayed in. */
+    int columnId,		/* Column the element is displayed in. */
+    Tk_Uid elemName		/* Name of the master element. */
+    )
+{
+    Tcl_HashEntry *hPtr;
+    ImageCalled *ic;
+    int isNew;
+
+    if (ImageCalled_Find(tree, itemId, columnId, elemName) != NULL)
+	return;
+    hPtr = Tcl_CreateHashEntry(&tree->imageCalledHash,
+	(char *) INT2PTR(itemId), &isNew);
+    ic = (ImageCalled *) ckalloc(sizeof(ImageCalled));
+    ic->columnId = columnId;
+    ic->elemName = elemName;
+    ic->next = isNew ? NULL : Tcl_GetHashValue(hPtr);
+    Tcl_SetHashValue(hPtr, (ClientData) ic);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ImageCalled_Forget --
+ *
+ *	Forget that an image element's -imagecommand was called so the
+ *	next redraw calls it again. Each of the arguments may be a
+ *	wildcard.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Memory may be freed.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+ImageCalled_Forget(
+    TreeCtrl *tree,		/* Widget info. */
+    int itemId,			/* Item, or -1 for every item. */
+    int columnId,		/* Column, or -1 for every column. */
+    Tk_Uid elemName		/* Master element, or NULL for every
+				 * element. */
+    )
+{
+    Tcl_HashEntry *hPtr;
+    Tcl_HashSearch search;
+    ImageCalled *ic, **prevPtr;
+
+    if (itemId != -1)
+	hPtr = Tcl_FindHashEntry(&tree->imageCalledHash,
+	    (char *) INT2PTR(itemId));
+    else
+	hPtr = Tcl_FirstHashEntry(&tree->imageCalledHash, &search);
+    while (hPtr != NULL) {
+	ImageCalled *first = Tcl_GetHashValue(hPtr);
+	prevPtr = &first;
+	while ((ic = *prevPtr) != NULL) {
+	    if ((columnId == -1 || ic->columnId == columnId) &&
+		    (elemName == NULL || ic->elemName == elemName)) {
+		*prevPtr = ic->next;
+		ckfree((char *) ic);
+		continue;
+	    }
+	    prevPtr = &ic->next;
+	}
+	if (first == NULL)
+	    Tcl_DeleteHashEntry(hPtr);
+	else
+	    Tcl_SetHashValue(hPtr, (ClientData) first);
+	if (itemId != -1)
+	    break;
+	hPtr = Tcl_NextHashEntry(&search);
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ImageRequest_Add --
+ *
+ *	Queue a call to an image element's -imagecommand unless one is
+ *	already pending or was made for the same item, column and
+ *	element.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Memory is allocated. An idle callback may be scheduled.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+ImageRequest_Add(
+    TreeCtrl *tree,		/* Widget info. */
+    TreeElement elem,		/* Master or instance element. */
+    TreeItem item,		/* Item the element is displayed in. */
+    TreeColumn column,		/* Column the element is displayed in. */
+    Tcl_Obj *cmdObj		/* Command prefix. */
+    )
+{
+    ImageRequest *req, **tailPtr = &tree->imageRequests;
+    int itemId = TreeItem_GetID(tree, item);
+    int columnId = TreeColumn_GetID(column);
+    Tk_Uid elemName = (elem->master != NULL) ? elem->master->name :
+	elem->name;
+
+    if (ImageCalled_Find(tree, itemId, columnId, elemName) != NULL)
+	return;
+    for (req = tree->imageRequests; req != NULL; req = req->next) {
+	if (req->itemId == itemId && req->columnId == columnId &&
+		req->elemName == elemName)
+	    return;
+	tailPtr = &req->next;
+    }
+
+    req = (ImageRequest *) ckalloc(sizeof(ImageRequest));
+    req->itemId = itemId;
+    req->columnId = columnId;
+    req->elemName = elemName;
+    req->cmdObj = cmdObj;
+    Tcl_IncrRefCount(cmdObj);
+    req->next = NULL;
+    *tailPtr = req;
+
+    if (tree->imageRequests == req)
+	Tcl_DoWhenIdle(ImageRequest_Proc, (ClientData) tree);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ImageRequest_Cancel --
+ *
+ *	Forget any pending -imagecommand call for an element that is
+ *	no longer on screen.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Memory may be freed. The idle callback may be cancelled.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+ImageRequest_Cancel(
+    TreeCtrl *tree,		/* Widget info. */
+    TreeElement elem,		/* Master or instance element. */
+    TreeItem item,		/* Item the element was displayed in. */
+    TreeColumn column		/* Column the element was displayed in,
+				 * or NULL for any column. */
+    )
+{
+    ImageRequest_Forget(tree, TreeItem_GetID(tree, item),
+	(column != NULL) ? TreeColumn_GetID(column) : -1,
+	(elem->master != NULL) ? elem->master->name : elem->name);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ImageRequest_Forget --
+ *
+ *	Remove pending -imagecommand calls from the queue. Each of the
+ *	arguments may be a wildcard.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Memory may be freed. The idle callback may be cancelled.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+ImageRequest_Forget(
+    TreeCtrl *tree,		/* Widget info. */
+    int itemId,			/* Item, or -1 for every item. */
+    int columnId,		/* Column, or -1 for every column. */
+    Tk_Uid elemName		/* Master element, or NULL for every
+				 * element. */
+    )
+{
+    ImageRequest *req, **prevPtr = &tree->imageRequests;
+
+    if (tree->imageRequests == NULL)
+	return;
+
+    while ((req = *prevPtr) != NULL) {
+	if ((itemId == -1 || req->itemId == itemId) &&
+		(columnId == -1 || req->columnId == columnId) &&
+		(elemName == NULL || req->elemName == elemName)) {
+	    *prevPtr = req->next;
+	    Tcl_DecrRefCount(req->cmdObj);
+	    ckfree((char *) req);
+	    continue;
+	}
+	prevPtr = &req->next;
+    }
+
+    if (tree->imageRequests == NULL)
+	Tcl_CancelIdleCall(ImageRequest_Proc, (ClientData) tree);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ImageRequest_Proc --
+ *
+ *	Idle callback that evaluates the oldest pending -imagecommand.
+ *	The command is called with the widget path, item, column and
+ *	element name appended. Requests whose item, column or element
+ *	was deleted in the meantime, or whose cell no longer uses the
+ *	element, are dropped. The cell is marked so
+ *	the command isn't called for it again.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Whatever the command does. Another idle callback is scheduled
+ *	if more requests remain.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+ImageRequest_Proc(
+    ClientData clientData	/* Widget info. */
+    )
+{
+    TreeCtrl *tree = clientData;
+    Tcl_Interp *interp = tree->interp;
+    ImageRequest *req;
+    Tcl_HashEntry *hPtr;
+    TreeItem item = NULL;
+    TreeColumn column;
+    TreeItemColumn itemColumn = NULL;
+    TreeStyle style = NULL;
+    TreeElement elem = NULL;
+    Tcl_Obj *listObj;
+
+    if (tree->deleted || (req = tree->imageRequests) == NULL)
+	return;
+    tree->imageRequests = req->next;
+
+    hPtr = Tcl_FindHashEntry(&tree->itemHash, (char *) INT2PTR(req->itemId));
+    if (hPtr != NULL)
+	item = (TreeItem) Tcl_GetHashValue(hPtr);
+    column = Tree_FirstColumn(tree, -1, FALSE);
+    while (column != NULL && TreeColumn_GetID(column) != req->columnId)
+	column = TreeColumn_Next(column);
+    hPtr = Tcl_FindHashEntry(&tree->elementHash, req->elemName);
+    if (hPtr != NULL)
+	elem = (TreeElement) Tcl_GetHashValue(hPtr);
+
+    /* The cell's style may have changed since the request was queued. */
+    if (item != NULL && column != NULL)
+	itemColumn = TreeItem_FindColumn(tree, item, TreeColumn_Index(column));
+    if (itemColumn != NULL)
+	style = TreeItemColumn_GetStyle(tree, itemColumn);
+    if (style != NULL && elem != NULL &&
+	    TreeStyle_FindElement(tree, style, elem, NULL) != TCL_OK) {
+	Tcl_ResetResult(interp);
+	style = NULL;
+    }
+
+    Tcl_Preserve((ClientData) tree);
+    if (style != NULL && elem != NULL) {
+	ImageCalled_Set(tree, req->itemId, req->columnId, req->elemName);
+	listObj = Tcl_DuplicateObj(req->cmdObj);
+	Tcl_IncrRefCount(listObj);
+	if (Tcl_ListObjAppendElement(interp, listObj,
+		Tcl_NewStringObj(Tk_PathName(tree->tkwin), -1)) != TCL_OK ||
+		Tcl_ListObjAppendElement(interp, listObj,
+		TreeItem_ToObj(tree, item)) != TCL_OK ||
+		Tcl_ListObjAppendElement(interp, listObj,
+		TreeColumn_ToObj(tree, column)) != TCL_OK ||
+		Tcl_ListObjAppendElement(interp, listObj,
+		TreeElement_ToObj(elem)) != TCL_OK ||
+		Tcl_EvalObjEx(interp, listObj, TCL_EVAL_GLOBAL) != TCL_OK) {
+	    Tcl_AddErrorInfo(interp, "\n    (image element -imagecommand)");
+	    Tcl_BackgroundError(interp);
+	}
+	Tcl_DecrRefCount(listObj);
+    }
+    Tcl_DecrRefCount(req->cmdObj);
+    ckfree((char *) req);
+
+    if (!tree->deleted && tree->imageRequests != NULL)
+	Tcl_DoWhenIdle(ImageRequest_Proc, (ClientData) tree);
+    Tcl_Release((ClientData) tree);
+}
+
+static void OnScreenProcImage(TreeElementArgs *args)
+{
+    TreeCtrl *tree = args->tree;
+
+    if (!args->screen.visible && tree->imageRequests != NULL)
+	ImageRequest_Cancel(tree, args->elem, args->screen.item,
+	    args->screen.column);
+}
+
+static void DeleteProcImage(TreeElementArgs *args)
+{
+    TreeCtrl *tree = args->tree;
     TreeElement elem = args->elem;
-    ElementImage *elemX = (ElementImage *) elem;*/
+
+    if (elem->master == NULL)
+	ImageCalled_Forget(tree, -1, -1, elem->name);
 }
 
 static int WorldChangedProcImage(TreeElementArgs *args)
@@ -2522,7 +3429,7 @@ static int WorldChangedProcImage(TreeElementArgs *args)
 #endif
 	    IMAGE_CONF_IMAGE | IMAGE_CONF_SIZE))
 	mask |= CS_DISPLAY | CS_LAYOUT;
-    if ((flagS | flagM) & IMAGE_CONF_DISPLAY)
+    if ((flagS | flagM) & (IMAGE_CONF_DISPLAY | IMAGE_CONF_COMMAND))
 	mask |= CS_DISPLAY;
 
     return mask;
@@ -2560,6 +3467,20 @@ static int ConfigProcImage(TreeElementArgs *args)
 	}
     }
 
+    /* Call the -imagecommand again if the image or command changed. */
+    if (args->config.flagSelf & (IMAGE_CONF_IMAGE | IMAGE_CONF_COMMAND)) {
+	if (elem->master == NULL) {
+	    ImageCalled_Forget(tree, -1, -1, elem->name);
+	} else if (args->config.item != NULL) {
+	    TreeItem item = args->config.item;
+	    TreeColumn column = Tree_FindColumn(tree,
+		TreeItemColumn_Index(tree, item, args->config.column));
+	    if (column != NULL)
+		ImageCalled_Forget(tree, TreeItem_GetID(tree, item),
+		    TreeColumn_GetID(column), elem->name);
+	}
+    }
+
     return TCL_OK;
 }
 
@@ -2588,6 +3509,7 @@ static void DisplayProcImage(TreeElementArgs *args)
     int tiled = 0, *eit, *eitM = NULL;
     int inHeader = elem->stateDomain == STATE_DOMAIN_HEADER;
     int columnState = COLUMN_STATE_NORMAL;
+    XColor *tint;
 
 #ifdef DEPRECATED
     draw = DO_BooleanForState(tree, elem, 1002, state);
@@ -2595,10 +3517,24 @@ static void DisplayProcImage(TreeElementArgs *args)
 	return;
 #endif
 
+    /* Ask for the image if this instance doesn't have one yet. */
+    if (!inHeader && (elem->master == NULL || elemX->image.obj == NULL)) {
+	Tcl_Obj **cmdPtr = DynamicOption_FindData(elem->options, 1005);
+	if ((cmdPtr == NULL || *cmdPtr == NULL) && (masterX != NULL))
+	    cmdPtr = DynamicOption_FindData(elem->master->options, 1005);
+	if (cmdPtr != NULL && *cmdPtr != NULL)
+	    ImageRequest_Add(tree, elem, args->display.item,
+		args->display.column, *cmdPtr);
+    }
+
     IMAGE_FOR_STATE(image, image, state)
     if (image == NULL)
 	return;
 
+    DO_COLOR_FOR_STATE(tint, 1004, state)
+    if (tint != NULL)
+	image = Tree_GetImageTinted(tree, image, tint);
+
     eit = DynamicOption_FindData(elem->options, 1003);
     if (masterX != NULL)
 	eitM = DynamicOption_FindData(elem->master->options, 1003);
@@ -2691,6 +3627,7 @@ static int StateProcImage(TreeElementArgs *args)
     int draw1, draw2;
 #endif
     Tk_Image image1, image2;
+    XColor *tint1, *tint2;
 
     if (!args->states.visible2)
 	return 0;
@@ -2719,6 +3656,11 @@ static int StateProcImage(TreeElementArgs *args)
 	return CS_DISPLAY;
 #endif
 
+    DO_COLOR_FOR_STATE(tint1, 1004, args->states.state1)
+    DO_COLOR_FOR_STATE(tint2, 1004, args->states.state2)
+    if (tint1 != tint2)
+	return CS_DISPLAY;
+
     return 0;
 }
 
@@ -2728,15 +3670,15 @@ static int UndefProcImage(TreeElementArgs *args)
     TreeElement elem = args->elem;
     ElementImage *elemX = (ElementImage *) elem;
     int modified = 0;
-#ifdef DEPRECATED
     PerStateInfo *psi;
-#endif
 
 #ifdef DEPRECATED
     if ((psi = DynamicOption_FindData(elem->options, 1002)) != NULL)
 	modified |= PerStateInfo_Undefine(tree, &pstBoolean, psi, elem->stateDomain, args->state);
 #endif
     modified |= PerStateInfo_Undefine(tree, &pstImage, &elemX->image, elem->stateDomain, args->state);
+    if ((psi = DynamicOption_FindData(elem->options, 1004)) != NULL)
+	modified |= PerStateInfo_Undefine(tree, &pstColor, psi, elem->stateDomain, args->state);
     return modified;
 }
 
@@ -2749,7 +3691,7 @@ static int ActualProcImage(TreeElementArgs *args)
 #ifdef DEPRECATED
 	"-draw",
 #endif
-	"-image",
+	"-image", "-tint",
 	(char *) NULL };
     int index, match, matchM;
     Tcl_Obj *obj = NULL;
@@ -2768,11 +3710,19 @@ static int ActualProcImage(TreeElementArgs *args)
 	    OBJECT_FOR_STATE(obj, pstImage, image, args->state)
 	    break;
 	}
+	case 2: {
+	    obj = DO_ObjectForState(tree, &pstColor, args->elem, 1004, args->state);
+	    break;
+	}
 #else
 	case 0: {
 	    OBJECT_FOR_STATE(obj, pstImage, image, args->state)
 	    break;
 	}
+	case 1: {
+	    obj = DO_ObjectForState(tree, &pstColor, args->elem, 1004, args->state);
+	    break;
+	}
 #endif
     }
     if (obj != NULL)
@@ -2795,7 +3745,7 @@ TreeElementType treeElemTypeImage = {
     StateProcImage,
     UndefProcImage,
     ActualProcImage,
-    NULL /* onScreenProc */
+    OnScreenProcImage
 };
 
 /*****/
@@ -3489,38 +4439,566 @@ static int WorldChangedProcText(TreeElementArgs *args)
     return mask;
 }
 
-static void TextUpdateStringRep(TreeElementArgs *args)
-{
-    TreeCtrl *tree = args->tree;
-    TreeElement elem = args->elem;
-    ElementText *elemX = (ElementText *) elem;
-    ElementText *masterX = (ElementText *) elem->master;
-    Tcl_Obj *dataObj, *formatObj;
-    char *text;
-    ElementTextData *etd, *etdM = NULL;
-#ifdef TEXTVAR
-    ElementTextVar *etv;
-    Tcl_Obj *varNameObj;
-#endif
-    int dataType;
+/*
+ * The -datatype and -format options of text elements were originally
+ * implemented by calling the [format] and [clock format] commands for each
+ * element. [clock] is written in Tcl and is quite slow, which made
+ * configuring a large number of text elements with -datatype time
+ * expensive. The routines below handle the common formats directly in C,
+ * falling back to the Tcl commands for anything they don't understand.
+ * Each distinct -format string is parsed only once per widget; the
+ * results are kept in tree->textFormatHash.
+ */
 
-    /* Free any string allocated as a result of -data or -textvariable. */
-    if ((elemX->text != NULL) && (elemX->text != elemX->textCfg)) {
-	ckfree(elemX->text);
-    }
+typedef struct TextFormat {
+    int native;			/* TRUE if the format can be done in C,
+				 * FALSE if Tcl must do it. */
+    int hasLong;		/* TRUE if the conversion has an 'l' size
+				 * modifier. */
+    int hasWidth;		/* TRUE if the conversion has a width or
+				 * precision. */
+    int conv;			/* The printf conversion character. */
+    char format[1];		/* Copy of the -format string. Actual size
+				 * is strlen(format)+1. */
+} TextFormat;
+
+/* The format used by [clock format] when -format isn't given. */
+#define TEXT_CLOCK_FORMAT "%a %b %d %H:%M:%S %Z %Y"
+
+/* Largest width or precision handled in C, so the result of a printf
+ * conversion always fits in a buffer of known size. */
+#define TEXT_FORMAT_MAX_WIDTH 100
 
-    /* Forget any string, and mark the string rep as no-longer invalid. */
-    elemX->text = NULL;
-    elemX->textLen = 0;
+/*
+ *----------------------------------------------------------------------
+ *
+ * TextFormat_CompilePrintf --
+ *
+ *	Determine whether a -format string for the double, integer, long
+ *	or string -datatype can be given to sprintf() and produce the same
+ *	result as the [format] command.  Only formats with exactly one
+ *	conversion of a type matching the -datatype are accepted.
+ *
+ * Results:
+ *	Fields of tf are set.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
 
-    /* If -text is specified, then -data and -textvariable are ignored. */
-    if (elemX->textCfg != NULL) {
-	elemX->text = elemX->textCfg;
-	elemX->textLen = (int) strlen(elemX->textCfg);
-	return;
+static void
+TextFormat_CompilePrintf(
+    TextFormat *tf,		/* Format to check. */
+    int dataType		/* TDT_xxx. */
+    )
+{
+    char *p = tf->format;
+    char *conversions;
+    int numConv = 0, alternate = FALSE, n;
+
+    tf->native = FALSE;
+    while (*p != '\0') {
+	if (*p++ != '%')
+	    continue;
+	if (*p == '%') {
+	    p++;
+	    continue;
+	}
+	if (++numConv > 1)
+	    return;
+	for (; *p != '\0' && strchr("-+ 0#", *p) != NULL; p++) {
+	    if (*p == '#')
+		alternate = TRUE;
+	}
+	for (n = 0; isdigit(UCHAR(*p)); p++) {
+	    n = n * 10 + (*p - '0');
+	    if (n > TEXT_FORMAT_MAX_WIDTH)
+		return;
+	    tf->hasWidth = TRUE;
+	}
+	if (*p == '.') {
+	    p++;
+	    for (n = 0; isdigit(UCHAR(*p)); p++) {
+		n = n * 10 + (*p - '0');
+		if (n > TEXT_FORMAT_MAX_WIDTH)
+		    return;
+	    }
+	    tf->hasWidth = TRUE;
+	}
+	if (*p == 'l') {
+	    tf->hasLong = TRUE;
+	    p++;
+	}
+	if (*p == '\0')
+	    return;
+	tf->conv = *p++;
     }
+    if (numConv != 1)
+	return;
 
-#ifdef TEXTVAR
+    switch (dataType) {
+	case TDT_DOUBLE:
+	    conversions = tf->hasLong ? "" : "eEfgG";
+	    break;
+	case TDT_INTEGER:
+	    /* [format] prints %#x of zero as 0x0. */
+	    conversions = (tf->hasLong || alternate) ? "" : "dioxX";
+	    break;
+	case TDT_LONG:
+	    conversions = alternate ? "" : "dioxX";
+	    break;
+	case TDT_STRING:
+	    conversions = tf->hasLong ? "" : "s";
+	    break;
+	default:
+	    return;
+    }
+    tf->native = (strchr(conversions, tf->conv) != NULL);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TextFormat_CompileTime --
+ *
+ *	Determine whether a -format string for the time -datatype only
+ *	uses conversions that TextFormat_Time() knows about.
+ *
+ * Results:
+ *	tf->native is set.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+TextFormat_CompileTime(
+    TextFormat *tf		/* Format to check. */
+    )
+{
+    char *p = tf->format;
+
+    tf->native = FALSE;
+    while (*p != '\0') {
+	if (*p++ != '%')
+	    continue;
+	if (*p == '\0' || strchr("%aAbBCdDeHhIjklmMnpRsStTuwyYZ", *p) == NULL)
+	    return;
+	p++;
+    }
+    tf->native = TRUE;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TextFormat_Get --
+ *
+ *	Return the parsed form of a -format string, parsing it if it has
+ *	not been seen before by this widget.
+ *
+ * Results:
+ *	Pointer to a TextFormat.
+ *
+ * Side effects:
+ *	Memory may be allocated.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static TextFormat *
+TextFormat_Get(
+    TreeCtrl *tree,		/* Widget info. */
+    int dataType,		/* TDT_xxx. */
+    CONST char *format		/* -format string. */
+    )
+{
+    Tcl_DString dString;
+    Tcl_HashEntry *hPtr;
+    TextFormat *tf;
+    int isNew, length = (int) strlen(format);
+
+    /* The same -format may be valid for one -datatype and not another. */
+    Tcl_DStringInit(&dString);
+    Tcl_DStringAppend(&dString, "0", 1);
+    Tcl_DStringValue(&dString)[0] += dataType;
+    Tcl_DStringAppend(&dString, format, length);
+    hPtr = Tcl_CreateHashEntry(&tree->textFormatHash,
+	    Tcl_DStringValue(&dString), &isNew);
+    Tcl_DStringFree(&dString);
+    if (!isNew)
+	return (TextFormat *) Tcl_GetHashValue(hPtr);
+
+    tf = (TextFormat *) ckalloc(sizeof(TextFormat) + length);
+    memset(tf, '\0', sizeof(TextFormat));
+    memcpy(tf->format, format, length + 1);
+    if (dataType == TDT_TIME)
+	TextFormat_CompileTime(tf);
+    else
+	TextFormat_CompilePrintf(tf, dataType);
+    Tcl_SetHashValue(hPtr, (ClientData) tf);
+    return tf;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TextFormat_Printf --
+ *
+ *	Format a -data value for the double, integer, long or string
+ *	-datatype without calling [format].
+ *
+ * Results:
+ *	TCL_OK if the string was formatted, TCL_ERROR if the value is one
+ *	that [format] should handle (which includes values that are
+ *	invalid for the -datatype, so [format] can reject them).
+ *
+ * Side effects:
+ *	The result is appended to dStringPtr.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+TextFormat_Printf(
+    TextFormat *tf,		/* Format from TextFormat_Get(). */
+    int dataType,		/* TDT_xxx. */
+    Tcl_Obj *dataObj,		/* -data value. */
+    Tcl_DString *dStringPtr	/* Initialized dynamic string. */
+    )
+{
+    double d;
+    int i, length;
+    long l;
+    char *buf, *s;
+    int offset = Tcl_DStringLength(dStringPtr);
+    int size = (int) strlen(tf->format) + 2 * TEXT_FORMAT_MAX_WIDTH + 400;
+
+    switch (dataType) {
+	case TDT_DOUBLE:
+	    if (Tcl_GetDoubleFromObj(NULL, dataObj, &d) != TCL_OK)
+		return TCL_ERROR;
+	    /* Let Tcl spell Inf and NaN. */
+	    if ((d != d) || (d - d != 0.0))
+		return TCL_ERROR;
+	    Tcl_DStringSetLength(dStringPtr, offset + size);
+	    buf = Tcl_DStringValue(dStringPtr) + offset;
+	    length = sprintf(buf, tf->format, d);
+	    break;
+	case TDT_INTEGER:
+	case TDT_LONG:
+	    if (Tcl_GetLongFromObj(NULL, dataObj, &l) != TCL_OK)
+		return TCL_ERROR;
+	    /* Depending on the Tcl version, [format] either truncates or
+	     * widens values that don't fit the conversion, and may not
+	     * treat negative numbers as unsigned for %o and %x. */
+	    if ((l < 0) && (tf->conv != 'd') && (tf->conv != 'i'))
+		return TCL_ERROR;
+	    if (!tf->hasLong && ((long) (int) l != l))
+		return TCL_ERROR;
+	    Tcl_DStringSetLength(dStringPtr, offset + size);
+	    buf = Tcl_DStringValue(dStringPtr) + offset;
+	    if (tf->hasLong)
+		length = sprintf(buf, tf->format, l);
+	    else
+		length = sprintf(buf, tf->format, (int) l);
+	    break;
+	case TDT_STRING:
+	    s = Tcl_GetStringFromObj(dataObj, &length);
+	    if (tf->hasWidth) {
+		/* [format] measures width and precision in characters,
+		 * sprintf() in bytes. */
+		for (i = 0; i < length; i++) {
+		    if (UCHAR(s[i]) >= 0x80)
+			return TCL_ERROR;
+		}
+	    }
+	    Tcl_DStringSetLength(dStringPtr, offset + size + length);
+	    buf = Tcl_DStringValue(dStringPtr) + offset;
+	    length = sprintf(buf, tf->format, s);
+	    break;
+	default:
+	    return TCL_ERROR;
+    }
+    Tcl_DStringSetLength(dStringPtr, offset + length);
+    return TCL_OK;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TextFormat_Time --
+ *
+ *	Format a -data value for the time -datatype without calling
+ *	[clock format]. The time is converted using the C library's idea
+ *	of the local timezone and the names of days and months are those
+ *	of the C locale, which is what [clock format] uses when it is not
+ *	given the -timezone or -locale options.
+ *
+ *	The C library may check the timezone for changes every time
+ *	localtime() is called. Instead, the timezone is only re-read when
+ *	the TZ environment variable changes.
+ *
+ * Results:
+ *	TCL_OK if the string was formatted, TCL_ERROR if [clock format]
+ *	should handle it.
+ *
+ * Side effects:
+ *	The result is appended to dStringPtr.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+TextFormat_Time(
+    TreeCtrl *tree,		/* Widget info. */
+    TextFormat *tf,		/* Format from TextFormat_Get(). */
+    Tcl_Obj *dataObj,		/* -data value. */
+    Tcl_DString *dStringPtr	/* Initialized dynamic string. */
+    )
+{
+    static CONST char *dayNames[] = { "Sunday", "Monday", "Tuesday",
+	"Wednesday", "Thursday", "Friday", "Saturday" };
+    static CONST char *monthNames[] = { "January", "February", "March",
+	"April", "May", "June", "July", "August", "September", "October",
+	"November", "December" };
+    char *p = tf->format, *start, *tz, buf[64];
+    long l;
+    time_t t;
+    struct tm *tmPtr;
+#ifndef WIN32
+    struct tm tm;
+#endif
+
+    /* [clock] prefers TCL_TZ to TZ, the C library knows only TZ. */
+    if (getenv("TCL_TZ") != NULL)
+	return TCL_ERROR;
+    /* [clock] applies the rules in a POSIX TZ string such as EST5EDT to
+     * all years, the C library may use a zoneinfo file of the same name
+     * with historical rules. */
+    tz = getenv("TZ");
+    if ((tz != NULL) && (tz[0] != ':') && (strchr(tz, '/') == NULL) &&
+	    (strpbrk(tz, "0123456789") != NULL))
+	return TCL_ERROR;
+    if (tz == NULL)
+	tz = "";
+    if ((tree->textFormatTZ == NULL) || strcmp(tree->textFormatTZ, tz)) {
+	if (tree->textFormatTZ != NULL)
+	    ckfree(tree->textFormatTZ);
+	tree->textFormatTZ = ckalloc((int) strlen(tz) + 1);
+	strcpy(tree->textFormatTZ, tz);
+#ifndef WIN32
+	tzset();
+#endif
+    }
+
+    if (Tcl_GetLongFromObj(NULL, dataObj, &l) != TCL_OK)
+	return TCL_ERROR;
+    t = (time_t) l;
+    if ((long) t != l)
+	return TCL_ERROR;
+#ifdef WIN32
+    tmPtr = localtime(&t);
+#else
+    tmPtr = localtime_r(&t, &tm);
+#endif
+    if (tmPtr == NULL)
+	return TCL_ERROR;
+    /* [clock] uses the Julian calendar for old dates, and writes years
+     * after 9999 differently. */
+    if ((tmPtr->tm_year < 0) || (tmPtr->tm_year > 9999 - 1900))
+	return TCL_ERROR;
+
+    while (*p != '\0') {
+	for (start = p; *p != '\0' && *p != '%'; p++)
+	    /* nothing */;
+	if (p > start)
+	    Tcl_DStringAppend(dStringPtr, start, (int) (p - start));
+	if (*p == '\0')
+	    break;
+	buf[0] = '\0';
+	switch (*++p) {
+	    case '%':
+		strcpy(buf, "%");
+		break;
+	    case 'a':
+		sprintf(buf, "%.3s", dayNames[tmPtr->tm_wday]);
+		break;
+	    case 'A':
+		strcpy(buf, dayNames[tmPtr->tm_wday]);
+		break;
+	    case 'b':
+	    case 'h':
+		sprintf(buf, "%.3s", monthNames[tmPtr->tm_mon]);
+		break;
+	    case 'B':
+		strcpy(buf, monthNames[tmPtr->tm_mon]);
+		break;
+	    case 'C':
+		sprintf(buf, "%02d", (tmPtr->tm_year + 1900) / 100);
+		break;
+	    case 'd':
+		sprintf(buf, "%02d", tmPtr->tm_mday);
+		break;
+	    case 'D':
+		sprintf(buf, "%02d/%02d/%04d", tmPtr->tm_mon + 1,
+			tmPtr->tm_mday, tmPtr->tm_year + 1900);
+		break;
+	    case 'e':
+		sprintf(buf, "%2d", tmPtr->tm_mday);
+		break;
+	    case 'H':
+		sprintf(buf, "%02d", tmPtr->tm_hour);
+		break;
+	    case 'I':
+		sprintf(buf, "%02d", (tmPtr->tm_hour + 11) % 12 + 1);
+		break;
+	    case 'j':
+		sprintf(buf, "%03d", tmPtr->tm_yday + 1);
+		break;
+	    case 'k':
+		sprintf(buf, "%2d", tmPtr->tm_hour);
+		break;
+	    case 'l':
+		sprintf(buf, "%2d", (tmPtr->tm_hour + 11) % 12 + 1);
+		break;
+	    case 'm':
+		sprintf(buf, "%02d", tmPtr->tm_mon + 1);
+		break;
+	    case 'M':
+		sprintf(buf, "%02d", tmPtr->tm_min);
+		break;
+	    case 'n':
+		strcpy(buf, "\n");
+		break;
+	    case 'p':
+		strcpy(buf, (tmPtr->tm_hour < 12) ? "AM" : "PM");
+		break;
+	    case 'R':
+		sprintf(buf, "%02d:%02d", tmPtr->tm_hour, tmPtr->tm_min);
+		break;
+	    case 's':
+		sprintf(buf, "%ld", l);
+		break;
+	    case 'S':
+		sprintf(buf, "%02d", tmPtr->tm_sec);
+		break;
+	    case 't':
+		strcpy(buf, "\t");
+		break;
+	    case 'T':
+		sprintf(buf, "%02d:%02d:%02d", tmPtr->tm_hour, tmPtr->tm_min,
+			tmPtr->tm_sec);
+		break;
+	    case 'u':
+		sprintf(buf, "%d", (tmPtr->tm_wday == 0) ? 7 : tmPtr->tm_wday);
+		break;
+	    case 'w':
+		sprintf(buf, "%d", tmPtr->tm_wday);
+		break;
+	    case 'y':
+		sprintf(buf, "%02d", (tmPtr->tm_year + 1900) % 100);
+		break;
+	    case 'Y':
+		sprintf(buf, "%04d", tmPtr->tm_year + 1900);
+		break;
+	    case 'Z':
+		if (strftime(buf, sizeof(buf), "%Z", tmPtr) == 0)
+		    return TCL_ERROR;
+		break;
+	    default:
+		return TCL_ERROR;
+	}
+	Tcl_DStringAppend(dStringPtr, buf, -1);
+	p++;
+    }
+    return TCL_OK;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TextFormat_Native --
+ *
+ *	Format the -data of a text element according to its -datatype and
+ *	-format without calling any Tcl commands, if possible.
+ *
+ * Results:
+ *	TCL_OK if the string was formatted, TCL_ERROR if [format] or
+ *	[clock format] must be used instead.
+ *
+ * Side effects:
+ *	The result is appended to dStringPtr.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+TextFormat_Native(
+    TreeCtrl *tree,		/* Widget info. */
+    int dataType,		/* TDT_xxx. */
+    Tcl_Obj *dataObj,		/* -data value. */
+    Tcl_Obj *formatObj,		/* -format value, or NULL. */
+    Tcl_DString *dStringPtr	/* Initialized dynamic string. */
+    )
+{
+    CONST char *format;
+    TextFormat *tf;
+
+    if (formatObj != NULL) {
+	format = Tcl_GetString(formatObj);
+    } else switch (dataType) {
+	case TDT_DOUBLE: format = "%g"; break;
+	case TDT_INTEGER: format = "%d"; break;
+	case TDT_LONG: format = "%ld"; break;
+	case TDT_STRING: format = "%s"; break;
+	case TDT_TIME: format = TEXT_CLOCK_FORMAT; break;
+	default: return TCL_ERROR;
+    }
+    tf = TextFormat_Get(tree, dataType, format);
+    if (!tf->native)
+	return TCL_ERROR;
+    if (dataType == TDT_TIME)
+	return TextFormat_Time(tree, tf, dataObj, dStringPtr);
+    return TextFormat_Printf(tf, dataType, dataObj, dStringPtr);
+}
+
+static void TextUpdateStringRep(TreeElementArgs *args)
+{
+    TreeCtrl *tree = args->tree;
+    TreeElement elem = args->elem;
+    ElementText *elemX = (ElementText *) elem;
+    ElementText *masterX = (ElementText *) elem->master;
+    Tcl_Obj *dataObj, *formatObj;
+    char *text;
+    ElementTextData *etd, *etdM = NULL;
+#ifdef TEXTVAR
+    ElementTextVar *etv;
+    Tcl_Obj *varNameObj;
+#endif
+    int dataType;
+
+    /* Free any string allocated as a result of -data or -textvariable. */
+    if ((elemX->text != NULL) && (elemX->text != elemX->textCfg)) {
+	ckfree(elemX->text);
+    }
+
+    /* Forget any string, and mark the string rep as no-longer invalid. */
+    elemX->text = NULL;
+    elemX->textLen = 0;
+
+    /* If -text is specified, then -data and -textvariable are ignored. */
+    if (elemX->textCfg != NULL) {
+	elemX->text = elemX->textCfg;
+	elemX->textLen = (int) strlen(elemX->textCfg);
+	return;
+    }
+
+#ifdef TEXTVAR
     etv = DynamicOption_FindData(elem->options, DOID_TEXT_VAR);
     varNameObj = etv ? etv->varNameObj : NULL;
 
@@ -3570,6 +5048,22 @@ static void TextUpdateStringRep(TreeElementArgs *args)
 	Tcl_ObjCmdProc *clockObjCmd = NULL, *formatObjCmd = NULL;
 	ClientData clockClientData = NULL, formatClientData = NULL;
 	Tcl_CmdInfo cmdInfo;
+	Tcl_DString dString;
+
+	/* Most formats don't need the Tcl commands. */
+	Tcl_DStringInit(&dString);
+	if (TextFormat_Native(tree, dataType, dataObj, formatObj, &dString)
+		== TCL_OK) {
+	    elemX->textLen = Tcl_DStringLength(&dString);
+	    if (elemX->textLen > 0) {
+		elemX->text = ckalloc(elemX->textLen);
+		memcpy(elemX->text, Tcl_DStringValue(&dString),
+			elemX->textLen);
+	    }
+	    Tcl_DStringFree(&dString);
+	    return;
+	}
+	Tcl_DStringFree(&dString);
 
 	if (Tcl_GetCommandInfo(tree->interp, "::clock", &cmdInfo) == 1) {
 	    clockObjCmd = cmdInfo.objProc;
@@ -3841,6 +5335,7 @@ static char *VarTraceProc_Text(ClientData clientData, Tcl_Interp *interp,
 	DOID_TEXT_VAR);
     Tcl_Obj *varNameObj = etv ? etv->varNameObj : NULL;
     Tcl_Obj *valueObj;
+    int isNew;
 
     /*
      * If the variable is unset, then immediately recreate it unless
@@ -3865,19 +5360,83 @@ static char *VarTraceProc_Text(ClientData clientData, Tcl_Interp *interp,
     }
 
     elemX->textLen = STRINGREP_INVALID;
-    Tree_ElementChangedItself(etv->tree, etv->item, etv->column,
-	(TreeElement) elemX, TEXT_CONF_LAYOUT | TEXT_CONF_TEXTVAR,
-	CS_LAYOUT | CS_DISPLAY);
+
+    /* Master element. */
+    if (etv->item == NULL) {
+	Tree_ElementChangedItself(etv->tree, etv->item, etv->column,
+	    (TreeElement) elemX, TEXT_CONF_LAYOUT | TEXT_CONF_TEXTVAR,
+	    CS_LAYOUT | CS_DISPLAY);
+	return (char *) NULL;
+    }
+
+    /* A variable may be written many times before the next redisplay.
+     * Just remember that the element is out-of-date, the item and
+     * column are invalidated once by TreeElement_UpdateTextVars(). */
+    (void) Tcl_CreateHashEntry(&etv->tree->textVarHash, (char *) elemX,
+	&isNew);
+    if (isNew)
+	Tree_EventuallyRedraw(etv->tree);
     return (char *) NULL;
 }
 #endif /* TEXTVAR */
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * TreeElement_UpdateTextVars --
+ *
+ *	Process the text elements whose -textvariable was written since
+ *	the last call to this procedure. This is called before the
+ *	widget is displayed and at the start of every widget command so
+ *	the changes are never visible from Tcl.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Item sizes and column widths are invalidated.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+TreeElement_UpdateTextVars(
+    TreeCtrl *tree		/* Widget info. */
+    )
+{
+#ifdef TEXTVAR
+    Tcl_HashEntry *hPtr;
+    Tcl_HashSearch search;
+    ElementText *elemX;
+    ElementTextVar *etv;
+
+    if (tree->textVarHash.numEntries == 0)
+	return;
+
+    hPtr = Tcl_FirstHashEntry(&tree->textVarHash, &search);
+    while (hPtr != NULL) {
+	elemX = (ElementText *) Tcl_GetHashKey(&tree->textVarHash, hPtr);
+	etv = DynamicOption_FindData(elemX->header.options, DOID_TEXT_VAR);
+	Tcl_DeleteHashEntry(hPtr);
+	if (etv != NULL) {
+	    Tree_ElementChangedItself(tree, etv->item, etv->column,
+		(TreeElement) elemX, TEXT_CONF_LAYOUT | TEXT_CONF_TEXTVAR,
+		CS_LAYOUT | CS_DISPLAY);
+	}
+	hPtr = Tcl_NextHashEntry(&search);
+    }
+#endif
+}
+
 static void DeleteProcText(TreeElementArgs *args)
 {
     TreeCtrl *tree = args->tree;
     TreeElement elem = args->elem;
     ElementText *elemX = (ElementText *) elem;
     ElementTextLayout2 *etl2;
+#ifdef TEXTVAR
+    Tcl_HashEntry *hPtr;
+#endif
 
     if ((elemX->textCfg == NULL) && (elemX->text != NULL)) {
 	ckfree(elemX->text);
@@ -3890,6 +5449,9 @@ static void DeleteProcText(TreeElementArgs *args)
 	sizeof(ElementTextLayout2));
 #ifdef TEXTVAR
     TextTraceUnset(tree->interp, elemX);
+    hPtr = Tcl_FindHashEntry(&tree->textVarHash, (char *) elemX);
+    if (hPtr != NULL)
+	Tcl_DeleteHashEntry(hPtr);
 #endif
 }
 
@@ -4636,6 +6198,11 @@ struct ElementWindow
 				 * window has been destroyed. */
     int destroy;		/* Destroy window when element
 				 * is deleted */
+    Tcl_Obj *commandObj;	/* -windowcommand */
+    Tcl_Obj *poolObj;		/* Master only: pathnames of windows
+				 * released by offscreen instances. */
+    int pooledWidth;		/* Requested size of the window when it */
+    int pooledHeight;		/* was released to the pool. */
 #define CLIP_WINDOW 1
 #ifdef CLIP_WINDOW
     int clip;			/* TRUE if tkwin is a borderless frame
@@ -4671,6 +6238,9 @@ static Tk_OptionSpec windowOptionSpecs[] = {
     {TK_OPTION_WINDOW, "-window", (char *) NULL, (char *) NULL,
      (char *) NULL, -1, Tk_Offset(ElementWindow, tkwin),
      TK_OPTION_NULL_OK, (ClientData) NULL, EWIN_CONF_WINDOW},
+    {TK_OPTION_CUSTOM, "-windowcommand", (char *) NULL, (char *) NULL,
+     (char *) NULL, Tk_Offset(ElementWindow, commandObj), -1,
+     TK_OPTION_NULL_OK, (ClientData) &TreeCtrlCO_string, 0},
     {TK_OPTION_END, (char *) NULL, (char *) NULL, (char *) NULL,
      (char *) NULL, 0, -1, 0, (ClientData) NULL, 0}
 };
@@ -4684,6 +6254,7 @@ WinItemStructureProc(
 
     if (eventPtr->type == DestroyNotify) {
 	elemX->tkwin = elemX->child = NULL;
+	elemX->pooledWidth = elemX->pooledHeight = 0;
 	Tree_ElementChangedItself(elemX->tree, elemX->item, elemX->column,
 	    (TreeElement) elemX, EWIN_CONF_WINDOW, CS_LAYOUT | CS_DISPLAY);
     }
@@ -4760,39 +6331,566 @@ static Tk_GeomMgr winElemGeomType = {
     WinItemLostSlaveProc,		/* lostSlaveProc */
 };
 
-static void DeleteProcWindow(TreeElementArgs *args)
+/*
+ * When a window element has a -windowcommand, the windows of instances
+ * that scroll offscreen are released to a pool kept by the master
+ * element, and instances that scroll onscreen are given a window from
+ * that pool.  The script is told about each change by calling the
+ * -windowcommand with "bind" or "unbind".  The script calls are queued
+ * by OnScreenProcWindow and evaluated by TreeElement_UpdateWindowPool,
+ * since the onScreenProc is called while the display code is walking
+ * its list of items.
+ */
+
+typedef struct WindowRequest WindowRequest;
+
+struct WindowRequest
 {
-    TreeCtrl *tree = args->tree;
-    TreeElement elem = args->elem;
-    ElementWindow *elemX = (ElementWindow *) elem;
-    ElementWindow *masterX = (ElementWindow *) elem->master;
+    int itemId;			/* Item the element is displayed in. */
+    int columnId;		/* Column the element is displayed in. */
+    Tk_Uid elemName;		/* Name of the master element. */
+    Tcl_Obj *cmdObj;		/* -windowcommand at the time of the
+				 * request. */
+    Tcl_Obj *pathObj;		/* Window that was released, or NULL to
+				 * bind a window. */
+    WindowRequest *next;
+};
 
-    if (elemX->tkwin != NULL) {
-#ifdef CLIP_WINDOW
-	if (elemX->child != NULL) {
-	    Tk_DeleteEventHandler(elemX->child, StructureNotifyMask,
-		    WinItemStructureProc, (ClientData) elemX);
-	    Tk_ManageGeometry(elemX->child, (Tk_GeomMgr *) NULL,
-		    (ClientData) NULL);
-	    Tk_UnmapWindow(elemX->child);
-	    elemX->child = NULL;
-	}
-#endif
-	Tk_DeleteEventHandler(elemX->tkwin, StructureNotifyMask,
+/*
+ *----------------------------------------------------------------------
+ *
+ * WindowPool_Command --
+ *
+ *	Return the -windowcommand of an element or its master.
+ *
+ * Results:
+ *	The command prefix, or NULL if window pooling is not used.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static Tcl_Obj *
+WindowPool_Command(
+    ElementWindow *elemX	/* Master or instance element. */
+    )
+{
+    ElementWindow *masterX = (ElementWindow *) elemX->header.master;
+
+    if (elemX->commandObj != NULL)
+	return elemX->commandObj;
+    if (masterX != NULL)
+	return masterX->commandObj;
+    return NULL;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * WindowPool_Release --
+ *
+ *	Stop managing the window of an element and unmap it.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The element's window is set to NULL.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+WindowPool_Release(
+    TreeCtrl *tree,		/* Widget info. */
+    ElementWindow *elemX	/* Element with a non-NULL window. */
+    )
+{
+#ifdef CLIP_WINDOW
+    if (elemX->child != NULL) {
+	Tk_DeleteEventHandler(elemX->child, StructureNotifyMask,
 		WinItemStructureProc, (ClientData) elemX);
-	Tk_ManageGeometry(elemX->tkwin, (Tk_GeomMgr *) NULL,
+	Tk_ManageGeometry(elemX->child, (Tk_GeomMgr *) NULL,
 		(ClientData) NULL);
-	if (tree->tkwin != Tk_Parent(elemX->tkwin)) {
-	    Tk_UnmaintainGeometry(elemX->tkwin, tree->tkwin);
+	Tk_UnmapWindow(elemX->child);
+	elemX->child = NULL;
+    }
+#endif
+    Tk_DeleteEventHandler(elemX->tkwin, StructureNotifyMask,
+	    WinItemStructureProc, (ClientData) elemX);
+    Tk_ManageGeometry(elemX->tkwin, (Tk_GeomMgr *) NULL,
+	    (ClientData) NULL);
+    if (tree->tkwin != Tk_Parent(elemX->tkwin)) {
+	Tk_UnmaintainGeometry(elemX->tkwin, tree->tkwin);
+    }
+    Tk_UnmapWindow(elemX->tkwin);
+    elemX->tkwin = NULL;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * WindowPool_Push --
+ *
+ *	Add a released window to the pool of a master element.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The pool list is created if needed.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+WindowPool_Push(
+    ElementWindow *masterX,	/* Master element. */
+    Tcl_Obj *pathObj		/* Pathname of the window. */
+    )
+{
+    if (masterX->poolObj == NULL) {
+	masterX->poolObj = Tcl_NewListObj(0, NULL);
+	Tcl_IncrRefCount(masterX->poolObj);
+    }
+    (void) Tcl_ListObjAppendElement(NULL, masterX->poolObj, pathObj);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * WindowPool_Pop --
+ *
+ *	Remove the most-recently released window that still exists
+ *	from the pool of a master element.
+ *
+ * Results:
+ *	The pathname of the window with its reference count incremented,
+ *	or NULL if the pool is empty.
+ *
+ * Side effects:
+ *	Pathnames of windows that were destroyed are discarded.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static Tcl_Obj *
+WindowPool_Pop(
+    TreeCtrl *tree,		/* Widget info. */
+    ElementWindow *masterX	/* Master element. */
+    )
+{
+    Tcl_Obj *pathObj;
+    int count;
+
+    if (masterX->poolObj == NULL)
+	return NULL;
+    while (Tcl_ListObjLength(NULL, masterX->poolObj, &count) == TCL_OK &&
+	    count > 0) {
+	(void) Tcl_ListObjIndex(NULL, masterX->poolObj, count - 1, &pathObj);
+	Tcl_IncrRefCount(pathObj);
+	(void) Tcl_ListObjReplace(NULL, masterX->poolObj, count - 1, 1, 0,
+	    NULL);
+	if (Tk_NameToWindow(tree->interp, Tcl_GetString(pathObj),
+		tree->tkwin) != NULL)
+	    return pathObj;
+	Tcl_ResetResult(tree->interp);
+	Tcl_DecrRefCount(pathObj);
+    }
+    return NULL;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * WindowRequest_Add --
+ *
+ *	Queue a call to an element's -windowcommand to be evaluated by
+ *	TreeElement_UpdateWindowPool.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Memory is allocated.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+WindowRequest_Add(
+    TreeCtrl *tree,		/* Widget info. */
+    TreeElement elem,		/* Master or instance element. */
+    TreeItem item,		/* Item the element is displayed in. */
+    TreeColumn column,		/* Column the element is displayed in,
+				 * may be NULL. */
+    Tcl_Obj *cmdObj,		/* Command prefix. */
+    Tcl_Obj *pathObj		/* Released window, or NULL. */
+    )
+{
+    WindowRequest *req, **tailPtr = &tree->windowRequests;
+
+    while (*tailPtr != NULL)
+	tailPtr = &(*tailPtr)->next;
+
+    req = (WindowRequest *) ckalloc(sizeof(WindowRequest));
+    req->itemId = TreeItem_GetID(tree, item);
+    req->columnId = (column != NULL) ? TreeColumn_GetID(column) : -1;
+    req->elemName = (elem->master != NULL) ? elem->master->name :
+	elem->name;
+    req->cmdObj = cmdObj;
+    Tcl_IncrRefCount(cmdObj);
+    req->pathObj = pathObj;
+    if (pathObj != NULL)
+	Tcl_IncrRefCount(pathObj);
+    req->next = NULL;
+    *tailPtr = req;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * WindowRequest_Free --
+ *
+ *	Free a queued -windowcommand call.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Memory is freed.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+WindowRequest_Free(
+    WindowRequest *req
+    )
+{
+    Tcl_DecrRefCount(req->cmdObj);
+    if (req->pathObj != NULL)
+	Tcl_DecrRefCount(req->pathObj);
+    ckfree((char *) req);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * WindowRequest_Eval --
+ *
+ *	Evaluate "cmdPrefix action path item column element path" at
+ *	global level.
+ *
+ * Results:
+ *	A standard Tcl result.
+ *
+ * Side effects:
+ *	Whatever the command does.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+WindowRequest_Eval(
+    TreeCtrl *tree,		/* Widget info. */
+    WindowRequest *req,		/* Queued call. */
+    CONST char *action,		/* "bind" or "unbind". */
+    TreeItem item,		/* Item token. */
+    TreeColumn column,		/* Column token. */
+    TreeElement elem,		/* Master element. */
+    Tcl_Obj *pathObj		/* Window pathname or NULL. */
+    )
+{
+    Tcl_Interp *interp = tree->interp;
+    Tcl_Obj *listObj;
+    int result;
+
+    listObj = Tcl_DuplicateObj(req->cmdObj);
+    Tcl_IncrRefCount(listObj);
+    result = Tcl_ListObjAppendElement(interp, listObj,
+	Tcl_NewStringObj(action, -1));
+    if (result == TCL_OK) {
+	Tcl_ListObjAppendElement(interp, listObj,
+	    Tcl_NewStringObj(Tk_PathName(tree->tkwin), -1));
+	Tcl_ListObjAppendElement(interp, listObj, TreeItem_ToObj(tree, item));
+	Tcl_ListObjAppendElement(interp, listObj,
+	    TreeColumn_ToObj(tree, column));
+	Tcl_ListObjAppendElement(interp, listObj, TreeElement_ToObj(elem));
+	Tcl_ListObjAppendElement(interp, listObj, (pathObj != NULL) ?
+	    pathObj : Tcl_NewObj());
+	result = Tcl_EvalObjEx(interp, listObj, TCL_EVAL_GLOBAL);
+    }
+    Tcl_DecrRefCount(listObj);
+    if (result != TCL_OK) {
+	Tcl_AddErrorInfo(interp, "\n    (window element -windowcommand)");
+	Tcl_BackgroundError(interp);
+    }
+    return result;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * WindowRequest_Return --
+ *
+ *	Put a window that is no longer bound to an item back in the pool
+ *	of its master element. If the element was deleted while the
+ *	-windowcommand was running, the window is destroyed if the
+ *	element had -destroy set.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	A window may be destroyed.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+WindowRequest_Return(
+    TreeCtrl *tree,		/* Widget info. */
+    WindowRequest *req,		/* Queued call. */
+    TreeElement elem,		/* Master element before the command. */
+    int destroy,		/* -destroy of the master element before
+				 * the command. */
+    Tcl_Obj *pathObj		/* Pathname of the window. */
+    )
+{
+    Tcl_HashEntry *hPtr;
+    Tk_Window tkwin;
+
+    hPtr = Tcl_FindHashEntry(&tree->elementHash, req->elemName);
+    if (hPtr != NULL && Tcl_GetHashValue(hPtr) == (ClientData) elem) {
+	WindowPool_Push((ElementWindow *) elem, pathObj);
+	return;
+    }
+    if (!destroy)
+	return;
+    tkwin = Tk_NameToWindow(tree->interp, Tcl_GetString(pathObj),
+	tree->tkwin);
+    if (tkwin != NULL)
+	Tk_DestroyWindow(tkwin);
+    else
+	Tcl_ResetResult(tree->interp);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * WindowRequest_Run --
+ *
+ *	Evaluate a queued -windowcommand call.  For a released window,
+ *	the command is called with "unbind" and the window is put in the
+ *	master element's pool.  Otherwise a window is taken from the pool
+ *	(if any) and the command is called with "bind"; the window it
+ *	returns, or the pooled window if it returns an empty string,
+ *	becomes the -window of the element in the item.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Whatever the command does.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+WindowRequest_Run(
+    TreeCtrl *tree,		/* Widget info. */
+    WindowRequest *req		/* Queued call. */
+    )
+{
+    Tcl_Interp *interp = tree->interp;
+    Tcl_HashEntry *hPtr;
+    TreeItem item = NULL;
+    TreeColumn column;
+    TreeElement elem = NULL;
+    Tcl_Obj *pathObj, *winObj, *cmdObj, *objv[9];
+    int destroy;
+
+    hPtr = Tcl_FindHashEntry(&tree->itemHash, (char *) INT2PTR(req->itemId));
+    if (hPtr != NULL)
+	item = (TreeItem) Tcl_GetHashValue(hPtr);
+    column = Tree_FirstColumn(tree, -1, FALSE);
+    while (column != NULL && TreeColumn_GetID(column) != req->columnId)
+	column = TreeColumn_Next(column);
+    hPtr = Tcl_FindHashEntry(&tree->elementHash, req->elemName);
+    if (hPtr != NULL) {
+	elem = (TreeElement) Tcl_GetHashValue(hPtr);
+	if (elem->typePtr != &treeElemTypeWindow)
+	    elem = NULL;
+    }
+
+    /* DeleteProcWindow drops the requests of a deleted element. */
+    if (elem == NULL)
+	return;
+    destroy = ((ElementWindow *) elem)->destroy == 1;
+
+    if (req->pathObj != NULL) {
+	if (item != NULL && column != NULL) {
+	    (void) WindowRequest_Eval(tree, req, "unbind", item, column, elem,
+		req->pathObj);
+	}
+	WindowRequest_Return(tree, req, elem, destroy, req->pathObj);
+	return;
+    }
+
+    if (item == NULL || column == NULL)
+	return;
+
+    pathObj = WindowPool_Pop(tree, (ElementWindow *) elem);
+    if (WindowRequest_Eval(tree, req, "bind", item, column, elem,
+	    pathObj) != TCL_OK) {
+	winObj = NULL;
+    } else if (ObjectIsEmpty(Tcl_GetObjResult(interp))) {
+	winObj = pathObj;
+    } else {
+	winObj = Tcl_GetObjResult(interp);
+    }
+    if (winObj == NULL || tree->deleted) {
+	if (pathObj != NULL) {
+	    WindowRequest_Return(tree, req, elem, destroy, pathObj);
+	    Tcl_DecrRefCount(pathObj);
 	}
-	Tk_UnmapWindow(elemX->tkwin);
+	return;
+    }
+    Tcl_IncrRefCount(winObj);
+
+    /* The command may have deleted the element. */
+    hPtr = Tcl_FindHashEntry(&tree->elementHash, req->elemName);
+    if (hPtr == NULL || Tcl_GetHashValue(hPtr) != (ClientData) elem) {
+	if (pathObj != NULL) {
+	    WindowRequest_Return(tree, req, elem, destroy, pathObj);
+	    Tcl_DecrRefCount(pathObj);
+	}
+	Tcl_DecrRefCount(winObj);
+	return;
+    }
+    if (pathObj != NULL) {
+	if (winObj != pathObj)
+	    WindowPool_Push((ElementWindow *) elem, pathObj);
+	Tcl_DecrRefCount(pathObj);
+    }
+
+    /* [$T item element configure $I $C $E -window $win] */
+    objv[0] = Tcl_NewStringObj(Tk_PathName(tree->tkwin), -1);
+    objv[1] = Tcl_NewStringObj("item", -1);
+    objv[2] = Tcl_NewStringObj("element", -1);
+    objv[3] = Tcl_NewStringObj("configure", -1);
+    objv[4] = TreeItem_ToObj(tree, item);
+    objv[5] = TreeColumn_ToObj(tree, column);
+    objv[6] = TreeElement_ToObj(elem);
+    objv[7] = Tcl_NewStringObj("-window", -1);
+    objv[8] = winObj;
+    cmdObj = Tcl_NewListObj(9, objv);
+    Tcl_IncrRefCount(cmdObj);
+    if (Tcl_EvalObjEx(interp, cmdObj, TCL_EVAL_GLOBAL) != TCL_OK) {
+	Tcl_AddErrorInfo(interp, "\n    (window element -windowcommand)");
+	Tcl_BackgroundError(interp);
+    }
+    Tcl_DecrRefCount(cmdObj);
+    Tcl_DecrRefCount(winObj);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TreeElement_UpdateWindowPool --
+ *
+ *	Evaluate the -windowcommand calls queued when window elements
+ *	went onscreen or offscreen.  Called by the display code after
+ *	item visibility has been tracked.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Whatever the commands do.  Windows are assigned to or released
+ *	from items.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+TreeElement_UpdateWindowPool(
+    TreeCtrl *tree		/* Widget info. */
+    )
+{
+    WindowRequest *req;
 
-	if ((elemX->destroy == 1) ||
+    if (tree->windowRequests == NULL)
+	return;
+
+    Tcl_Preserve((ClientData) tree);
+    while (!tree->deleted && (req = tree->windowRequests) != NULL) {
+	tree->windowRequests = req->next;
+	WindowRequest_Run(tree, req);
+	WindowRequest_Free(req);
+    }
+    Tcl_Release((ClientData) tree);
+}
+
+static void DeleteProcWindow(TreeElementArgs *args)
+{
+    TreeCtrl *tree = args->tree;
+    TreeElement elem = args->elem;
+    ElementWindow *elemX = (ElementWindow *) elem;
+    ElementWindow *masterX = (ElementWindow *) elem->master;
+    Tk_Window tkwin = elemX->tkwin;
+
+    if (tkwin != NULL) {
+	WindowPool_Release(tree, elemX);
+
+	/* A pooled window outlives the item it was bound to. */
+	if ((masterX != NULL) && (WindowPool_Command(elemX) != NULL)) {
+	    WindowPool_Push(masterX,
+		Tcl_NewStringObj(Tk_PathName(tkwin), -1));
+	} else if ((elemX->destroy == 1) ||
 		((masterX != NULL) && (masterX->destroy == 1))) {
-	    Tk_DestroyWindow(elemX->tkwin);
+	    Tk_DestroyWindow(tkwin);
 	}
+    }
 
-	elemX->tkwin = NULL;
+    /* Drop this element's pending requests. Windows they released
+     * haven't been returned to the pool by WindowRequest_Run yet. */
+    if (masterX == NULL) {
+	WindowRequest *req, **prevPtr = &tree->windowRequests;
+
+	while ((req = *prevPtr) != NULL) {
+	    if (req->elemName != elem->name) {
+		prevPtr = &req->next;
+		continue;
+	    }
+	    if ((req->pathObj != NULL) && (elemX->destroy == 1)) {
+		tkwin = Tk_NameToWindow(tree->interp,
+		    Tcl_GetString(req->pathObj), tree->tkwin);
+		if (tkwin != NULL)
+		    Tk_DestroyWindow(tkwin);
+		else
+		    Tcl_ResetResult(tree->interp);
+	    }
+	    *prevPtr = req->next;
+	    WindowRequest_Free(req);
+	}
+    }
+
+    if (elemX->poolObj != NULL) {
+	Tcl_Obj *pathObj;
+
+	if (elemX->destroy == 1) {
+	    while ((pathObj = WindowPool_Pop(tree, elemX)) != NULL) {
+		Tk_DestroyWindow(Tk_NameToWindow(tree->interp,
+		    Tcl_GetString(pathObj), tree->tkwin));
+		Tcl_DecrRefCount(pathObj);
+	    }
+	}
+	Tcl_DecrRefCount(elemX->poolObj);
+	elemX->poolObj = NULL;
     }
 }
 
@@ -5131,6 +7229,11 @@ static void NeededProcWindow(TreeElementArgs *args)
 	if (height <= 0) {
 	    height = 1;
 	}
+    } else {
+	/* Keep the size of a window released to the pool so the
+	 * item doesn't change size while it is offscreen. */
+	width = elemX->pooledWidth;
+	height = elemX->pooledHeight;
     }
     args->needed.width = width;
     args->needed.height = height;
@@ -5204,6 +7307,30 @@ static void OnScreenProcWindow(TreeElementArgs *args)
     TreeCtrl *tree = args->tree;
     TreeElement elem = args->elem;
     ElementWindow *elemX = (ElementWindow *) elem;
+    Tcl_Obj *cmdObj = WindowPool_Command(elemX);
+
+    if ((cmdObj != NULL) && (elem->stateDomain == STATE_DOMAIN_ITEM)) {
+	if (!args->screen.visible && (elemX->tkwin != NULL) &&
+		(elem->master != NULL)) {
+	    Tcl_Obj *pathObj;
+
+	    NeededProcWindow(args);
+	    elemX->pooledWidth = args->needed.width;
+	    elemX->pooledHeight = args->needed.height;
+	    pathObj = Tcl_NewStringObj(Tk_PathName(elemX->tkwin), -1);
+	    Tcl_IncrRefCount(pathObj);
+	    WindowPool_Release(tree, elemX);
+	    WindowRequest_Add(tree, elem, args->screen.item,
+		args->screen.column, cmdObj, pathObj);
+	    Tcl_DecrRefCount(pathObj);
+	    return;
+	}
+	if (args->screen.visible && (elemX->tkwin == NULL)) {
+	    WindowRequest_Add(tree, elem, args->screen.item,
+		args->screen.column, cmdObj, NULL);
+	    return;
+	}
+    }
 
     if (!args->screen.visible && (elemX->tkwin != NULL)) {
 	if (tree->tkwin == Tk_Parent(elemX->tkwin)) {
@@ -5282,6 +7409,61 @@ int TreeElement_TypeFromObj(TreeCtrl *tree, Tcl_Obj *objPtr, TreeElementType **t
     return TCL_OK;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * TreeElement_Batch --
+ *
+ *	Call the batchProc of every element type that has one when a
+ *	display pass (Tree_Display) or a column-width pass
+ *	(TreeColumn_WidthOfItems) begins or ends. This is only a
+ *	begin/end notification; the displayProc and neededProc are still
+ *	called once per element in between. Nested passes are ignored,
+ *	so a column-width pass during a display pass is part of it.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Whatever the batchProcs do.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+TreeElement_Batch(
+    TreeCtrl *tree,		/* Widget info. */
+    int what,			/* ELEMENT_BATCH_xxx. */
+    int begin			/* TRUE at the start of the batch, FALSE at
+				 * the end. */
+    )
+{
+    ElementAssocData *assocData;
+    TreeElementType *typePtr;
+    TreeElementArgs args;
+
+    if (begin) {
+	if (tree->elementBatchDepth++ > 0)
+	    return;
+    } else {
+	if (--tree->elementBatchDepth > 0)
+	    return;
+    }
+
+    assocData = Tcl_GetAssocData(tree->interp, "TreeCtrlElementTypes", NULL);
+    args.tree = tree;
+    args.elem = NULL;
+    args.state = 0;
+    args.batch.what = what;
+    args.batch.begin = begin;
+    for (typePtr = assocData->typeList;
+	    typePtr != NULL;
+	    typePtr = typePtr->next) {
+	if (typePtr->batchProc != NULL)
+	    (*typePtr->batchProc)(&args);
+    }
+}
+
 int TreeCtrl_RegisterElementType(Tcl_Interp *interp, TreeElementType *newTypePtr)
 {
     ElementAssocData *assocData;
@@ -5304,8 +7486,10 @@ int TreeCtrl_RegisterElementType(Tcl_Interp *interp, TreeElementType *newTypePtr
 	    ckfree((char *) typePtr);
 	}
     }
+    /* Only copy the fields every version of TreeElementType has. */
     typePtr = (TreeElementType *) ckalloc(sizeof(TreeElementType));
-    memcpy(typePtr, newTypePtr, sizeof(TreeElementType));
+    memcpy(typePtr, newTypePtr, Tk_Offset(TreeElementType, batchProc));
+    typePtr->batchProc = NULL;
 
     typePtr->next = typeList;
     typeList = typePtr;
@@ -5318,6 +7502,48 @@ int TreeCtrl_RegisterElementType(Tcl_Interp *interp, TreeElementType *newTypePtr
     return TCL_OK;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * TreeCtrl_SetElementBatchProc --
+ *
+ *	Set the batchProc of a registered element type. The batchProc
+ *	is told when a display pass or a column-width pass begins and
+ *	ends (see TreeElement_Batch). Elements are still displayed and
+ *	measured one at a time in between.
+ *
+ * Results:
+ *	A standard Tcl result.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+TreeCtrl_SetElementBatchProc(
+    Tcl_Interp *interp,		/* Current interpreter. */
+    CONST char *typeName,	/* Name of a registered element type. */
+    void (*batchProc)(TreeElementArgs *args) /* Proc, or NULL. */
+    )
+{
+    ElementAssocData *assocData;
+    TreeElementType *typePtr;
+
+    assocData = Tcl_GetAssocData(interp, "TreeCtrlElementTypes", NULL);
+    for (typePtr = assocData->typeList;
+	    typePtr != NULL;
+	    typePtr = typePtr->next) {
+	if (!strcmp(typePtr->name, typeName)) {
+	    typePtr->batchProc = batchProc;
+	    return TCL_OK;
+	}
+    }
+    FormatResult(interp, "unknown element type \"%s\"", typeName);
+    return TCL_ERROR;
+}
+
 static TreeCtrlStubs stubs = {
 #ifdef TREECTRL_DEBUG
     sizeof(TreeCtrl),
@@ -5343,7 +7569,8 @@ static TreeCtrlStubs stubs = {
     TreeStateFromObj,
     BooleanCO_Init,
     StringTableCO_Init,
-    PerStateCO_Init
+    PerStateCO_Init,
+    TreeCtrl_SetElementBatchProc
 };
 
 /*
@@ -5385,6 +7612,13 @@ TreeElement_InitWidget(
     Tcl_IncrRefCount(tree->stringFormatObj);
     Tcl_IncrRefCount(tree->optionFormatObj);
 
+    Tcl_InitHashTable(&tree->textFormatHash, TCL_STRING_KEYS);
+    tree->textFormatTZ = NULL;
+    Tcl_InitHashTable(&tree->textVarHash, TCL_ONE_WORD_KEYS);
+    tree->imageRequests = NULL;
+    Tcl_InitHashTable(&tree->imageCalledHash, TCL_ONE_WORD_KEYS);
+    tree->windowRequests = NULL;
+
     return TCL_OK;
 }
 
@@ -5409,6 +7643,11 @@ TreeElement_FreeWidget(
     TreeCtrl *tree
     )
 {
+    Tcl_HashEntry *hPtr;
+    Tcl_HashSearch search;
+    ImageRequest *req;
+    WindowRequest *winReq;
+
     Tcl_DecrRefCount(tree->formatFloatObj);
     Tcl_DecrRefCount(tree->formatIntObj);
     Tcl_DecrRefCount(tree->formatLongObj);
@@ -5417,6 +7656,87 @@ TreeElement_FreeWidget(
     Tcl_DecrRefCount(tree->stringClockObj);
     Tcl_DecrRefCount(tree->stringFormatObj);
     Tcl_DecrRefCount(tree->optionFormatObj);
+
+    hPtr = Tcl_FirstHashEntry(&tree->textFormatHash, &search);
+    while (hPtr != NULL) {
+	ckfree((char *) Tcl_GetHashValue(hPtr));
+	hPtr = Tcl_NextHashEntry(&search);
+    }
+    Tcl_DeleteHashTable(&tree->textFormatHash);
+    if (tree->textFormatTZ != NULL)
+	ckfree(tree->textFormatTZ);
+    Tcl_DeleteHashTable(&tree->textVarHash);
+
+    Tcl_CancelIdleCall(ImageRequest_Proc, (ClientData) tree);
+    while ((req = tree->imageRequests) != NULL) {
+	tree->imageRequests = req->next;
+	Tcl_DecrRefCount(req->cmdObj);
+	ckfree((char *) req);
+    }
+    ImageCalled_Forget(tree, -1, -1, NULL);
+    Tcl_DeleteHashTable(&tree->imageCalledHash);
+    while ((winReq = tree->windowRequests) != NULL) {
+	tree->windowRequests = winReq->next;
+	WindowRequest_Free(winReq);
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TreeElement_ItemDeleted --
+ *
+ *	Called when an item is deleted so the record of which of its
+ *	cells called an -imagecommand isn't applied to a new item that
+ *	reuses its id.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Memory may be freed.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+TreeElement_ItemDeleted(
+    TreeCtrl *tree,		/* Widget info. */
+    TreeItem item		/* Item being deleted. */
+    )
+{
+    if (TreeItem_GetHeader(tree, item) != NULL)
+	return;
+    ImageRequest_Forget(tree, TreeItem_GetID(tree, item), -1, NULL);
+    ImageCalled_Forget(tree, TreeItem_GetID(tree, item), -1, NULL);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TreeElement_ColumnDeleted --
+ *
+ *	Called when a column is deleted so the record of which cells
+ *	called an -imagecommand isn't applied to a new column that
+ *	reuses its id.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Memory may be freed.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+TreeElement_ColumnDeleted(
+    TreeCtrl *tree,		/* Widget info. */
+    TreeColumn column		/* Column being deleted. */
+    )
+{
+    ImageRequest_Forget(tree, -1, TreeColumn_GetID(column), NULL);
+    ImageCalled_Forget(tree, -1, TreeColumn_GetID(column), NULL);
 }
 
 static void FreeAssocData(ClientData clientData, Tcl_Interp *interp)
@@ -5459,6 +7779,12 @@ TreeElement_InitInterp(
 
     /* FIXME: memory leak with dynamically-allocated ClientData. */
 
+    /*
+     * bar, sparkline
+     */
+    PerStateCO_Init(treeElemTypeBar.optionSpecs, "-fill",
+	&pstColor, TreeStateFromObj);
+
     /*
      * bitmap
      */
@@ -5533,6 +7859,18 @@ TreeElement_InitInterp(
 	0, &booleanCO,
 	DynamicOptionInitBoolean);
 
+    DynamicCO_Init(treeElemTypeImage.optionSpecs, "-tint",
+	1004, sizeof(PerStateInfo),
+	Tk_Offset(PerStateInfo, obj),
+	0, PerStateCO_Alloc("-tint", &pstColor, TreeStateFromObj),
+	(DynamicOptionInitProc *) NULL);
+
+    DynamicCO_Init(treeElemTypeImage.optionSpecs, "-imagecommand",
+	1005, sizeof(Tcl_Obj *),
+	0,
+	-1, &TreeCtrlCO_string,
+	(DynamicOptionInitProc *) NULL);
+
     /*
      * rect
      */
@@ -5665,12 +8003,14 @@ TreeElement_InitInterp(
     assocData->typeList = NULL;
     Tcl_SetAssocData(interp, "TreeCtrlElementTypes", FreeAssocData, assocData);
 
+    TreeCtrl_RegisterElementType(interp, &treeElemTypeBar);
     TreeCtrl_RegisterElementType(interp, &treeElemTypeBitmap);
     TreeCtrl_RegisterElementType(interp, &treeElemTypeBorder);
 /*    TreeCtrl_RegisterElementType(interp, &treeElemTypeCheckButton);*/
     TreeCtrl_RegisterElementType(interp, &treeElemTypeHeader);
     TreeCtrl_RegisterElementType(interp, &treeElemTypeImage);
     TreeCtrl_RegisterElementType(interp, &treeElemTypeRect);
+    TreeCtrl_RegisterElementType(interp, &treeElemTypeSparkline);
     TreeCtrl_RegisterElementType(interp, &treeElemTypeText);
     TreeCtrl_RegisterElementType(interp, &treeElemTypeWindow);
 
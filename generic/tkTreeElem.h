@@ -82,7 +82,13 @@ struct TreeElementArgs
     } actual;
     struct {
 	int visible;
+	TreeItem item;		/* Added after 'visible' so older element */
+	TreeColumn column;	/* types still find it at the same offset. */
     } screen;
+    struct {
+	int what;		/* ELEMENT_BATCH_xxx. */
+	int begin;		/* TRUE before the batch, FALSE after. */
+    } batch;
 };
 
 struct TreeElementType
@@ -103,6 +109,12 @@ struct TreeElementType
     int (*actualProc)(TreeElementArgs *args);
     void (*onScreenProc)(TreeElementArgs *args);
     TreeElementType *next;
+    /* Fields below 'next' are not copied by TreeCtrl_RegisterElementType()
+     * so element types compiled against an older header still work. */
+    void (*batchProc)(TreeElementArgs *args); /* May be NULL. Called once
+				 * when a display pass or a column-width
+				 * pass begins and once when it ends. Set
+				 * by TreeCtrl_SetElementBatchProc(). */
 };
 
 /* list of these for each style */
@@ -117,12 +129,14 @@ struct TreeElement_
     /* type-specific data here */
 };
 
+MODULE_SCOPE TreeElementType treeElemTypeBar;
 MODULE_SCOPE TreeElementType treeElemTypeBitmap;
 MODULE_SCOPE TreeElementType treeElemTypeBorder;
 MODULE_SCOPE TreeElementType treeElemTypeCheckButton;
 MODULE_SCOPE TreeElementType treeElemTypeHeader;
 MODULE_SCOPE TreeElementType treeElemTypeImage;
 MODULE_SCOPE TreeElementType treeElemTypeRect;
+MODULE_SCOPE TreeElementType treeElemTypeSparkline;
 MODULE_SCOPE TreeElementType treeElemTypeText;
 MODULE_SCOPE TreeElementType treeElemTypeWindow;
 
@@ -143,6 +157,8 @@ MODULE_SCOPE void Tree_ElementIterateChanged(TreeIterate iter_, int mask);
 MODULE_SCOPE void Tree_ElementChangedItself(TreeCtrl *tree, TreeItem item,
     TreeItemColumn column, TreeElement elem, int flags, int mask);
 MODULE_SCOPE int TreeCtrl_RegisterElementType(Tcl_Interp *interp, TreeElementType *newTypePtr);
+MODULE_SCOPE int TreeCtrl_SetElementBatchProc(Tcl_Interp *interp,
+	CONST char *typeName, void (*batchProc)(TreeElementArgs *args));
 MODULE_SCOPE void TreeElement_GetContentMargins(TreeCtrl *tree,
 	TreeElement elem, int state, int eMargins[4], int uMargins[4],
 	int *arrowHeight);
@@ -188,5 +204,7 @@ struct TreeCtrlStubs
 		CONST char *optionName, CONST char **tablePtr);
     int (*PerStateCO_Init)(Tk_OptionSpec *optionTable, CONST char *optionName,
 		PerStateType *typePtr, StateFromObjProc proc);
+    int (*TreeCtrl_SetElementBatchProc)(Tcl_Interp *interp,
+		CONST char *typeName, void (*batchProc)(TreeElementArgs *args));
 };
 
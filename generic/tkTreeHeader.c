@@ -69,8 +69,24 @@ struct TreeHeaderColumn_
 				 * tree->columnDrag.imageEpoch the drag image
 				 * for this column is recreated. */
     Tk_Uid dragImageName;	/* Name needed to delete the drag image. */
+
+    Pixmap cachePixmap;		/* The style drawn by TreeHeaderColumn_Draw,
+				 * copied into the display while nothing
+				 * affecting its appearance changes. */
+    int cacheEpoch;		/* If this value doesn't match
+				 * tree->headerCacheEpoch the pixmap is
+				 * redrawn. */
+    int cacheWidth, cacheHeight; /* Size of the pixmap. */
+    int cacheState;		/* Item and item-column state the pixmap
+				 * was drawn in. */
+    int cacheIndent;		/* Indent the pixmap was drawn with. */
+    int cacheVisIndex;		/* Span index the pixmap was drawn at. */
 };
 
+/* Beyond this many header-column pixmaps, header-columns without one are
+ * drawn directly. */
+#define HEADER_CACHE_MAX 256
+
 /*
  * The following structure holds [dragconfigure] option info for a TreeHeader.
  */
@@ -875,6 +891,7 @@ Column_Configure(
 	TreeHeaderColumn_ConfigureHeaderStyle(header, column, treeColumn,
 	    objc, objv);
     }
+    column->cacheEpoch = -1;
 
     return TCL_OK;
 }
@@ -1489,6 +1506,202 @@ SetImageForColumn(
     return column->dragImage;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * HeaderColumn_FreeCache --
+ *
+ *	Frees the pixmap holding the drawn style of a header-column.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Memory is freed.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+HeaderColumn_FreeCache(
+    TreeCtrl *tree,		/* Widget info. */
+    HeaderColumn *column	/* Column record. */
+    )
+{
+    if (column->cachePixmap != None) {
+	Tk_FreePixmap(tree->display, column->cachePixmap);
+	column->cachePixmap = None;
+	tree->headerCacheCount--;
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * HeaderColumn_DrawCached --
+ *
+ *	Draws the style of a header-column by copying a pixmap of it
+ *	drawn earlier.  The pixmap is (re)drawn if the size, state,
+ *	indent or span index of the header-column differs from last
+ *	time, or if the cache was invalidated by
+ *	TreeHeader_InvalidateDrawCache.  Scrolling a wide table
+ *	horizontally then doesn't lay out and draw every exposed
+ *	header again.
+ *
+ * Results:
+ *	Returns 1 if the header-column was drawn, or 0 if it can't be
+ *	cached, or the cache is full, and the caller should draw the
+ *	style itself.
+ *
+ * Side effects:
+ *	A pixmap may be allocated and drawn into.  Stuff is drawn in a
+ *	drawable.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+HeaderColumn_DrawCached(
+    TreeHeader header,		/* Header token. */
+    HeaderColumn *column,	/* Column record. */
+    int visIndex,		/* 0-based index in the list of spans. */
+    StyleDrawArgs *drawArgs	/* Various args. */
+    )
+{
+    TreeCtrl *tree = header->tree;
+    int width = drawArgs->width, height = drawArgs->height;
+    int xOrigin = tree->drawableXOrigin, yOrigin = tree->drawableYOrigin;
+    StyleDrawArgs drawArgsCopy;
+    TreeRectangle tr;
+    GC gc;
+
+#ifdef MAC_OSX_TK
+    /* Aqua headers overlap one pixel on each side, which a pixmap the
+     * size of the header-column would cut off. */
+    return 0;
+#endif
+
+    /* The tail column's width changes as the view scrolls.  A gradient
+     * may be positioned relative to the canvas or the window, so its
+     * appearance depends on where the header-column is.  Window elements
+     * place their Tk window when displayed, which must happen at the
+     * header-column's real position. */
+    if ((drawArgs->column == tree->columnTail) ||
+	    (tree->gradientHash.numEntries > 0) ||
+	    TreeStyle_HasWindowElement(tree, drawArgs->style) ||
+	    (width <= 0) || (height <= 0))
+	return 0;
+
+    if ((column->cachePixmap != None) &&
+	    (column->cacheEpoch == tree->headerCacheEpoch) &&
+	    (column->cacheWidth == width) &&
+	    (column->cacheHeight == height) &&
+	    (column->cacheState == drawArgs->state) &&
+	    (column->cacheIndent == drawArgs->indent) &&
+	    (column->cacheVisIndex == visIndex))
+	goto copy;
+
+    if ((column->cachePixmap != None) &&
+	    ((column->cacheWidth != width) || (column->cacheHeight != height)))
+	HeaderColumn_FreeCache(tree, column);
+    if (column->cachePixmap == None) {
+	/* Flushing the whole cache here would make every redraw of a
+	 * screen with more visible header-columns than this reallocate
+	 * all of them. */
+	if (tree->headerCacheCount >= HEADER_CACHE_MAX)
+	    return 0;
+	column->cachePixmap = Tk_GetPixmap(tree->display,
+	    Tk_WindowId(tree->tkwin), width, height, Tk_Depth(tree->tkwin));
+	column->cacheWidth = width;
+	column->cacheHeight = height;
+	tree->headerCacheCount++;
+    }
+
+    drawArgsCopy = *drawArgs;
+    drawArgsCopy.td.drawable = column->cachePixmap;
+    drawArgsCopy.td.width = width;
+    drawArgsCopy.td.height = height;
+    drawArgsCopy.x = drawArgsCopy.y = 0;
+    TreeRect_SetXYWH(drawArgsCopy.bounds, 0, 0, width, height);
+
+    gc = Tk_3DBorderGC(tree->tkwin, tree->border, TK_3D_FLAT_GC);
+    TreeRect_SetXYWH(tr, 0, 0, width, height);
+    Tree_FillRectangle(tree, drawArgsCopy.td, NULL, gc, tr);
+
+    /* Make pixmap coordinates the same as window coordinates so
+     * elements aren't clipped to the part of the header-column that is
+     * currently visible. */
+    tree->drawableXOrigin = tree->xOrigin;
+    tree->drawableYOrigin = tree->yOrigin;
+    TreeStyle_Draw(&drawArgsCopy);
+    tree->drawableXOrigin = xOrigin;
+    tree->drawableYOrigin = yOrigin;
+
+    column->cacheEpoch = tree->headerCacheEpoch;
+    column->cacheState = drawArgs->state;
+    column->cacheIndent = drawArgs->indent;
+    column->cacheVisIndex = visIndex;
+
+copy:
+    XCopyArea(tree->display, column->cachePixmap, drawArgs->td.drawable,
+	tree->copyGC, 0, 0, width, height, drawArgs->x, drawArgs->y);
+    return 1;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TreeHeader_InvalidateDrawCache --
+ *
+ *	Marks the drawn pixmaps of header-columns as out-of-date.
+ *	This is called whenever the appearance of a header may have
+ *	changed without its size or state changing.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The affected header-columns will be drawn again the next time
+ *	they are displayed.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+TreeHeader_InvalidateDrawCache(
+    TreeCtrl *tree,		/* Widget info. */
+    TreeItem item,		/* Header item, or NULL for every header. */
+    TreeColumn treeColumn	/* Column, or NULL for every column. */
+    )
+{
+    TreeItemColumn itemColumn;
+    HeaderColumn *column;
+
+    if (item == NULL) {
+	tree->headerCacheEpoch++;
+	return;
+    }
+    if (treeColumn == NULL) {
+	for (itemColumn = TreeItem_GetFirstColumn(tree, item);
+		itemColumn != NULL;
+		itemColumn = TreeItemColumn_GetNext(tree, itemColumn)) {
+	    column = TreeItemColumn_GetHeaderColumn(tree, itemColumn);
+	    if (column != NULL)
+		column->cacheEpoch = -1;
+	}
+	return;
+    }
+
+    /* Like Tree_InvalidateItemDInfo, only a column at the start of a
+     * span matters. */
+    itemColumn = TreeItem_FindColumn(tree, item, TreeColumn_Index(treeColumn));
+    if (itemColumn != NULL) {
+	column = TreeItemColumn_GetHeaderColumn(tree, itemColumn);
+	if (column != NULL)
+	    column->cacheEpoch = -1;
+    }
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -1552,7 +1765,8 @@ TreeHeaderColumn_Draw(
 	Tree_FillRectangle(tree, td, NULL, gc, tr);
     }
 
-    if ((drawArgs->style != NULL) && !isDragColumn && !isHiddenTail) {
+    if ((drawArgs->style != NULL) && !isDragColumn && !isHiddenTail &&
+	    !HeaderColumn_DrawCached(header, column, visIndex, drawArgs)) {
 	StyleDrawArgs drawArgsCopy = *drawArgs;
 	TreeStyle_Draw(&drawArgsCopy);
     }
@@ -1905,6 +2119,7 @@ TreeHeaderColumn_FreeResources(
 	Tk_FreeImage(column->dragImage);
 	Tk_DeleteImage(tree->interp, column->dragImageName);
     }
+    HeaderColumn_FreeCache(tree, column);
 
     Tk_FreeConfigOptions((char *) column, tree->headerColumnOptionTable,
 	tree->tkwin);
@@ -2200,8 +2415,10 @@ Qualifiers_Scan(
 	switch ((enum qualEnum) qual) {
 	    case QUAL_TAG: {
 		if (tree->columnTagExpr) {
-		    if (q->exprOK)
+		    if (q->exprOK) {
 			TagExpr_Free(&q->expr);
+			q->exprOK = FALSE;
+		    }
 		    if (TagExpr_Init(tree, objv[j + 1], &q->expr) != TCL_OK)
 			return TCL_ERROR;
 		    q->exprOK = TRUE;
@@ -2224,8 +2441,10 @@ Qualifiers_Scan(
     }
     return TCL_OK;
 errorExit:
-    if (q->exprOK)
+    if (q->exprOK) {
 	TagExpr_Free(&q->expr);
+	q->exprOK = FALSE;
+    }
     return TCL_ERROR;
 }
 
@@ -3223,6 +3442,9 @@ TreeHeader_TreeChanged(
     int flagT			/* TREE_CONF_xxx flags. */
     )
 {
+    if (flagT != 0)
+	TreeHeader_InvalidateDrawCache(tree, NULL, NULL);
+
     if (!(flagT & (TREE_CONF_FONT | TREE_CONF_RELAYOUT)))
 	return;
 
@@ -51,6 +51,12 @@ struct TreeItem_ {
 			 * is NULL (unless it was previously allocated
 			 * because some spans were > 1). */
     int spanAlloc;	/* Size of spans[]. */
+    TreeItemColumn *columnArray; /* columnArray[N] is the item-column at
+			 * index N in the columns list. Only allocated
+			 * for items with many columns. */
+    int columnArrayCount; /* Number of valid elements in columnArray[].
+			 * Zero if the list of columns changed. */
+    int columnArrayAlloc; /* Size of columnArray[]. */
 #define ITEM_FLAG_DELETED	0x0001 /* Item is being deleted */
 #define ITEM_FLAG_SPANS_SIMPLE	0x0002 /* All spans are 1 */
 #define ITEM_FLAG_SPANS_VALID	0x0004 /* Some spans are > 1, but we don't
@@ -73,6 +79,12 @@ struct TreeItem_ {
 #define ITEM_FLAGS_BUTTONSTATE (ITEM_FLAG_BUTTONSTATE_ACTIVE | \
     ITEM_FLAG_BUTTONSTATE_PRESSED)
 
+/*
+ * TreeItem_FindColumn walks the list of item-columns for indices below
+ * this and uses Item.columnArray otherwise.
+ */
+#define ITEM_COLUMN_ARRAY_MIN 8
+
 #ifdef ALLOC_HAX
 static CONST char *ItemUid = "Item", *ItemColumnUid = "ItemColumn";
 #endif
@@ -95,6 +107,7 @@ static CONST char *ItemUid = "Item", *ItemColumnUid = "ItemColumn";
 #define ITEM_CONF_SIZE			0x0002
 #define ITEM_CONF_VISIBLE		0x0004
 #define ITEM_CONF_WRAP			0x0008
+#define ITEM_CONF_TAGS			0x0010
 
 /*
  * Information used for Item objv parsing.
@@ -108,7 +121,7 @@ static Tk_OptionSpec itemOptionSpecs[] = {
      TK_OPTION_NULL_OK, (ClientData) NULL, ITEM_CONF_SIZE},
     {TK_OPTION_CUSTOM, "-tags", (char *) NULL, (char *) NULL,
      (char *) NULL, -1, Tk_Offset(TreeItem_, tagInfo),
-     TK_OPTION_NULL_OK, (ClientData) &TreeCtrlCO_tagInfo, 0},
+     TK_OPTION_NULL_OK, (ClientData) &TreeCtrlCO_tagInfo, ITEM_CONF_TAGS},
     {TK_OPTION_CUSTOM, "-visible", (char *) NULL, (char *) NULL,
      "1", -1, Tk_Offset(TreeItem_, flags),
      0, (ClientData) NULL, ITEM_CONF_VISIBLE},
@@ -635,6 +648,41 @@ Item_AllocRoot(
     return item;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * Item_IndexTags --
+ *
+ *	Add or remove an item's tags from the per-tag index used to
+ *	find items by tag. Header items aren't indexed.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Memory may be allocated or freed.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+Item_IndexTags(
+    TreeCtrl *tree,		/* Widget info. */
+    TreeItem item,		/* Item token. */
+    TagInfo *tagInfo,		/* Tags to add or remove. May be NULL. */
+    int add			/* TRUE to add, FALSE to remove. */
+    )
+{
+    if ((tagInfo == NULL) || (item->header != NULL))
+	return;
+    if (add)
+	TagIndex_Add(&tree->itemTagHash, (ClientData) item, tagInfo->tagPtr,
+	    tagInfo->numTags);
+    else
+	TagIndex_Remove(&tree->itemTagHash, (ClientData) item,
+	    tagInfo->tagPtr, tagInfo->numTags);
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -757,7 +805,7 @@ TreeItemColumn_ChangeState(
 		item->state | column->cstate, state);
 	if (sMask) {
 	    if ((sMask & CS_LAYOUT) /*&& (item->header == NULL)*/)
-		TreeColumns_InvalidateWidthOfItems(tree, treeColumn);
+		TreeColumns_InvalidateWidthOfItem(tree, item, treeColumn);
 	    iMask |= sMask;
 	}
 
@@ -830,7 +878,7 @@ TreeItem_ChangeState(
 		    item->state | column->cstate, cstate);
 	    if (sMask) {
 		if (sMask & CS_LAYOUT) {
-		    TreeColumns_InvalidateWidthOfItems(tree, treeColumn);
+		    TreeColumns_InvalidateWidthOfItem(tree, item, treeColumn);
 		    TreeItemColumn_InvalidateSize(tree, column);
 		} else if (sMask & CS_DISPLAY) {
 		    Tree_InvalidateItemDInfo(tree, treeColumn, item, NULL);
@@ -1826,8 +1874,10 @@ Qualifiers_Scan(
 	    }
 	    case QUAL_TAG: {
 		if (tree->itemTagExpr) {
-		    if (q->exprOK)
+		    if (q->exprOK) {
 			TagExpr_Free(&q->expr);
+			q->exprOK = FALSE;
+		    }
 		    if (TagExpr_Init(tree, objv[j + 1], &q->expr) != TCL_OK)
 			return TCL_ERROR;
 		    q->exprOK = TRUE;
@@ -1850,8 +1900,10 @@ Qualifiers_Scan(
     }
     return TCL_OK;
 errorExit:
-    if (q->exprOK)
+    if (q->exprOK) {
 	TagExpr_Free(&q->expr);
+	q->exprOK = FALSE;
+    }
     return TCL_ERROR;
 }
 
@@ -1925,6 +1977,78 @@ Qualifiers_Free(
 	TagExpr_Free(&q->expr);
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * Qualifiers_FindAll --
+ *
+ *	Helper routine for TreeItemList_FromObj. Finds every item that
+ *	matches a tag expression or tag (if given) and the qualifiers.
+ *	When a tag is involved the per-tag index is used so only items
+ *	that could possibly match are tested.
+ *
+ * Results:
+ *	Matching items are appended to the list.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+Qualifiers_FindAll(
+    Qualifiers *q,		/* Qualifiers to check. */
+    TagExpr *expr,		/* Tag expression to match, or NULL. */
+    Tk_Uid tag,			/* Tag to match, or NULL. */
+    TreeItemList *items		/* Initialized list to append to. */
+    )
+{
+    TreeCtrl *tree = q->tree;
+    TreeItemList cands;
+    Tcl_HashEntry *hPtr;
+    Tcl_HashSearch search;
+    TreeItem item;
+    int i, count, narrowed = 0;
+
+    TreeItemList_Init(tree, &cands, 0);
+    if (expr != NULL)
+	narrowed = TagExpr_Candidates(expr, &tree->itemTagHash, &cands);
+    else if (tag != NULL)
+	narrowed = TagIndex_Find(&tree->itemTagHash, &tag, 1, &cands);
+    if (!narrowed) {
+	if (q->exprOK)
+	    narrowed = TagExpr_Candidates(&q->expr, &tree->itemTagHash,
+		&cands);
+	else if (q->tag != NULL)
+	    narrowed = TagIndex_Find(&tree->itemTagHash, &q->tag, 1, &cands);
+    }
+
+    if (narrowed) {
+	count = TreeItemList_Count(&cands);
+	for (i = 0; i < count; i++) {
+	    item = TreeItemList_Nth(&cands, i);
+	    if (((expr == NULL) || TagExpr_Eval(expr, item->tagInfo)) &&
+		    ((tag == NULL) || TreeItem_HasTag(item, tag)) &&
+		    Qualifies(q, item)) {
+		TreeItemList_Append(items, item);
+	    }
+	}
+    } else {
+	hPtr = Tcl_FirstHashEntry(&tree->itemHash, &search);
+	while (hPtr != NULL) {
+	    item = (TreeItem) Tcl_GetHashValue(hPtr);
+	    if (((expr == NULL) || TagExpr_Eval(expr, item->tagInfo)) &&
+		    ((tag == NULL) || TreeItem_HasTag(item, tag)) &&
+		    Qualifies(q, item)) {
+		TreeItemList_Append(items, item);
+	    }
+	    hPtr = Tcl_NextHashEntry(&search);
+	}
+    }
+    TreeItemList_Free(&cands);
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -1951,6 +2075,545 @@ NotManyMsg(
 	doHeaders ? "header" : "item");
 }
 
+/*
+ * An item description is parsed once into a list of steps and the result
+ * is kept in the Tcl_Obj. The first step is the part of the description
+ * that finds the first item(s), each following step is a modifier.
+ * Resolving the steps against the current items is done every time.
+ */
+
+static CONST char *indexName[] = {
+    "active", "all", "anchor", "end", "first", "last", "list",
+    "nearest", "range", "rnc", "root", (char *) NULL
+};
+enum indexEnum {
+    INDEX_ACTIVE, INDEX_ALL, INDEX_ANCHOR, INDEX_END, INDEX_FIRST,
+    INDEX_LAST, INDEX_LIST, INDEX_NEAREST, INDEX_RANGE, INDEX_RNC,
+    INDEX_ROOT,
+    /* These are only used by ItemDescStep.index. */
+    INDEX_ID, INDEX_QUALIFIERS, INDEX_TAG
+};
+/* Number of arguments used by indexName[]. */
+static int indexArgs[] = {
+    1, 1, 1, 1, 1, 1, 2, 3, 3, 3, 1
+};
+/* Boolean: can indexName[] be followed by 1 or more qualifiers. */
+static int indexQual[] = {
+    0, 1, 0, 1, 1, 1, 0, 0, 1, 0, 0, 1
+};
+
+static CONST char *modifiers[] = {
+    "above", "ancestors", "below", "bottom", "child", "children",
+    "descendants", "firstchild", "lastchild", "left", "leftmost", "next",
+    "nextsibling", "parent", "prev", "prevsibling", "right", "rightmost",
+    "sibling", "top", (char *) NULL
+};
+enum modEnum {
+    TMOD_ABOVE, TMOD_ANCESTORS, TMOD_BELOW, TMOD_BOTTOM, TMOD_CHILD,
+    TMOD_CHILDREN, TMOD_DESCENDANTS, TMOD_FIRSTCHILD, TMOD_LASTCHILD,
+    TMOD_LEFT, TMOD_LEFTMOST, TMOD_NEXT, TMOD_NEXTSIBLING, TMOD_PARENT,
+    TMOD_PREV, TMOD_PREVSIBLING, TMOD_RIGHT, TMOD_RIGHTMOST, TMOD_SIBLING,
+    TMOD_TOP
+};
+/* Number of arguments used by modifiers[]. */
+static int modArgs[] = {
+    1, 1, 1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 2, 1, 1
+};
+/* Boolean: can modifiers[] be followed by 1 or more qualifiers. */
+static int modQual[] = {
+    0, 1, 0, 0, 1, 1, 1, 1, 1, 0, 0, 1, 1, 0, 1, 1, 0, 0, 1, 0, 0
+};
+
+typedef struct ItemDescStep {
+    int index;			/* indexEnum for the first step, modEnum
+				 * for the others. */
+    int end;			/* objv[] index following this step and
+				 * its qualifiers. */
+    int args[2];		/* INDEX_ID: item ID.
+				 * INDEX_NEAREST: x and y.
+				 * INDEX_RNC: row and column.
+				 * TMOD_CHILD, TMOD_SIBLING: N and
+				 * endRelative. */
+    TagExpr expr;		/* INDEX_TAG with -itemtagexpr true. */
+    int exprOK;			/* TRUE if expr is valid. */
+    Tk_Uid tag;			/* INDEX_TAG with -itemtagexpr false. */
+    Qualifiers q;		/* Qualifiers following the step. */
+} ItemDescStep;
+
+typedef struct ItemDesc {
+    int refCount;		/* Number of Tcl_Objs and callers using
+				 * this. */
+    TreeCtrl *tree;		/* Widget the description was parsed for. */
+    int generation;		/* tree->itemDescGeneration when parsed. */
+    int objc;			/* Number of words in the description. */
+    Tcl_Obj **objv;		/* Words of the description. */
+    int numSteps;		/* Number of valid steps[]. */
+    ItemDescStep *steps;	/* Parsed steps, at most objc. */
+    int bad;			/* TRUE if the description isn't a
+				 * non-empty list. */
+    Tcl_Obj *errorObj;		/* If not NULL, error message for the
+				 * word following steps[numSteps-1]. */
+} ItemDesc;
+
+typedef struct ItemDescTSD {
+    int generation;		/* Last value given to any widget in this
+				 * thread. */
+} ItemDescTSD;
+
+static Tcl_ThreadDataKey itemDescTDK;
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TreeItem_InvalidateDescriptions --
+ *
+ *	Called when an option or state name that affects how item
+ *	descriptions are parsed has changed.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Any item description previously parsed for this widget will be
+ *	parsed again the next time it is used.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+TreeItem_InvalidateDescriptions(
+    TreeCtrl *tree		/* Widget info. */
+    )
+{
+    ItemDescTSD *tsdPtr = (ItemDescTSD *)
+	    Tcl_GetThreadData(&itemDescTDK, sizeof(ItemDescTSD));
+
+    /* The value is unique among all widgets in this thread, so a
+     * description parsed for a destroyed widget can't match a new widget
+     * that happens to get the same address. */
+    tree->itemDescGeneration = ++tsdPtr->generation;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ItemDesc_Release --
+ *
+ *	Decrement the reference count of a parsed item description and
+ *	free it when no longer used.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Memory may be freed.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+ItemDesc_Release(
+    ItemDesc *desc		/* Parsed item description. */
+    )
+{
+    int i;
+
+    if (--desc->refCount > 0)
+	return;
+    for (i = 0; i < desc->numSteps; i++) {
+	if (desc->steps[i].exprOK)
+	    TagExpr_Free(&desc->steps[i].expr);
+	Qualifiers_Free(&desc->steps[i].q);
+    }
+    for (i = 0; i < desc->objc; i++)
+	Tcl_DecrRefCount(desc->objv[i]);
+    if (desc->objv != NULL)
+	ckfree((char *) desc->objv);
+    if (desc->steps != NULL)
+	ckfree((char *) desc->steps);
+    if (desc->errorObj != NULL)
+	Tcl_DecrRefCount(desc->errorObj);
+    ckfree((char *) desc);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ItemDesc_ParseFirst --
+ *
+ *	Parse the first part of an item description, the part that
+ *	comes before any modifiers.
+ *
+ * Results:
+ *	TCL_OK or TCL_ERROR.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+ItemDesc_ParseFirst(
+    TreeCtrl *tree,		/* Widget info. */
+    ItemDesc *desc,		/* Description being parsed. */
+    ItemDescStep *step		/* Initialized step to fill in. */
+    )
+{
+    Tcl_Interp *interp = tree->interp;
+    int objc = desc->objc;
+    Tcl_Obj **objv = desc->objv;
+    Tcl_Obj *elemPtr = objv[0];
+    Qualifiers *q = &step->q;
+    int index, qualArgsTotal = 0;
+
+    if (Tcl_GetIndexFromObj(NULL, elemPtr, indexName, NULL, 0, &index)
+	    == TCL_OK) {
+
+	if (objc < indexArgs[index]) {
+	    Tcl_AppendResult(interp, "missing arguments to \"",
+		    Tcl_GetString(elemPtr), "\" keyword", NULL);
+	    return TCL_ERROR;
+	}
+
+	if (indexQual[index]) {
+	    if (Qualifiers_Scan(q, objc, objv, indexArgs[index],
+		    &qualArgsTotal) != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	}
+
+	switch ((enum indexEnum) index) {
+	    case INDEX_LIST: {
+		int listObjc;
+		Tcl_Obj **listObjv;
+
+		if (Tcl_ListObjGetElements(interp, objv[1],
+			&listObjc, &listObjv) != TCL_OK) {
+		    return TCL_ERROR;
+		}
+		break;
+	    }
+	    case INDEX_NEAREST: {
+		if (Tk_GetPixelsFromObj(interp, tree->tkwin, objv[1],
+			&step->args[0]) != TCL_OK) {
+		    return TCL_ERROR;
+		}
+		if (Tk_GetPixelsFromObj(interp, tree->tkwin, objv[2],
+			&step->args[1]) != TCL_OK) {
+		    return TCL_ERROR;
+		}
+		break;
+	    }
+	    case INDEX_RNC: {
+		if (Tcl_GetIntFromObj(interp, objv[1], &step->args[0])
+			!= TCL_OK)
+		    return TCL_ERROR;
+		if (Tcl_GetIntFromObj(interp, objv[2], &step->args[1])
+			!= TCL_OK)
+		    return TCL_ERROR;
+		break;
+	    }
+	    default:
+		break;
+	}
+
+	step->index = index;
+	step->end = indexArgs[index] + qualArgsTotal;
+	return TCL_OK;
+    }
+
+    /* Try an itemPrefix + item ID. */
+    if (tree->itemPrefixLen) {
+	char *end, *t = Tcl_GetString(elemPtr);
+	if (strncmp(t, tree->itemPrefix, tree->itemPrefixLen) == 0) {
+	    t += tree->itemPrefixLen;
+	    step->args[0] = strtoul(t, &end, 10);
+	    if ((end != t) && (*end == '\0')) {
+		step->index = INDEX_ID;
+		step->end = 1;
+		return TCL_OK;
+	    }
+	}
+
+    /* Try an item ID. */
+    } else if (Tcl_GetIntFromObj(NULL, elemPtr, &step->args[0]) == TCL_OK) {
+	step->index = INDEX_ID;
+	step->end = 1;
+	return TCL_OK;
+    }
+
+    /* Try a list of qualifiers. This has the same effect as
+     * "all QUALIFIERS". */
+    if (Qualifiers_Scan(q, objc, objv, 0, &qualArgsTotal) != TCL_OK)
+	return TCL_ERROR;
+    if (qualArgsTotal) {
+	step->index = INDEX_QUALIFIERS;
+	step->end = qualArgsTotal;
+	return TCL_OK;
+    }
+
+    /* Try a tag or tag expression followed by qualifiers. */
+    if (objc > 1) {
+	if (Qualifiers_Scan(q, objc, objv, 1, &qualArgsTotal) != TCL_OK)
+	    return TCL_ERROR;
+    }
+    if (tree->itemTagExpr) {
+	if (TagExpr_Init(tree, elemPtr, &step->expr) != TCL_OK)
+	    return TCL_ERROR;
+	step->exprOK = TRUE;
+    } else {
+	step->tag = Tk_GetUid(Tcl_GetString(elemPtr));
+    }
+    step->index = INDEX_TAG;
+    step->end = 1 + qualArgsTotal;
+    return TCL_OK;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ItemDesc_ParseModifier --
+ *
+ *	Parse one modifier of an item description.
+ *
+ * Results:
+ *	TCL_OK or TCL_ERROR.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+ItemDesc_ParseModifier(
+    TreeCtrl *tree,		/* Widget info. */
+    ItemDesc *desc,		/* Description being parsed. */
+    int listIndex,		/* objv[] index of the modifier. */
+    ItemDescStep *step		/* Initialized step to fill in. */
+    )
+{
+    Tcl_Interp *interp = tree->interp;
+    int objc = desc->objc;
+    Tcl_Obj **objv = desc->objv;
+    Tcl_Obj *elemPtr = objv[listIndex];
+    int index, qualArgsTotal = 0;
+
+    if (Tcl_GetIndexFromObj(interp, elemPtr, modifiers, "modifier", 0,
+		&index) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    if (objc - listIndex < modArgs[index]) {
+	Tcl_AppendResult(interp, "missing arguments to \"",
+		Tcl_GetString(elemPtr), "\" modifier", NULL);
+	return TCL_ERROR;
+    }
+
+    if (modQual[index]) {
+	if (Qualifiers_Scan(&step->q, objc, objv, listIndex + modArgs[index],
+		&qualArgsTotal) != TCL_OK) {
+	    return TCL_ERROR;
+	}
+    }
+
+    if ((index == TMOD_CHILD) || (index == TMOD_SIBLING)) {
+	if (Tree_GetIntForIndex(tree, objv[listIndex + 1], &step->args[0],
+		&step->args[1]) != TCL_OK) {
+	    return TCL_ERROR;
+	}
+    }
+
+    step->index = index;
+    step->end = listIndex + modArgs[index] + qualArgsTotal;
+    return TCL_OK;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ItemDesc_Parse --
+ *
+ *	Parse an item description into a list of steps.
+ *
+ *	Syntax errors are not reported here. The error message is saved
+ *	and returned by TreeItemList_FromObj only if the word with the
+ *	error is reached, so the same errors are reported as when each
+ *	word was parsed as it was used.
+ *
+ * Results:
+ *	A new ItemDesc with a reference count of zero.
+ *
+ * Side effects:
+ *	Memory is allocated.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static ItemDesc *
+ItemDesc_Parse(
+    TreeCtrl *tree,		/* Widget info. */
+    Tcl_Obj *objPtr		/* Item description. */
+    )
+{
+    Tcl_Interp *interp = tree->interp;
+    Tcl_SavedResult savedResult;
+    ItemDesc *desc;
+    ItemDescStep *step;
+    Tcl_Obj **objv;
+    int i, objc, listIndex, result;
+
+    desc = (ItemDesc *) ckalloc(sizeof(ItemDesc));
+    memset(desc, '\0', sizeof(ItemDesc));
+    desc->tree = tree;
+    desc->generation = tree->itemDescGeneration;
+
+    if ((Tcl_ListObjGetElements(NULL, objPtr, &objc, &objv) != TCL_OK) ||
+	    (objc == 0)) {
+	desc->bad = TRUE;
+	return desc;
+    }
+
+    /* The words are kept since objPtr won't be a list after this. */
+    desc->objc = objc;
+    desc->objv = (Tcl_Obj **) ckalloc(sizeof(Tcl_Obj *) * objc);
+    for (i = 0; i < objc; i++) {
+	desc->objv[i] = objv[i];
+	Tcl_IncrRefCount(objv[i]);
+    }
+    desc->steps = (ItemDescStep *) ckalloc(sizeof(ItemDescStep) * objc);
+
+    Tcl_SaveResult(interp, &savedResult);
+
+    listIndex = 0;
+    while (listIndex < objc) {
+	step = &desc->steps[desc->numSteps];
+	memset(step, '\0', sizeof(ItemDescStep));
+	Qualifiers_Init(tree, &step->q);
+	if (listIndex == 0)
+	    result = ItemDesc_ParseFirst(tree, desc, step);
+	else
+	    result = ItemDesc_ParseModifier(tree, desc, listIndex, step);
+	if (result != TCL_OK) {
+	    if (step->exprOK)
+		TagExpr_Free(&step->expr);
+	    Qualifiers_Free(&step->q);
+	    desc->errorObj = Tcl_GetObjResult(interp);
+	    Tcl_IncrRefCount(desc->errorObj);
+	    break;
+	}
+	desc->numSteps++;
+	listIndex = step->end;
+    }
+
+    Tcl_RestoreResult(interp, &savedResult);
+
+    return desc;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ItemDescObj_FreeIntRep --
+ * ItemDescObj_DupIntRep --
+ *
+ *	These procedures implement a Tcl_ObjType whose internal rep
+ *	is a parsed item description.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void ItemDescObj_FreeIntRep(Tcl_Obj *objPtr);
+static void ItemDescObj_DupIntRep(Tcl_Obj *srcPtr, Tcl_Obj *dupPtr);
+
+static Tcl_ObjType itemDescObjType = {
+    "TreeCtrlItemDesc",
+    ItemDescObj_FreeIntRep,
+    ItemDescObj_DupIntRep,
+    NULL,
+    NULL
+};
+
+static void
+ItemDescObj_FreeIntRep(
+    Tcl_Obj *objPtr
+    )
+{
+    ItemDesc_Release((ItemDesc *) objPtr->internalRep.otherValuePtr);
+    objPtr->typePtr = NULL;
+}
+
+static void
+ItemDescObj_DupIntRep(
+    Tcl_Obj *srcPtr,
+    Tcl_Obj *dupPtr
+    )
+{
+    ItemDesc *desc = (ItemDesc *) srcPtr->internalRep.otherValuePtr;
+
+    desc->refCount++;
+    dupPtr->internalRep.otherValuePtr = (VOID *) desc;
+    dupPtr->typePtr = &itemDescObjType;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ItemDesc_FromObj --
+ *
+ *	Return the parsed form of an item description, parsing it if
+ *	it wasn't parsed for this widget before or the widget changed
+ *	since then.
+ *
+ * Results:
+ *	An ItemDesc. The caller must call ItemDesc_Release when done.
+ *
+ * Side effects:
+ *	The internal rep of objPtr may change.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static ItemDesc *
+ItemDesc_FromObj(
+    TreeCtrl *tree,		/* Widget info. */
+    Tcl_Obj *objPtr		/* Item description. */
+    )
+{
+    ItemDesc *desc;
+
+    if (objPtr->typePtr == &itemDescObjType) {
+	desc = (ItemDesc *) objPtr->internalRep.otherValuePtr;
+	if ((desc->tree == tree) &&
+		(desc->generation == tree->itemDescGeneration)) {
+	    desc->refCount++;
+	    return desc;
+	}
+    }
+
+    desc = ItemDesc_Parse(tree, objPtr);
+
+    /* Make sure the string rep is valid before the old internal rep
+     * is freed. */
+    (void) Tcl_GetString(objPtr);
+    if ((objPtr->typePtr != NULL) &&
+	    (objPtr->typePtr->freeIntRepProc != NULL)) {
+	objPtr->typePtr->freeIntRepProc(objPtr);
+    }
+    desc->refCount++;
+    objPtr->internalRep.otherValuePtr = (VOID *) desc;
+    objPtr->typePtr = &itemDescObjType;
+
+    desc->refCount++;
+    return desc;
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -2033,301 +2696,163 @@ TreeItemList_FromObj(
     )
 {
     Tcl_Interp *interp = tree->interp;
-    int i, objc, index, listIndex, id;
+    int i, objc, listIndex, stepIndex;
     Tcl_HashEntry *hPtr;
     Tcl_HashSearch search;
-    Tcl_Obj **objv, *elemPtr;
+    Tcl_Obj **objv;
     TreeItem item = NULL;
-    Qualifiers q;
-    int qualArgsTotal;
-
-    static CONST char *indexName[] = {
-	"active", "all", "anchor", "end", "first", "last", "list",
-	"nearest", "range", "rnc", "root", (char *) NULL
-    };
-    enum indexEnum {
-	INDEX_ACTIVE, INDEX_ALL, INDEX_ANCHOR, INDEX_END, INDEX_FIRST,
-	INDEX_LAST, INDEX_LIST, INDEX_NEAREST, INDEX_RANGE, INDEX_RNC,
-	INDEX_ROOT
-    };
-    /* Number of arguments used by indexName[]. */
-    static int indexArgs[] = {
-	1, 1, 1, 1, 1, 1, 2, 3, 3, 3, 1
-    };
-    /* Boolean: can indexName[] be followed by 1 or more qualifiers. */
-    static int indexQual[] = {
-	0, 1, 0, 1, 1, 1, 0, 0, 1, 0, 0, 1
-    };
-
-    static CONST char *modifiers[] = {
-	"above", "ancestors", "below", "bottom", "child", "children",
-	"descendants", "firstchild", "lastchild", "left", "leftmost", "next",
-	"nextsibling", "parent", "prev", "prevsibling", "right", "rightmost",
-	"sibling", "top", (char *) NULL
-    };
-    enum modEnum {
-	TMOD_ABOVE, TMOD_ANCESTORS, TMOD_BELOW, TMOD_BOTTOM, TMOD_CHILD,
-	TMOD_CHILDREN, TMOD_DESCENDANTS, TMOD_FIRSTCHILD, TMOD_LASTCHILD,
-	TMOD_LEFT, TMOD_LEFTMOST, TMOD_NEXT, TMOD_NEXTSIBLING, TMOD_PARENT,
-	TMOD_PREV, TMOD_PREVSIBLING, TMOD_RIGHT, TMOD_RIGHTMOST, TMOD_SIBLING,
-	TMOD_TOP
-    };
-    /* Number of arguments used by modifiers[]. */
-    static int modArgs[] = {
-	1, 1, 1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 2, 1, 1
-    };
-    /* Boolean: can modifiers[] be followed by 1 or more qualifiers. */
-    static int modQual[] = {
-	0, 1, 0, 0, 1, 1, 1, 1, 1, 0, 0, 1, 1, 0, 1, 1, 0, 0, 1, 0, 0
-    };
+    ItemDesc *desc;
+    ItemDescStep *step;
+    Qualifiers *q;
 
     TreeItemList_Init(tree, items, 0);
-    Qualifiers_Init(tree, &q);
 
-    if (Tcl_ListObjGetElements(NULL, objPtr, &objc, &objv) != TCL_OK)
-	goto baditem;
-    if (objc == 0)
+    desc = ItemDesc_FromObj(tree, objPtr);
+    if (desc->bad)
 	goto baditem;
+    objc = desc->objc;
+    objv = desc->objv;
 
-    listIndex = 0;
-    elemPtr = objv[listIndex];
-    if (Tcl_GetIndexFromObj(NULL, elemPtr, indexName, NULL, 0, &index)
-	    == TCL_OK) {
+    if (desc->numSteps == 0)
+	goto parseError;
+    step = &desc->steps[0];
+    q = &step->q;
 
-	if (objc - listIndex < indexArgs[index]) {
-	    Tcl_AppendResult(interp, "missing arguments to \"",
-		    Tcl_GetString(elemPtr), "\" keyword", NULL);
-	    goto errorExit;
-	}
-
-	qualArgsTotal = 0;
-	if (indexQual[index]) {
-	    if (Qualifiers_Scan(&q, objc, objv, listIndex + indexArgs[index],
-		    &qualArgsTotal) != TCL_OK) {
-		goto errorExit;
-	    }
+    switch ((enum indexEnum) step->index) {
+	case INDEX_ACTIVE: {
+	    item = tree->activeItem;
+	    break;
 	}
-
-	switch ((enum indexEnum) index) {
-	    case INDEX_ACTIVE: {
-		item = tree->activeItem;
-		break;
-	    }
-	    case INDEX_ALL: {
-		if (qualArgsTotal) {
-		    hPtr = Tcl_FirstHashEntry(&tree->itemHash, &search);
-		    while (hPtr != NULL) {
-			item = (TreeItem) Tcl_GetHashValue(hPtr);
-			if (Qualifies(&q, item)) {
-			    TreeItemList_Append(items, (TreeItem) item);
-			}
-			hPtr = Tcl_NextHashEntry(&search);
-		    }
-		    item = NULL;
-		} else if (flags & IFO_LIST_ALL) {
-		    hPtr = Tcl_FirstHashEntry(&tree->itemHash, &search);
-		    while (hPtr != NULL) {
-			item = (TreeItem) Tcl_GetHashValue(hPtr);
-			TreeItemList_Append(items, item);
-			hPtr = Tcl_NextHashEntry(&search);
-		    }
-		    item = NULL;
-		} else {
-		    item = ITEM_ALL;
-		}
-		break;
-	    }
-	    case INDEX_ANCHOR: {
-		item = tree->anchorItem;
-		break;
-	    }
-	    case INDEX_FIRST: {
-		item = tree->root;
-		while (!Qualifies(&q, item))
-		    item = TreeItem_Next(tree, item);
-		break;
-	    }
-	    case INDEX_END:
-	    case INDEX_LAST: {
-		item = tree->root;
-		while (item->lastChild) {
-		    item = item->lastChild;
-		}
-		while (!Qualifies(&q, item))
-		    item = TreeItem_Prev(tree, item);
-		break;
-	    }
-	    case INDEX_LIST: {
-		int listObjc;
-		Tcl_Obj **listObjv;
-		int count;
-
-		if (Tcl_ListObjGetElements(interp, objv[listIndex + 1],
-			&listObjc, &listObjv) != TCL_OK) {
-		    goto errorExit;
-		}
-		for (i = 0; i < listObjc; i++) {
-		    TreeItemList item2s;
-		    if (TreeItemList_FromObj(tree, listObjv[i], &item2s, flags)
-			    != TCL_OK)
-			goto errorExit;
-		    TreeItemList_Concat(items, &item2s);
-		    TreeItemList_Free(&item2s);
-		}
-		/* If any of the item descriptions in the list is "all", then
-		 * clear the list of items and use "all". */
-		count = TreeItemList_Count(items);
-		for (i = 0; i < count; i++) {
-		    TreeItem item2 = TreeItemList_Nth(items, i);
-		    if (IS_ALL(item2))
-			break;
-		}
-		if (i < count) {
-		    TreeItemList_Free(items);
-		    item = ITEM_ALL;
-		} else
-		    item = NULL;
-		break;
-	    }
-	    case INDEX_NEAREST: {
-		int x, y;
-
-		if (Tk_GetPixelsFromObj(interp, tree->tkwin,
-			objv[listIndex + 1], &x) != TCL_OK) {
-		    goto errorExit;
-		}
-		if (Tk_GetPixelsFromObj(interp, tree->tkwin,
-			objv[listIndex + 2], &y) != TCL_OK) {
-		    goto errorExit;
-		}
-		item = Tree_ItemUnderPoint(tree, &x, &y, NULL, TRUE);
-		break;
-	    }
-	    case INDEX_RANGE: {
-		TreeItem itemFirst, itemLast;
-
-		if (TreeItem_FromObj(tree, objv[listIndex + 1], &itemFirst,
-			IFO_NOT_NULL) != TCL_OK)
-		    goto errorExit;
-		if (TreeItem_FromObj(tree, objv[listIndex + 2], &itemLast,
-			IFO_NOT_NULL) != TCL_OK)
-		    goto errorExit;
-		if (TreeItem_FirstAndLast(tree, &itemFirst, &itemLast) == 0)
-		    goto errorExit;
-		while (1) {
-		    if (Qualifies(&q, itemFirst)) {
-			TreeItemList_Append(items, itemFirst);
-		    }
-		    if (itemFirst == itemLast)
-			break;
-		    itemFirst = TreeItem_Next(tree, itemFirst);
+	case INDEX_ALL: {
+	    if (step->end > indexArgs[INDEX_ALL]) {
+		Qualifiers_FindAll(q, NULL, NULL, items);
+		item = NULL;
+	    } else if (flags & IFO_LIST_ALL) {
+		hPtr = Tcl_FirstHashEntry(&tree->itemHash, &search);
+		while (hPtr != NULL) {
+		    item = (TreeItem) Tcl_GetHashValue(hPtr);
+		    TreeItemList_Append(items, item);
+		    hPtr = Tcl_NextHashEntry(&search);
 		}
 		item = NULL;
-		break;
+	    } else {
+		item = ITEM_ALL;
+	    }
+	    break;
+	}
+	case INDEX_ANCHOR: {
+	    item = tree->anchorItem;
+	    break;
+	}
+	case INDEX_FIRST: {
+	    item = tree->root;
+	    while (!Qualifies(q, item))
+		item = TreeItem_Next(tree, item);
+	    break;
+	}
+	case INDEX_END:
+	case INDEX_LAST: {
+	    item = tree->root;
+	    while (item->lastChild) {
+		item = item->lastChild;
 	    }
-	    case INDEX_RNC: {
-		int row, col;
+	    while (!Qualifies(q, item))
+		item = TreeItem_Prev(tree, item);
+	    break;
+	}
+	case INDEX_LIST: {
+	    int listObjc;
+	    Tcl_Obj **listObjv;
+	    int count;
 
-		if (Tcl_GetIntFromObj(interp, objv[listIndex + 1], &row) != TCL_OK)
-		    goto errorExit;
-		if (Tcl_GetIntFromObj(interp, objv[listIndex + 2], &col) != TCL_OK)
+	    if (Tcl_ListObjGetElements(interp, objv[1],
+		    &listObjc, &listObjv) != TCL_OK) {
+		goto errorExit;
+	    }
+	    for (i = 0; i < listObjc; i++) {
+		TreeItemList item2s;
+		if (TreeItemList_FromObj(tree, listObjv[i], &item2s, flags)
+			!= TCL_OK)
 		    goto errorExit;
-		item = Tree_RNCToItem(tree, row, col);
-		break;
+		TreeItemList_Concat(items, &item2s);
+		TreeItemList_Free(&item2s);
 	    }
-	    case INDEX_ROOT: {
-		item = tree->root;
-		break;
+	    /* If any of the item descriptions in the list is "all", then
+	     * clear the list of items and use "all". */
+	    count = TreeItemList_Count(items);
+	    for (i = 0; i < count; i++) {
+		TreeItem item2 = TreeItemList_Nth(items, i);
+		if (IS_ALL(item2))
+		    break;
 	    }
+	    if (i < count) {
+		TreeItemList_Free(items);
+		item = ITEM_ALL;
+	    } else
+		item = NULL;
+	    break;
 	}
+	case INDEX_NEAREST: {
+	    int x = step->args[0], y = step->args[1];
 
-	listIndex += indexArgs[index] + qualArgsTotal;
-
-    /* No indexName[] was found. */
-    } else {
-	int gotId = FALSE;
-	TagExpr expr;
+	    item = Tree_ItemUnderPoint(tree, &x, &y, NULL, TRUE);
+	    break;
+	}
+	case INDEX_RANGE: {
+	    TreeItem itemFirst, itemLast;
 
-	/* Try an itemPrefix + item ID. */
-	if (tree->itemPrefixLen) {
-	    char *end, *t = Tcl_GetString(elemPtr);
-	    if (strncmp(t, tree->itemPrefix, tree->itemPrefixLen) == 0) {
-		t += tree->itemPrefixLen;
-		id = strtoul(t, &end, 10);
-		if ((end != t) && (*end == '\0'))
-		    gotId = TRUE;
+	    if (TreeItem_FromObj(tree, objv[1], &itemFirst,
+		    IFO_NOT_NULL) != TCL_OK)
+		goto errorExit;
+	    if (TreeItem_FromObj(tree, objv[2], &itemLast,
+		    IFO_NOT_NULL) != TCL_OK)
+		goto errorExit;
+	    if (TreeItem_FirstAndLast(tree, &itemFirst, &itemLast) == 0)
+		goto errorExit;
+	    while (1) {
+		if (Qualifies(q, itemFirst)) {
+		    TreeItemList_Append(items, itemFirst);
+		}
+		if (itemFirst == itemLast)
+		    break;
+		itemFirst = TreeItem_Next(tree, itemFirst);
 	    }
-
-	/* Try an item ID. */
-	} else if (Tcl_GetIntFromObj(NULL, elemPtr, &id) == TCL_OK) {
-	    gotId = TRUE;
+	    item = NULL;
+	    break;
+	}
+	case INDEX_RNC: {
+	    item = Tree_RNCToItem(tree, step->args[0], step->args[1]);
+	    break;
+	}
+	case INDEX_ROOT: {
+	    item = tree->root;
+	    break;
 	}
-	if (gotId) {
-	    hPtr = Tcl_FindHashEntry(&tree->itemHash, (char *) INT2PTR(id));
+	case INDEX_ID: {
+	    hPtr = Tcl_FindHashEntry(&tree->itemHash,
+		    (char *) INT2PTR(step->args[0]));
 	    if (hPtr != NULL) {
 		item = (TreeItem) Tcl_GetHashValue(hPtr);
 	    } else {
 		item = NULL;
 	    }
-	    listIndex++;
-	    goto gotFirstPart;
-	}
-
-	/* Try a list of qualifiers. This has the same effect as
-	 * "all QUALIFIERS". */
-	if (Qualifiers_Scan(&q, objc, objv, listIndex, &qualArgsTotal)
-		!= TCL_OK) {
-	    goto errorExit;
+	    break;
 	}
-	if (qualArgsTotal) {
-	    hPtr = Tcl_FirstHashEntry(&tree->itemHash, &search);
-	    while (hPtr != NULL) {
-		item = (TreeItem) Tcl_GetHashValue(hPtr);
-		if (Qualifies(&q, item)) {
-		    TreeItemList_Append(items, item);
-		}
-		hPtr = Tcl_NextHashEntry(&search);
-	    }
+	case INDEX_QUALIFIERS: {
+	    Qualifiers_FindAll(q, NULL, NULL, items);
 	    item = NULL;
-	    listIndex += qualArgsTotal;
-	    goto gotFirstPart;
-	}
-
-	/* Try a tag or tag expression followed by qualifiers. */
-	if (objc > 1) {
-	    if (Qualifiers_Scan(&q, objc, objv, listIndex + 1,
-		    &qualArgsTotal) != TCL_OK) {
-		goto errorExit;
-	    }
+	    break;
 	}
-	if (tree->itemTagExpr) {
-	    if (TagExpr_Init(tree, elemPtr, &expr) != TCL_OK)
-		goto errorExit;
-	    hPtr = Tcl_FirstHashEntry(&tree->itemHash, &search);
-	    while (hPtr != NULL) {
-		item = (TreeItem) Tcl_GetHashValue(hPtr);
-		if (TagExpr_Eval(&expr, item->tagInfo) && Qualifies(&q, item)) {
-		    TreeItemList_Append(items, item);
-		}
-		hPtr = Tcl_NextHashEntry(&search);
-	    }
-	    TagExpr_Free(&expr);
-	} else {
-	    Tk_Uid tag = Tk_GetUid(Tcl_GetString(elemPtr));
-	    hPtr = Tcl_FirstHashEntry(&tree->itemHash, &search);
-	    while (hPtr != NULL) {
-		item = (TreeItem) Tcl_GetHashValue(hPtr);
-		if (TreeItem_HasTag(item, tag) && Qualifies(&q, item)) {
-		    TreeItemList_Append(items, item);
-		}
-		hPtr = Tcl_NextHashEntry(&search);
-	    }
+	case INDEX_TAG: {
+	    Qualifiers_FindAll(q, step->exprOK ? &step->expr : NULL,
+		    step->tag, items);
+	    item = NULL;
+	    break;
 	}
-	item = NULL;
-	listIndex += 1 + qualArgsTotal;
     }
 
-gotFirstPart:
+    listIndex = step->end;
+
     /* If 1 item, use it and clear the list. */
     if (TreeItemList_Count(items) == 1) {
 	item = TreeItemList_Nth(items, 0);
@@ -2363,30 +2888,14 @@ gotFirstPart:
     }
 
     /* Process any modifiers following the item we matched above. */
-    for (; listIndex < objc; /* nothing */) {
-
-	elemPtr = objv[listIndex];
-	if (Tcl_GetIndexFromObj(interp, elemPtr, modifiers, "modifier", 0,
-		    &index) != TCL_OK) {
-	    goto errorExit;
-	}
-	if (objc - listIndex < modArgs[index]) {
-	    Tcl_AppendResult(interp, "missing arguments to \"",
-		    Tcl_GetString(elemPtr), "\" modifier", NULL);
-	    goto errorExit;
-	}
+    for (stepIndex = 1; listIndex < objc; stepIndex++) {
 
-	qualArgsTotal = 0;
-	if (modQual[index]) {
-	    Qualifiers_Free(&q);
-	    Qualifiers_Init(tree, &q);
-	    if (Qualifiers_Scan(&q, objc, objv, listIndex + modArgs[index],
-		    &qualArgsTotal) != TCL_OK) {
-		goto errorExit;
-	    }
-	}
+	if (stepIndex == desc->numSteps)
+	    goto parseError;
+	step = &desc->steps[stepIndex];
+	q = &step->q;
 
-	switch ((enum modEnum) index) {
+	switch ((enum modEnum) step->index) {
 	    case TMOD_ABOVE: {
 		item = Tree_ItemAbove(tree, item);
 		break;
@@ -2394,7 +2903,7 @@ gotFirstPart:
 	    case TMOD_ANCESTORS: {
 		item = item->parent;
 		while (item != NULL) {
-		    if (Qualifies(&q, item)) {
+		    if (Qualifies(q, item)) {
 			TreeItemList_Append(items, item);
 		    }
 		    item = item->parent;
@@ -2411,16 +2920,12 @@ gotFirstPart:
 		break;
 	    }
 	    case TMOD_CHILD: {
-		int n, endRelative;
+		int n = step->args[0], endRelative = step->args[1];
 
-		if (Tree_GetIntForIndex(tree, objv[listIndex + 1], &n,
-			&endRelative) != TCL_OK) {
-		    goto errorExit;
-		}
 		if (endRelative) {
 		    item = item->lastChild;
 		    while (item != NULL) {
-			if (Qualifies(&q, item))
+			if (Qualifies(q, item))
 			    if (n-- <= 0)
 				break;
 			item = item->prevSibling;
@@ -2428,7 +2933,7 @@ gotFirstPart:
 		} else {
 		    item = item->firstChild;
 		    while (item != NULL) {
-			if (Qualifies(&q, item))
+			if (Qualifies(q, item))
 			    if (n-- <= 0)
 				break;
 			item = item->nextSibling;
@@ -2439,7 +2944,7 @@ gotFirstPart:
 	    case TMOD_CHILDREN: {
 		item = item->firstChild;
 		while (item != NULL) {
-		    if (Qualifies(&q, item)) {
+		    if (Qualifies(q, item)) {
 			TreeItemList_Append(items, item);
 		    }
 		    item = item->nextSibling;
@@ -2454,7 +2959,7 @@ gotFirstPart:
 		    last = last->lastChild;
 		item = item->firstChild;
 		while (item != NULL) {
-		    if (Qualifies(&q, item)) {
+		    if (Qualifies(q, item)) {
 			TreeItemList_Append(items, item);
 		    }
 		    if (item == last)
@@ -2466,13 +2971,13 @@ gotFirstPart:
 	    }
 	    case TMOD_FIRSTCHILD: {
 		item = item->firstChild;
-		while (!Qualifies(&q, item))
+		while (!Qualifies(q, item))
 		    item = item->nextSibling;
 		break;
 	    }
 	    case TMOD_LASTCHILD: {
 		item = item->lastChild;
-		while (!Qualifies(&q, item))
+		while (!Qualifies(q, item))
 		    item = item->prevSibling;
 		break;
 	    }
@@ -2486,13 +2991,13 @@ gotFirstPart:
 	    }
 	    case TMOD_NEXT: {
 		item = TreeItem_Next(tree, item);
-		while (!Qualifies(&q, item))
+		while (!Qualifies(q, item))
 		    item = TreeItem_Next(tree, item);
 		break;
 	    }
 	    case TMOD_NEXTSIBLING: {
 		item = item->nextSibling;
-		while (!Qualifies(&q, item))
+		while (!Qualifies(q, item))
 		    item = item->nextSibling;
 		break;
 	    }
@@ -2502,13 +3007,13 @@ gotFirstPart:
 	    }
 	    case TMOD_PREV: {
 		item = TreeItem_Prev(tree, item);
-		while (!Qualifies(&q, item))
+		while (!Qualifies(q, item))
 		    item = TreeItem_Prev(tree, item);
 		break;
 	    }
 	    case TMOD_PREVSIBLING: {
 		item = item->prevSibling;
-		while (!Qualifies(&q, item))
+		while (!Qualifies(q, item))
 		    item = item->prevSibling;
 		break;
 	    }
@@ -2521,19 +3026,15 @@ gotFirstPart:
 		break;
 	    }
 	    case TMOD_SIBLING: {
-		int n, endRelative;
+		int n = step->args[0], endRelative = step->args[1];
 
-		if (Tree_GetIntForIndex(tree, objv[listIndex + 1], &n,
-			&endRelative) != TCL_OK) {
-		    goto errorExit;
-		}
 		item = item->parent;
 		if (item == NULL)
 		    break;
 		if (endRelative) {
 		    item = item->lastChild;
 		    while (item != NULL) {
-			if (Qualifies(&q, item))
+			if (Qualifies(q, item))
 			    if (n-- <= 0)
 				break;
 			item = item->prevSibling;
@@ -2541,7 +3042,7 @@ gotFirstPart:
 		} else {
 		    item = item->firstChild;
 		    while (item != NULL) {
-			if (Qualifies(&q, item))
+			if (Qualifies(q, item))
 			    if (n-- <= 0)
 				break;
 			item = item->nextSibling;
@@ -2555,7 +3056,7 @@ gotFirstPart:
 	    }
 	}
 	if ((TreeItemList_Count(items) > 1) || IS_ALL(item)) {
-	    int end = listIndex + modArgs[index] + qualArgsTotal;
+	    int end = step->end;
 	    if (end < objc) {
 		Tcl_AppendResult(interp, "unexpected arguments after \"",
 		    (char *) NULL);
@@ -2574,7 +3075,7 @@ gotFirstPart:
 	    /* Empty list returned. */
 	    goto goodExit;
 	}
-	listIndex += modArgs[index] + qualArgsTotal;
+	listIndex = step->end;
     }
     if ((flags & IFO_NOT_MANY) && (IS_ALL(item) ||
 	    (TreeItemList_Count(items) > 1))) {
@@ -2609,7 +3110,7 @@ notOrphan:
 	TreeItemList_Append(items, item);
     }
 goodExit:
-    Qualifiers_Free(&q);
+    ItemDesc_Release(desc);
     return TCL_OK;
 
 baditem:
@@ -2617,12 +3118,16 @@ baditem:
 	    "\"", NULL);
     goto errorExit;
 
+parseError:
+    Tcl_AppendResult(interp, Tcl_GetString(desc->errorObj), NULL);
+    goto errorExit;
+
 noitem:
     Tcl_AppendResult(interp, "item \"", Tcl_GetString(objPtr),
 	    "\" doesn't exist", NULL);
 
 errorExit:
-    Qualifiers_Free(&q);
+    ItemDesc_Release(desc);
     TreeItemList_Free(items);
     return TCL_ERROR;
 }
@@ -2912,6 +3417,7 @@ TreeItem_Delete(
     TreeDisplay_ItemDeleted(tree, item);
     TreeGradient_ItemDeleted(tree, item);
     TreeTheme_ItemDeleted(tree, item);
+    TreeElement_ItemDeleted(tree, item);
     if (item->header != NULL)
 	Tree_RemoveHeader(tree, item);
     else
@@ -3124,6 +3630,7 @@ TreeItem_AddToParent(
     }
 
     tree->updateIndex = 1;
+    tree->itemGeneration++;
     Tree_DInfoChanged(tree, DINFO_REDO_RANGES);
 
     /* Tree_UpdateItemIndex() also recalcs depth, but in one of my demos
@@ -3236,6 +3743,7 @@ TreeItem_RemoveFromParent(
      * cover the current item being removed.
      */
     tree->updateIndex = 1;
+    tree->itemGeneration++;
     Tree_DInfoChanged(tree, DINFO_REDO_RANGES);
 
     if (item->prevSibling)
@@ -3306,6 +3814,7 @@ TreeItem_RemoveColumns(
 	prev->next = next;
     else if (first == 0)
 	item->columns = next;
+    item->columnArrayCount = 0;
 }
 
 /*
@@ -3337,12 +3846,14 @@ TreeItem_RemoveAllColumns(
 	/* Don't delete the tail item-column in header items. */
 	if (item->header != NULL && next == NULL) {
 	    item->columns = column;
+	    item->columnArrayCount = 0;
 	    return;
 	}
 	Column_FreeResources(tree, column);
 	column = next;
     }
     item->columns = NULL;
+    item->columnArrayCount = 0;
 }
 
 /*
@@ -3382,6 +3893,9 @@ Item_CreateColumn(
 #endif
 
     if (isNew != NULL) (*isNew) = FALSE;
+    column = TreeItem_FindColumn(tree, item, columnIndex);
+    if (column != NULL)
+	goto done;
     column = item->columns;
     if (column == NULL) {
 	column = Column_Alloc(tree, item);
@@ -3395,6 +3909,9 @@ Item_CreateColumn(
 	}
 	column = column->next;
     }
+    item->columnArrayCount = 0;
+
+done:
 
 /* If creating a new -lock=none column then Column_Move does nothing */
 if (item->header != NULL && columnIndex == TreeColumn_Index(tree->columnTail) + 1) {
@@ -3480,6 +3997,7 @@ TreeItem_MoveColumn(
 	    prevB->next = move;
 	move->next = before;
     }
+    item->columnArrayCount = 0;
 }
 
 /*
@@ -3515,8 +4033,11 @@ TreeItem_FreeResources(
 	Tree_FreeItemRInfo(tree, item);
     if (item->spans != NULL)
 	ckfree((char *) item->spans);
+    if (item->columnArray != NULL)
+	ckfree((char *) item->columnArray);
     if (item->header != NULL)
 	TreeHeader_FreeResources(item->header);
+    Item_IndexTags(tree, item, item->tagInfo, FALSE);
     Tk_FreeConfigOptions((char *) item, tree->itemOptionTable, tree->tkwin);
 
     /* Add the item record to the "preserved" list. It will be freed later. */
@@ -3766,7 +4287,8 @@ TreeItem_InvalidateHeight(
  *	The item-column token or NULL.
  *
  * Side effects:
- *	None.
+ *	For items with many columns, an array of the item-columns is
+ *	built so later lookups don't have to walk the list.
  *
  *----------------------------------------------------------------------
  */
@@ -3782,13 +4304,32 @@ TreeItem_FindColumn(
     int i = 0;
 
     column = item->columns;
-    if (!column)
+    if (!column || columnIndex < 0)
 	return NULL;
-    while (column != NULL && i < columnIndex) {
-	column = column->next;
-	i++;
+
+    if (columnIndex < ITEM_COLUMN_ARRAY_MIN) {
+	while (column != NULL && i < columnIndex) {
+	    column = column->next;
+	    i++;
+	}
+	return column;
     }
-    return column;
+
+    if (item->columnArrayCount == 0) {
+	for (i = 0; column != NULL; column = column->next, i++) {
+	    if (i == item->columnArrayAlloc) {
+		item->columnArrayAlloc = MAX(i * 2, ITEM_COLUMN_ARRAY_MIN * 2);
+		item->columnArray = (TreeItemColumn *) ckrealloc(
+		    (char *) item->columnArray,
+		    sizeof(TreeItemColumn) * item->columnArrayAlloc);
+	    }
+	    item->columnArray[i] = column;
+	}
+	item->columnArrayCount = i;
+    }
+    if (columnIndex >= item->columnArrayCount)
+	return NULL;
+    return item->columnArray[columnIndex];
 }
 
 /*
@@ -4240,6 +4781,10 @@ Item_GetSpans(
 				      * their current drag positions. */
 #define WALKSPAN_IGNORE_DRAGGED 0x04 /* Don't call the callback routine for
                                       * dragged headers. */
+#define WALKSPAN_CLIP 0x08	     /* Skip columns outside the clipping
+				      * range without looking at them. */
+#define WALKSPAN_CLIP_BOUNDS 0x10    /* Like WALKSPAN_CLIP, but clip to the
+				      * displayed area in window coords. */
     int dragPosition
     )
 {
@@ -4370,6 +4915,15 @@ typedef int (*TreeItemWalkSpansProc)(
  *	for each span of non-zero width. This is used for drawing,
  *	hit-testing and other purposes.
  *
+ *	If dragPosition includes WALKSPAN_CLIP, the columns that are
+ *	entirely outside the range [clipMinX,clipMaxX) are found by a
+ *	binary search and never visited. This keeps drawing an item
+ *	in a table with thousands of columns proportional to the number
+ *	of columns on screen. WALKSPAN_CLIP_BOUNDS does the same using
+ *	the visible part of the item's area when x is in window
+ *	coordinates. Header items and items with spans > 1 are always
+ *	walked from their first column.
+ *
  * Results:
  *	None.
  *
@@ -4386,6 +4940,8 @@ TreeItem_WalkSpans(
     int lock,			/* Which columns. */
     int x, int y,		/* Drawable coordinates of the item. */
     int width, int height,	/* Total size of the item. */
+    int clipMinX, int clipMaxX,	/* Horizontal clipping range in the same
+				 * coordinates as x. */
     int dragPosition,
     TreeItemWalkSpansProc proc,	/* Callback routine. */
     ClientData clientData	/* Data passed to callback routine. */
@@ -4399,6 +4955,7 @@ TreeItem_WalkSpans(
     int spanCount, spanIndex, columnCount = tree->columnCountVis;
     SpanInfo *spans;
     int area = TREE_AREA_CONTENT;
+    int clipOffset = 0;
 
     switch (lock) {
 	case COLUMN_LOCK_LEFT:
@@ -4444,6 +5001,27 @@ TreeItem_WalkSpans(
     if (!Tree_AreaBbox(tree, area, &drawArgs.bounds)) {
 	TreeRect_SetXYWH(drawArgs.bounds, 0, 0, 0, 0);
     }
+    if (dragPosition & WALKSPAN_CLIP_BOUNDS) {
+	clipMinX = TreeRect_Left(drawArgs.bounds);
+	clipMaxX = TreeRect_Right(drawArgs.bounds);
+	dragPosition |= WALKSPAN_CLIP;
+    }
+
+    /* When every span is 1 each column begins a span, so the walk can
+     * start at the first column in the clipping range. */
+    if ((dragPosition & WALKSPAN_CLIP) && (item->header == NULL) &&
+	    (item->flags & ITEM_FLAG_SPANS_SIMPLE) &&
+	    !((lock == COLUMN_LOCK_NONE) && (tree->columnCountVis == 1))) {
+	int offset = TreeColumn_Offset(treeColumn);
+	TreeColumn first, last;
+
+	if (!Tree_ColumnsInRange(tree, lock, clipMinX - x + offset,
+		clipMaxX - x + offset, &first, &last))
+	    return;
+	clipOffset = TreeColumn_Offset(first) - offset;
+	treeColumn = first;
+	treeColumnLast = last;
+    }
 
     /* Originally, the array of SpanInfo records used by this function was
      * allocated using STATIC_ALLOC.  Not wanting to allocate memory every
@@ -4487,7 +5065,7 @@ TreeItem_WalkSpans(
     drawArgs.item = item; /* needed for gradients */
     drawArgs.td.drawable = None;
 
-    totalWidth = 0;
+    totalWidth = clipOffset;
     if (dragPosition & WALKSPAN_ONLY_DRAGGED) {
 #ifdef TREECTRL_DEBUG
 	if (item->header == NULL) panic("TreeItem_WalkSpans header == NULL");
@@ -4731,14 +5309,14 @@ TreeItem_Draw(
     clientData.dragPosition = FALSE;
 
     TreeItem_WalkSpans(tree, item, lock,
-	    x, y, width, height,
-	    WALKSPAN_DRAG_ORDER,
+	    x, y, width, height, minX, maxX,
+	    WALKSPAN_DRAG_ORDER | WALKSPAN_CLIP,
 	    SpanWalkProc_Draw, (ClientData) &clientData);
 
     if (item->header != NULL) {
 	clientData.dragPosition = TRUE;
 	TreeItem_WalkSpans(tree, item, lock,
-		x, y, width, height,
+		x, y, width, height, 0, 0,
 		WALKSPAN_ONLY_DRAGGED,
 		SpanWalkProc_Draw, (ClientData) &clientData);
     }
@@ -5115,13 +5693,14 @@ TreeItem_UpdateWindowPositions(
     )
 {
     TreeItem_WalkSpans(tree, item, lock,
-	    x, y, width, height,
-	    WALKSPAN_DRAG_ORDER | WALKSPAN_IGNORE_DRAGGED,
+	    x, y, width, height, 0, 0,
+	    WALKSPAN_DRAG_ORDER | WALKSPAN_IGNORE_DRAGGED |
+	    WALKSPAN_CLIP_BOUNDS,
 	    SpanWalkProc_UpdateWindowPositions, (ClientData) NULL);
 
     if (item->header != NULL) {
 	TreeItem_WalkSpans(tree, item, lock,
-		x, y, width, height,
+		x, y, width, height, 0, 0,
 		WALKSPAN_ONLY_DRAGGED,
 		SpanWalkProc_UpdateWindowPositions, (ClientData) NULL);
     }
@@ -5192,13 +5771,13 @@ TreeItem_GetOnScreenColumns(
     )
 {
     TreeItem_WalkSpans(tree, item, lock,
-	x, y, width, height,
-	WALKSPAN_DRAG_ORDER | WALKSPAN_IGNORE_DRAGGED,
+	x, y, width, height, 0, 0,
+	WALKSPAN_DRAG_ORDER | WALKSPAN_IGNORE_DRAGGED | WALKSPAN_CLIP_BOUNDS,
 	SpanWalkProc_GetOnScreenColumns, (ClientData) columns);
 
     if (item->header != NULL) {
 	TreeItem_WalkSpans(tree, item, lock,
-	    x, y, width, height,
+	    x, y, width, height, 0, 0,
 	    WALKSPAN_ONLY_DRAGGED,
 	    SpanWalkProc_GetOnScreenColumns, (ClientData) columns);
     }
@@ -5421,6 +6000,7 @@ Item_Configure(
     int mask;
     int lastVisible = IS_VISIBLE(item);
     int lastWrap = IS_WRAP(item);
+    TagInfo *lastTags = item->tagInfo;
 
     for (error = 0; error <= 1; error++) {
 	if (error == 0) {
@@ -5430,7 +6010,11 @@ Item_Configure(
 		continue;
 	    }
 
-	    /* xxx */
+	    /* The old tags are freed along with the saved options. */
+	    if (mask & ITEM_CONF_TAGS) {
+		Item_IndexTags(tree, item, lastTags, FALSE);
+		Item_IndexTags(tree, item, item->tagInfo, TRUE);
+	    }
 
 	    Tk_FreeSavedOptions(&savedOptions);
 	    break;
@@ -5895,6 +6479,7 @@ ItemCreateCmd(
 	    } else {
 		item->tagInfo = TagInfo_Copy(tree, tagInfo);
 	    }
+	    Item_IndexTags(tree, item, item->tagInfo, TRUE);
 	}
 
 	/* Link the new items together as siblings */
@@ -6263,7 +6848,8 @@ if (co[indexElem].numArgs == -1) panic("indexElem=%d (%s) objc=%d numArgs == -1"
 
 			if (cMask & CS_LAYOUT) {
 			    TreeItemColumn_InvalidateSize(tree, column);
-			    TreeColumns_InvalidateWidthOfItems(tree, treeColumn);
+			    TreeColumns_InvalidateWidthOfItem(tree, item,
+				treeColumn);
 			} else if (cMask & CS_DISPLAY) {
 			    Tree_InvalidateItemDInfo(tree, treeColumn, item, NULL);
 			}
@@ -6621,6 +7207,171 @@ ItemStyleCmd(
     return TreeItemCmd_Style(tree, objc, objv, FALSE);
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * ItemCmd_ImageOrTextMany --
+ *
+ *	This procedure is invoked to process the
+ *	[item image -columns C -items I -values V] and
+ *	[item text -columns C -items I -values V] forms of those widget
+ *	commands. Every column, item and cell style is checked before
+ *	anything is changed, and each item, column and the item ranges
+ *	are invalidated once no matter how many values change. A value
+ *	the element rejects stops the command at that cell.
+ *
+ * Results:
+ *	A standard Tcl result.
+ *
+ * Side effects:
+ *	See the user documentation.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+ItemCmd_ImageOrTextMany(
+    TreeCtrl *tree,		/* Widget info. */
+    int objc,			/* Number of arguments. */
+    Tcl_Obj *CONST objv[],	/* Argument values. */
+    int isImage			/* TRUE if this is [item image] */
+    )
+{
+    Tcl_Interp *interp = tree->interp;
+    static CONST char *optionNames[] = {
+	"-columns", "-items", "-values", (char *) NULL
+    };
+    enum { OPT_COLUMNS, OPT_ITEMS, OPT_VALUES };
+    Tcl_Obj *optionObjs[3] = { NULL, NULL, NULL };
+    Tcl_Obj **colObjv, **itemObjv, **rowObjv, **valueObjv;
+    int colObjc, itemObjc, rowObjc, valueObjc;
+    TreeColumn staticTC[STATIC_SIZE], *treeColumns = staticTC;
+    int staticTouched[STATIC_SIZE], *touched = staticTouched;
+    TreeItemList itemList;
+    TreeItem item;
+    TreeItemColumn column;
+    TreeElement elem;
+    int i, j, index, changed = FALSE, result = TCL_OK;
+
+    if ((objc - 3) & 1) {
+	FormatResult(interp, "missing value for \"%s\" option",
+		Tcl_GetString(objv[objc - 1]));
+	return TCL_ERROR;
+    }
+    for (i = 3; i < objc; i += 2) {
+	if (Tcl_GetIndexFromObj(interp, objv[i], optionNames, "option", 0,
+		&index) != TCL_OK)
+	    return TCL_ERROR;
+	optionObjs[index] = objv[i + 1];
+    }
+    for (i = 0; i < 3; i++) {
+	if (optionObjs[i] == NULL) {
+	    FormatResult(interp, "missing \"%s\" option", optionNames[i]);
+	    return TCL_ERROR;
+	}
+    }
+    if ((Tcl_ListObjGetElements(interp, optionObjs[OPT_COLUMNS], &colObjc,
+	    &colObjv) != TCL_OK) ||
+	    (Tcl_ListObjGetElements(interp, optionObjs[OPT_ITEMS], &itemObjc,
+	    &itemObjv) != TCL_OK) ||
+	    (Tcl_ListObjGetElements(interp, optionObjs[OPT_VALUES], &rowObjc,
+	    &rowObjv) != TCL_OK))
+	return TCL_ERROR;
+    if (rowObjc != itemObjc) {
+	FormatResult(interp, "expected %d rows of values but got %d",
+		itemObjc, rowObjc);
+	return TCL_ERROR;
+    }
+
+    /* Resolve everything before changing anything. */
+    TreeItemList_Init(tree, &itemList, itemObjc);
+    STATIC_ALLOC(treeColumns, TreeColumn, colObjc);
+    STATIC_ALLOC(touched, int, colObjc);
+    for (j = 0; j < colObjc; j++) {
+	if (TreeColumn_FromObj(tree, colObjv[j], &treeColumns[j],
+		CFO_NOT_NULL | CFO_NOT_TAIL) != TCL_OK) {
+	    result = TCL_ERROR;
+	    goto done;
+	}
+	touched[j] = FALSE;
+    }
+    for (i = 0; i < itemObjc; i++) {
+	if (TreeItem_FromObj(tree, itemObjv[i], &item, IFO_NOT_NULL)
+		!= TCL_OK) {
+	    result = TCL_ERROR;
+	    goto done;
+	}
+	if (Tcl_ListObjLength(interp, rowObjv[i], &valueObjc) != TCL_OK) {
+	    result = TCL_ERROR;
+	    goto done;
+	}
+	if (valueObjc != colObjc) {
+	    FormatResult(interp, "expected %d values for item %s but got %d",
+		    colObjc, Tcl_GetString(itemObjv[i]), valueObjc);
+	    result = TCL_ERROR;
+	    goto done;
+	}
+	for (j = 0; j < colObjc; j++) {
+	    int columnIndex = TreeColumn_Index(treeColumns[j]);
+
+	    column = TreeItem_FindColumn(tree, item, columnIndex);
+	    if ((column == NULL) || (column->style == NULL) ||
+		    TreeStyle_IsHeaderStyle(tree, column->style)) {
+		NoStyleMsg(tree, item, columnIndex);
+		result = TCL_ERROR;
+		goto done;
+	    }
+	}
+	TreeItemList_Append(&itemList, item);
+    }
+
+    for (i = 0; i < itemObjc; i++) {
+	int changedI = FALSE;
+
+	item = TreeItemList_Nth(&itemList, i);
+	(void) Tcl_ListObjGetElements(NULL, rowObjv[i], &valueObjc,
+		&valueObjv);
+	for (j = 0; j < colObjc; j++) {
+	    column = TreeItem_FindColumn(tree, item,
+		TreeColumn_Index(treeColumns[j]));
+	    result = isImage ?
+		TreeStyle_SetImage(tree, item, column, column->style,
+		    valueObjv[j], &elem) :
+		TreeStyle_SetText(tree, item, column, column->style,
+		    valueObjv[j], &elem);
+	    if (result != TCL_OK)
+		break;
+	    if (elem != NULL) {
+		TreeItemColumn_InvalidateSize(tree, column);
+		touched[j] = TRUE;
+		changedI = TRUE;
+	    }
+	}
+	if (changedI) {
+	    TreeItem_InvalidateHeight(tree, item);
+	    Tree_FreeItemDInfo(tree, item, NULL);
+	    changed = TRUE;
+	}
+	if (result != TCL_OK)
+	    break;
+    }
+
+    /* Invalidate each column once, even after an error, since some
+     * values may have changed. */
+    for (j = 0; j < colObjc; j++) {
+	if (touched[j])
+	    TreeColumns_InvalidateWidthOfItems(tree, treeColumns[j]);
+    }
+    if (changed)
+	Tree_DInfoChanged(tree, DINFO_REDO_RANGES);
+
+done:
+    STATIC_FREE(treeColumns, TreeColumn, colObjc);
+    STATIC_FREE(touched, int, colObjc);
+    TreeItemList_Free(&itemList);
+    return result;
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -6676,6 +7427,10 @@ TreeItemCmd_ImageOrText(
 	return TCL_ERROR;
     }
 
+    /* T item text -columns C -items I -values V */
+    if (!doHeaders && (Tcl_GetString(objv[3])[0] == '-'))
+	return ItemCmd_ImageOrTextMany(tree, objc, objv, isImage);
+
     if (objc < 6)
 	flags = IFO_NOT_NULL | IFO_NOT_MANY;
     if (doHeaders) {
@@ -6783,7 +7538,7 @@ TreeItemCmd_ImageOrText(
 		    }
 		} else {
 		    TreeItemColumn_InvalidateSize(tree, column);
-		    TreeColumns_InvalidateWidthOfItems(tree, treeColumn);
+		    TreeColumns_InvalidateWidthOfItem(tree, item, treeColumn);
 		    changedI = TRUE;
 		}
 	    }
@@ -7755,6 +8510,7 @@ ItemSortCmd(
     }
 
     tree->updateIndex = 1;
+    tree->itemGeneration++;
     Tree_DInfoChanged(tree, DINFO_REDO_RANGES);
 
     done:
@@ -8067,6 +8823,7 @@ TreeItemCmd_State(
 	    }
 	    domainPtr->stateNames[slot] = ckalloc(length + 1);
 	    strcpy(domainPtr->stateNames[slot], string);
+	    TreeItem_InvalidateDescriptions(tree);
 	    break;
 	}
 
@@ -8297,6 +9054,7 @@ doneSET:
 		ckfree(domainPtr->stateNames[index]);
 		domainPtr->stateNames[index] = NULL;
 	    }
+	    TreeItem_InvalidateDescriptions(tree);
 	    break;
 	}
     }
@@ -8398,6 +9156,9 @@ TreeItemCmd_Tag(
 	    }
 	    ITEM_FOR_EACH(item, &items, NULL, &iter) {
 		item->tagInfo = TagInfo_Add(tree, item->tagInfo, tags, numTags);
+		if (!doHeaders)
+		    TagIndex_Add(&tree->itemTagHash, (ClientData) item, tags,
+			numTags);
 	    }
 	    STATIC_FREE(tags, Tk_Uid, numTags);
 	    break;
@@ -8501,6 +9262,9 @@ TreeItemCmd_Tag(
 	    }
 	    ITEM_FOR_EACH(item, &items, NULL, &iter) {
 		item->tagInfo = TagInfo_Remove(tree, item->tagInfo, tags, numTags);
+		if (!doHeaders)
+		    TagIndex_Remove(&tree->itemTagHash, (ClientData) item, tags,
+			numTags);
 	    }
 	    STATIC_FREE(tags, Tk_Uid, numTags);
 	    break;
@@ -8577,9 +9341,7 @@ Tree_DeselectHidden(
     TreeCtrl *tree		/* Widget info. */
     )
 {
-    TreeItemList items;
-    Tcl_HashEntry *hPtr;
-    Tcl_HashSearch search;
+    TreeItemList selected, items;
     TreeItem item;
     int i;
 
@@ -8589,15 +9351,17 @@ Tree_DeselectHidden(
     /* This call is slow for large lists. */
     Tree_UpdateItemIndex(tree);
 
-    TreeItemList_Init(tree, &items, tree->selectCount);
+    TreeItemList_Init(tree, &selected, tree->selectCount);
+    Tree_GetSelection(tree, &selected);
 
-    hPtr = Tcl_FirstHashEntry(&tree->selection, &search);
-    while (hPtr != NULL) {
-	item = (TreeItem) Tcl_GetHashKey(&tree->selection, hPtr);
+    TreeItemList_Init(tree, &items, 0);
+    for (i = 0; i < TreeItemList_Count(&selected); i++) {
+	item = TreeItemList_Nth(&selected, i);
 	if (!TreeItem_ReallyVisible(tree, item))
 	    TreeItemList_Append(&items, item);
-	hPtr = Tcl_NextHashEntry(&search);
     }
+    TreeItemList_Free(&selected);
+
     for (i = 0; i < TreeItemList_Count(&items); i++)
 	Tree_RemoveFromSelection(tree, TreeItemList_Nth(&items, i));
     if (TreeItemList_Count(&items)) {
@@ -8608,6 +9372,112 @@ Tree_DeselectHidden(
 
 #endif /* SELECTION_VISIBLE */
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * ItemForeachCmd --
+ *
+ *	This procedure is invoked to process the [item foreach] widget
+ *	command.  See the user documentation for details on what
+ *	it does.
+ *
+ *	"all" and ranges of items are visited one at a time without
+ *	building a list of items first.
+ *
+ * Results:
+ *	A standard Tcl result.
+ *
+ * Side effects:
+ *	See the user documentation.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+ItemForeachCmd(
+    ClientData clientData,	/* Widget info. */
+    Tcl_Interp *interp,		/* Current interpreter. */
+    int objc,			/* Number of arguments. */
+    Tcl_Obj *CONST objv[]	/* Argument values. */
+    )
+{
+    TreeCtrl *tree = clientData;
+    Tcl_Obj *varNameObj, *scriptObj;
+    TreeItemList items, item2s;
+    TreeItem item;
+    ItemForEach iter;
+    int generation, result = TCL_OK;
+
+    if (objc < 6 || objc > 7) {
+	Tcl_WrongNumArgs(interp, 3, objv, "varName first ?last? script");
+	return TCL_ERROR;
+    }
+    varNameObj = objv[3];
+    scriptObj = objv[objc - 1];
+
+    if (objc == 7) {
+	if (TreeItemList_FromObj(tree, objv[4], &items,
+		IFO_NOT_MANY | IFO_NOT_NULL) != TCL_OK)
+	    return TCL_ERROR;
+	if (TreeItemList_FromObj(tree, objv[5], &item2s,
+		IFO_NOT_MANY | IFO_NOT_NULL) != TCL_OK) {
+	    TreeItemList_Free(&items);
+	    return TCL_ERROR;
+	}
+    } else {
+	if (TreeItemList_FromObj(tree, objv[4], &items, 0) != TCL_OK)
+	    return TCL_ERROR;
+	TreeItemList_Init(tree, &item2s, 0);
+    }
+
+    /* Nothing to do. */
+    if (TreeItemList_Count(&items) == 0)
+	goto done;
+
+    /* The script may change the items. The list of items or the position
+     * in a range can't be trusted after that, so stop with an error. */
+    generation = tree->itemGeneration;
+
+    Tcl_IncrRefCount(scriptObj);
+    ITEM_FOR_EACH(item, &items, objc == 7 ? &item2s : NULL, &iter) {
+	if (Tcl_ObjSetVar2(interp, varNameObj, NULL,
+		TreeItem_ToObj(tree, item), TCL_LEAVE_ERR_MSG) == NULL) {
+	    result = TCL_ERROR;
+	    break;
+	}
+	result = Tcl_EvalObjEx(interp, scriptObj, 0);
+	if (result == TCL_CONTINUE) {
+	    result = TCL_OK;
+	} else if (result == TCL_BREAK) {
+	    result = TCL_OK;
+	    break;
+	} else if (result == TCL_ERROR) {
+	    Tcl_AddErrorInfo(interp, "\n    (\"item foreach\" script)");
+	    break;
+	} else if (result != TCL_OK) {
+	    break;
+	}
+	if (tree->deleted)
+	    break;
+	if (tree->itemGeneration != generation) {
+	    FormatResult(interp,
+		"items were created, deleted or moved during \"item foreach\"");
+	    result = TCL_ERROR;
+	    break;
+	}
+    }
+    Tcl_DecrRefCount(scriptObj);
+    if (iter.error)
+	result = TCL_ERROR;
+    if (result == TCL_OK)
+	Tcl_ResetResult(interp);
+
+done:
+    TreeItemList_Free(&items);
+    TreeItemList_Free(&item2s);
+    return result;
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -8656,6 +9526,7 @@ TreeItemCmd(
 	COMMAND_ENABLED,
 	COMMAND_EXPAND,
 	COMMAND_FIRSTCHILD,
+	COMMAND_FOREACH,
 	COMMAND_ID,
 	COMMAND_IMAGE,
 	COMMAND_ISANCESTOR,
@@ -8733,6 +9604,7 @@ TreeItemCmd(
 		IFO_NOT_MANY | IFO_NOT_NULL | IFO_NOT_ROOT | AF_NOT_ANCESTOR |
 		AF_NOT_EQUAL | AF_NOT_DELETED, 0, "item ?newFirstChild?",
 		NULL },
+	{ "foreach", 0, 0, 0, 0, 0, NULL, ItemForeachCmd },
 	{ "id", 1, 1, 0, 0, 0, "item", NULL },
 	{ "image", 0, 0, 0, 0, 0, NULL, ItemImageCmd },
 	{ "isancestor", 2, 2, IFO_NOT_MANY | IFO_NOT_NULL, IFO_NOT_MANY |
@@ -9820,7 +10692,7 @@ TreeItem_Identify(
     clientData.elemPtr = elemPtr;
 
     TreeItem_WalkSpans(tree, item, lock,
-	    0, 0, TreeRect_Width(tr), TreeRect_Height(tr),
+	    0, 0, TreeRect_Width(tr), TreeRect_Height(tr), 0, 0,
 	    WALKSPAN_IGNORE_DND,
 	    SpanWalkProc_Identify, (ClientData) &clientData);
 }
@@ -9921,7 +10793,7 @@ TreeItem_Identify2(
 
     TreeItem_WalkSpans(tree, item, COLUMN_LOCK_NONE,
 	    TreeRect_Left(tr), TreeRect_Top(tr),
-	    TreeRect_Width(tr), TreeRect_Height(tr),
+	    TreeRect_Width(tr), TreeRect_Height(tr), 0, 0,
 	    WALKSPAN_IGNORE_DND,
 	    SpanWalkProc_Identify2, (ClientData) &clientData);
 }
@@ -10068,7 +10940,7 @@ TreeItem_GetRects(
 
     TreeItem_WalkSpans(tree, item, lock,
 	    TreeRect_Left(tr), TreeRect_Top(tr),
-	    TreeRect_Width(tr), TreeRect_Height(tr),
+	    TreeRect_Width(tr), TreeRect_Height(tr), 0, 0,
 	    WALKSPAN_IGNORE_DND,
 	    SpanWalkProc_GetRects, (ClientData) &clientData);
 
@@ -10402,6 +11274,9 @@ TreeItem_InitWidget(
 
     tree->itemOptionTable = Tk_CreateOptionTable(tree->interp, itemOptionSpecs);
 
+    TagIndex_Init(&tree->itemTagHash);
+    TreeItem_InvalidateDescriptions(tree);
+
     tree->root = Item_AllocRoot(tree);
     tree->activeItem = tree->root; /* always non-null */
     tree->anchorItem = tree->root; /* always non-null */
@@ -10441,4 +11316,6 @@ TreeItem_FreeWidget(
 	ckfree((char *) siStack);
 	siStack = next;
     }
+
+    TagIndex_Free(&tree->itemTagHash);
 }
@@ -94,6 +94,43 @@ ExpandItemList(
     }
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * ExpandIdSet --
+ *
+ *	Append a set of item IDs to a dynamic string.
+ *
+ * Results:
+ *	DString gets longer.
+ *
+ * Side effects:
+ *	Memory may be allocated.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+ExpandIdSet(
+    TreeCtrl *tree,		/* Widget info. */
+    TreeIdSet *set,		/* set of item IDs */
+    Tcl_DString *result		/* Gets appended. Caller must initialize. */
+    )
+{
+    int id;
+    char buf[10 + TCL_INTEGER_SPACE];
+
+    Tcl_DStringStartSublist(result);
+    for (id = TreeIdSet_Next(set, 0);
+	    id != -1;
+	    id = TreeIdSet_Next(set, id + 1)) {
+	(void) sprintf(buf, "%s%d",
+		(tree->itemPrefixLen ? tree->itemPrefix : ""), id);
+	Tcl_DStringAppendElement(result, buf);
+    }
+    Tcl_DStringEndSublist(result);
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -305,9 +342,13 @@ Percents_Selection(
 	TreeCtrl *tree; /* Must be first. See Percents_Any(). */
 	TreeItemList *select;
 	TreeItemList *deselect;
+	TreeIdSet *selectIds;	/* Used instead of select and deselect */
+	TreeIdSet *deselectIds;	/* when changes were coalesced. */
 	int count;
     } *data = args->clientData;
     TreeItemList *itemList;
+    TreeIdSet *idSet;
+    int count;
 
     switch (args->which) {
 	case 'c':
@@ -316,12 +357,29 @@ Percents_Selection(
 
 	case 'D':
 	case 'S':
+	    if (data->selectIds != NULL) {
+		idSet = (args->which == 'D') ? data->deselectIds : data->selectIds;
+		ExpandIdSet(data->tree, idSet, args->result);
+		break;
+	    }
 	    itemList = (args->which == 'D') ? data->deselect : data->select;
 	    ExpandItemList(data->tree, itemList, args->result);
 	    break;
 
+	case 's':
+	case 'u':
+	    if (data->selectIds != NULL) {
+		idSet = (args->which == 'u') ? data->deselectIds : data->selectIds;
+		count = TreeIdSet_Count(idSet);
+	    } else {
+		itemList = (args->which == 'u') ? data->deselect : data->select;
+		count = (itemList != NULL) ? TreeItemList_Count(itemList) : 0;
+	    }
+	    QE_ExpandNumber(count, args->result);
+	    break;
+
 	default:
-	    Percents_Any(args, Percents_Selection, "cSD");
+	    Percents_Any(args, Percents_Selection, "cSDsu");
 	    break;
     }
 }
@@ -542,9 +600,6 @@ TreeNotify_OpenClose(
 	int id;
     } data;
 
-    data.tree = tree;
-    data.id = TreeItem_GetID(tree, item);
-
     if (state & STATE_ITEM_OPEN) {
 	event.type = EVENT_EXPAND;
 	event.detail = before ? DETAIL_EXPAND_BEFORE : DETAIL_EXPAND_AFTER;
@@ -552,6 +607,12 @@ TreeNotify_OpenClose(
 	event.type = EVENT_COLLAPSE;
 	event.detail = before ? DETAIL_COLLAPSE_BEFORE : DETAIL_COLLAPSE_AFTER;
     }
+    if (!QE_IsBound(tree->bindingTable, event.type, event.detail))
+	return;
+
+    data.tree = tree;
+    data.id = TreeItem_GetID(tree, item);
+
     event.clientData = (ClientData) &data;
     (void) QE_BindEvent(tree->bindingTable, &event);
 }
@@ -559,9 +620,10 @@ TreeNotify_OpenClose(
 /*
  *----------------------------------------------------------------------
  *
- * TreeNotify_Selection --
+ * GenerateSelection --
  *
- *	Generate a <Selection> event.
+ *	Generate a <Selection> event. The changes are given either as
+ *	lists of items or, when they were coalesced, as sets of item IDs.
  *
  * Results:
  *	Any scripts bound to the event are evaluated.
@@ -572,11 +634,13 @@ TreeNotify_OpenClose(
  *----------------------------------------------------------------------
  */
 
-void
-TreeNotify_Selection(
+static void
+GenerateSelection(
     TreeCtrl *tree,		/* Widget info. */
     TreeItemList *select,	/* List of items or NULL. */
-    TreeItemList *deselect	/* List of items or NULL. */
+    TreeItemList *deselect,	/* List of items or NULL. */
+    TreeIdSet *selectIds,	/* Set of item IDs or NULL. */
+    TreeIdSet *deselectIds	/* Set of item IDs or NULL. */
     )
 {
     QE_Event event;
@@ -584,12 +648,16 @@ TreeNotify_Selection(
 	TreeCtrl *tree; /* Must be first. See Percents_Any(). */
 	TreeItemList *select;
 	TreeItemList *deselect;
+	TreeIdSet *selectIds;
+	TreeIdSet *deselectIds;
 	int count;
     } data;
 
     data.tree = tree;
     data.select = select;
     data.deselect = deselect;
+    data.selectIds = selectIds;
+    data.deselectIds = deselectIds;
     data.count = tree->selectCount;
 
     event.type = EVENT_SELECTION;
@@ -599,6 +667,107 @@ TreeNotify_Selection(
     (void) QE_BindEvent(tree->bindingTable, &event);
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * SelectionIdleProc --
+ *
+ *	Generate a single <Selection> event for all the selection changes
+ *	coalesced since the last time this procedure was called.
+ *
+ * Results:
+ *	Any scripts bound to the event are evaluated.
+ *
+ * Side effects:
+ *	Whatever binding scripts do.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+SelectionIdleProc(
+    ClientData clientData	/* Widget info. */
+    )
+{
+    TreeCtrl *tree = clientData;
+    TreeIdSet select, deselect;
+
+    /* Take the pending changes so that any selection changes made by
+     * binding scripts start a new batch. */
+    select = tree->selectPending;
+    deselect = tree->deselectPending;
+    TreeIdSet_Init(&tree->selectPending);
+    TreeIdSet_Init(&tree->deselectPending);
+    tree->selectNotifyPending = FALSE;
+
+    if (!tree->deleted &&
+	    (TreeIdSet_Count(&select) || TreeIdSet_Count(&deselect))) {
+	Tcl_Preserve((ClientData) tree);
+	GenerateSelection(tree, NULL, NULL, &select, &deselect);
+	Tcl_Release((ClientData) tree);
+    }
+
+    TreeIdSet_Free(&select);
+    TreeIdSet_Free(&deselect);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TreeNotify_Selection --
+ *
+ *	Generate a <Selection> event. If -coalesceselection is true, the
+ *	changes are merged with any other changes made since the last
+ *	<Selection> event and reported when the application is idle.
+ *
+ * Results:
+ *	Any scripts bound to the event are evaluated.
+ *
+ * Side effects:
+ *	Whatever binding scripts do. An idle handler may be scheduled.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+TreeNotify_Selection(
+    TreeCtrl *tree,		/* Widget info. */
+    TreeItemList *select,	/* List of items or NULL. */
+    TreeItemList *deselect	/* List of items or NULL. */
+    )
+{
+    int i, id;
+
+    if (!QE_IsBound(tree->bindingTable, EVENT_SELECTION, 0))
+	return;
+
+    if (!tree->coalesceSelection) {
+	GenerateSelection(tree, select, deselect, NULL, NULL);
+	return;
+    }
+
+    /* An item that is selected then deselected, or the other way
+     * around, before the event is generated isn't reported. */
+    if (select != NULL) {
+	for (i = 0; i < TreeItemList_Count(select); i++) {
+	    id = TreeItem_GetID(tree, TreeItemList_Nth(select, i));
+	    if (!TreeIdSet_Remove(&tree->deselectPending, id))
+		TreeIdSet_Add(&tree->selectPending, id);
+	}
+    }
+    if (deselect != NULL) {
+	for (i = 0; i < TreeItemList_Count(deselect); i++) {
+	    id = TreeItem_GetID(tree, TreeItemList_Nth(deselect, i));
+	    if (!TreeIdSet_Remove(&tree->selectPending, id))
+		TreeIdSet_Add(&tree->deselectPending, id);
+	}
+    }
+    if (!tree->selectNotifyPending) {
+	Tcl_DoWhenIdle(SelectionIdleProc, (ClientData) tree);
+	tree->selectNotifyPending = TRUE;
+    }
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -629,6 +798,9 @@ TreeNotify_ActiveItem(
 	int current;
     } data;
 
+    if (!QE_IsBound(tree->bindingTable, EVENT_ACTIVEITEM, 0))
+	return;
+
     data.tree = tree;
     data.prev = TreeItem_GetID(tree, itemPrev);
     data.current = TreeItem_GetID(tree, itemCur);
@@ -643,7 +815,7 @@ TreeNotify_ActiveItem(
 /*
  *----------------------------------------------------------------------
  *
- * TreeNotify_Scroll --
+ * GenerateScroll --
  *
  *	Generate a <Scroll> event.
  *
@@ -656,8 +828,8 @@ TreeNotify_ActiveItem(
  *----------------------------------------------------------------------
  */
 
-void
-TreeNotify_Scroll(
+static void
+GenerateScroll(
     TreeCtrl *tree,		/* Widget info. */
     double fractions[2],	/* Fractions suitable for a scrollbar's
 				 * [set] command. */
@@ -683,6 +855,87 @@ TreeNotify_Scroll(
     (void) QE_BindEvent(tree->bindingTable, &event);
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * ScrollFlushProc --
+ *
+ *	Generate the <Scroll-x> and <Scroll-y> events that were deferred
+ *	because of the -coalesce or -maxrate option of <Scroll>. Only the
+ *	most recent fractions are reported.
+ *
+ * Results:
+ *	Any scripts bound to the event are evaluated.
+ *
+ * Side effects:
+ *	Whatever binding scripts do.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+ScrollFlushProc(
+    ClientData clientData	/* Widget info. */
+    )
+{
+    TreeCtrl *tree = clientData;
+    double fractions[4];
+    int mask = tree->scrollPendingMask;
+
+    memcpy(fractions, tree->scrollPending, sizeof(fractions));
+    tree->scrollPendingMask = 0;
+
+    if (tree->deleted)
+	return;
+    Tcl_Preserve((ClientData) tree);
+    if (mask & 1)
+	GenerateScroll(tree, fractions, FALSE);
+    if ((mask & 2) && !tree->deleted)
+	GenerateScroll(tree, fractions + 2, TRUE);
+    Tcl_Release((ClientData) tree);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TreeNotify_Scroll --
+ *
+ *	Generate a <Scroll> event, or save the fractions for later if
+ *	the event is being deferred.
+ *
+ * Results:
+ *	Any scripts bound to the event are evaluated.
+ *
+ * Side effects:
+ *	Whatever binding scripts do. A call to ScrollFlushProc may be
+ *	scheduled.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+TreeNotify_Scroll(
+    TreeCtrl *tree,		/* Widget info. */
+    double fractions[2],	/* Fractions suitable for a scrollbar's
+				 * [set] command. */
+    int vertical		/* TRUE for <Scroll-y>, FALSE for
+				 * <Scroll-x>. */
+    )
+{
+    if (!QE_IsBound(tree->bindingTable, EVENT_SCROLL,
+	    vertical ? DETAIL_SCROLL_Y : DETAIL_SCROLL_X))
+	return;
+
+    if (QE_DeferEvent(tree->bindingTable, EVENT_SCROLL)) {
+	tree->scrollPending[vertical * 2] = fractions[0];
+	tree->scrollPending[vertical * 2 + 1] = fractions[1];
+	tree->scrollPendingMask |= vertical ? 2 : 1;
+	return;
+    }
+
+    GenerateScroll(tree, fractions, vertical);
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -748,6 +1001,9 @@ TreeNotify_ItemDeleted(
 	TreeItemList *items;
     } data;
 
+    if (!QE_IsBound(tree->bindingTable, EVENT_ITEM_DELETE, 0))
+	return;
+
     data.tree = tree;
     data.items = items;
 
@@ -761,7 +1017,7 @@ TreeNotify_ItemDeleted(
 /*
  *----------------------------------------------------------------------
  *
- * TreeNotify_ItemVisibility --
+ * GenerateItemVisibility --
  *
  *	Generate an <ItemVisibility> event.
  *
@@ -774,8 +1030,8 @@ TreeNotify_ItemDeleted(
  *----------------------------------------------------------------------
  */
 
-void
-TreeNotify_ItemVisibility(
+static void
+GenerateItemVisibility(
     TreeCtrl *tree,		/* Widget info. */
     TreeItemList *v,		/* List of newly-visible items. */
     TreeItemList *h		/* List of newly-hidden items. */
@@ -799,6 +1055,140 @@ TreeNotify_ItemVisibility(
     (void) QE_BindEvent(tree->bindingTable, &event);
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * IdSetToItemList --
+ *
+ *	Append the items whose IDs are in a set to a list. IDs of items
+ *	that have been deleted are skipped.
+ *
+ * Results:
+ *	The list gets longer.
+ *
+ * Side effects:
+ *	Memory may be allocated.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+IdSetToItemList(
+    TreeCtrl *tree,		/* Widget info. */
+    TreeIdSet *set,		/* Set of item IDs. */
+    TreeItemList *items		/* Initialized list to append to. */
+    )
+{
+    Tcl_HashEntry *hPtr;
+    int id;
+
+    for (id = TreeIdSet_Next(set, 0);
+	    id != -1;
+	    id = TreeIdSet_Next(set, id + 1)) {
+	hPtr = Tcl_FindHashEntry(&tree->itemHash, (char *) INT2PTR(id));
+	if (hPtr != NULL)
+	    TreeItemList_Append(items, (TreeItem) Tcl_GetHashValue(hPtr));
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ItemVisibilityFlushProc --
+ *
+ *	Generate a single <ItemVisibility> event for all the changes in
+ *	item visibility that were deferred because of the -coalesce or
+ *	-maxrate option of <ItemVisibility>.
+ *
+ * Results:
+ *	Any scripts bound to the event are evaluated.
+ *
+ * Side effects:
+ *	Whatever binding scripts do.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+ItemVisibilityFlushProc(
+    ClientData clientData	/* Widget info. */
+    )
+{
+    TreeCtrl *tree = clientData;
+    TreeItemList v, h;
+
+    if (!tree->deleted) {
+	TreeItemList_Init(tree, &v, 0);
+	TreeItemList_Init(tree, &h, 0);
+	IdSetToItemList(tree, &tree->visiblePending, &v);
+	IdSetToItemList(tree, &tree->hiddenPending, &h);
+    }
+
+    /* Changes made by binding scripts start a new batch. */
+    TreeIdSet_Free(&tree->visiblePending);
+    TreeIdSet_Free(&tree->hiddenPending);
+
+    if (tree->deleted)
+	return;
+
+    if (TreeItemList_Count(&v) || TreeItemList_Count(&h)) {
+	Tcl_Preserve((ClientData) tree);
+	GenerateItemVisibility(tree, &v, &h);
+	Tcl_Release((ClientData) tree);
+    }
+    TreeItemList_Free(&v);
+    TreeItemList_Free(&h);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TreeNotify_ItemVisibility --
+ *
+ *	Generate an <ItemVisibility> event, or remember the changes for
+ *	later if the event is being deferred. An item that becomes
+ *	visible then hidden again, or the other way around, before a
+ *	deferred event is generated isn't reported.
+ *
+ * Results:
+ *	Any scripts bound to the event are evaluated.
+ *
+ * Side effects:
+ *	Whatever binding scripts do. A call to ItemVisibilityFlushProc
+ *	may be scheduled.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+TreeNotify_ItemVisibility(
+    TreeCtrl *tree,		/* Widget info. */
+    TreeItemList *v,		/* List of newly-visible items. */
+    TreeItemList *h		/* List of newly-hidden items. */
+    )
+{
+    int i, id;
+
+    if (!QE_IsBound(tree->bindingTable, EVENT_ITEM_VISIBILITY, 0))
+	return;
+
+    if (!QE_DeferEvent(tree->bindingTable, EVENT_ITEM_VISIBILITY)) {
+	GenerateItemVisibility(tree, v, h);
+	return;
+    }
+
+    for (i = 0; i < TreeItemList_Count(v); i++) {
+	id = TreeItem_GetID(tree, TreeItemList_Nth(v, i));
+	if (!TreeIdSet_Remove(&tree->hiddenPending, id))
+	    TreeIdSet_Add(&tree->visiblePending, id);
+    }
+    for (i = 0; i < TreeItemList_Count(h); i++) {
+	id = TreeItem_GetID(tree, TreeItemList_Nth(h, i));
+	if (!TreeIdSet_Remove(&tree->visiblePending, id))
+	    TreeIdSet_Add(&tree->hiddenPending, id);
+    }
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -843,6 +1233,42 @@ TreeNotify_InitWidget(
 
     EVENT_ITEM_VISIBILITY = QE_InstallEvent(tree->bindingTable, "ItemVisibility", Percents_ItemVisibility);
 
+    /* These events may be coalesced or rate-limited by [notify configure]. */
+    (void) QE_SetFlushProc(tree->bindingTable, EVENT_SCROLL,
+	    ScrollFlushProc, (ClientData) tree);
+    (void) QE_SetFlushProc(tree->bindingTable, EVENT_ITEM_VISIBILITY,
+	    ItemVisibilityFlushProc, (ClientData) tree);
+
     return TCL_OK;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * TreeNotify_FreeWidget --
+ *
+ *	Free event-related resources for a deleted TreeCtrl.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Memory is freed. Pending <Selection> and <ItemVisibility>
+ *	events are discarded.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+TreeNotify_FreeWidget(
+    TreeCtrl *tree		/* Widget info. */
+    )
+{
+    if (tree->selectNotifyPending)
+	Tcl_CancelIdleCall(SelectionIdleProc, (ClientData) tree);
+    TreeIdSet_Free(&tree->selectPending);
+    TreeIdSet_Free(&tree->deselectPending);
+    TreeIdSet_Free(&tree->visiblePending);
+    TreeIdSet_Free(&tree->hiddenPending);
+}
+
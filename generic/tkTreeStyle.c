@@ -25,6 +25,7 @@ typedef struct MStyle MStyle;
 typedef struct IStyle IStyle;
 typedef struct MElementLink MElementLink;
 typedef struct IElementLink IElementLink;
+typedef struct LayoutCache LayoutCache;
 
 /*
  * A data structure of the following type is kept for each master style.
@@ -46,6 +47,10 @@ struct MStyle
     int hasHeaderElem;		/* Hackish flag to remember if the style has
 				 * any elements of type 'header'.  Headers
 				 * are a fixed height on Aqua. */
+#ifdef CACHE_ELEM_SIZE
+    Tcl_HashTable *layoutTemplates; /* Layouts shared by instance styles,
+				 * see Style_DoLayoutCached(), or NULL. */
+#endif
 };
 
 /*
@@ -67,6 +72,8 @@ struct IStyle
     int layoutWidth;
     int layoutHeight;
 #endif
+    LayoutCache *layoutCache;	/* Layout from the last time the style was
+				 * drawn, or NULL. */
 };
 
 #define ELF_eEXPAND_W 0x0001 /* expand Layout.ePadX[0] */
@@ -164,7 +171,8 @@ static Tk_OptionSpec styleOptionSpecs[] = {
 
 /*
  * The following structure is used to hold layout information about a
- * single element. This information is not cached anywhere.
+ * single element. The layout of a style is only cached while the style
+ * is onscreen, see LayoutCache.
  */
 struct Layout
 {
@@ -207,6 +215,36 @@ struct Layout
 
 #define IS_HIDDEN(L) ((L)->visible == 0)
 
+/*
+ * The following structure holds the layout of every element in an
+ * instance style for the arguments it was calculated with. One is kept
+ * for each instance style that was drawn and is still onscreen, so that
+ * redrawing, hit-testing and [item bbox] don't repeat the layout.
+ */
+struct LayoutCache
+{
+    int width;			/* StyleDrawArgs fields the layout */
+    int height;			/* depends on. */
+    int indent;
+    int justify;
+    int state;
+    struct Layout layouts[1];	/* One per element. Variable length. */
+};
+
+#ifdef CACHE_ELEM_SIZE
+/*
+ * Instance styles of the same master style usually have the same layout
+ * when they are displayed at the same size, in the same state, and their
+ * elements need the same size. A master style keeps such layouts in a
+ * hash table keyed on an array of LAYOUT_KEY_WORDS() ints: the
+ * LayoutCache fields followed by the needed width and height of each
+ * element. The table is emptied when it holds LAYOUT_TEMPLATE_MAX
+ * layouts.
+ */
+#define LAYOUT_KEY_WORDS(n) (5 + (n) * 2)
+#define LAYOUT_TEMPLATE_MAX 64
+#endif
+
 /*
  *----------------------------------------------------------------------
  *
@@ -2480,6 +2518,237 @@ Style_DoLayout(
     }
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * IStyle_ForgetLayout --
+ *
+ *	Free the cached layout of an instance style, if any.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Memory may be freed.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+IStyle_ForgetLayout(
+    IStyle *style		/* Instance style. */
+    )
+{
+    if (style->layoutCache != NULL) {
+	ckfree((char *) style->layoutCache);
+	style->layoutCache = NULL;
+    }
+}
+
+#ifdef CACHE_ELEM_SIZE
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * MStyle_ForgetLayouts --
+ *
+ *	Free the layout templates of a master style, if any. This must be
+ *	called whenever the layout options or the list of elements of the
+ *	master style change.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Memory may be freed.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+MStyle_ForgetLayouts(
+    MStyle *masterStyle		/* Master style. */
+    )
+{
+    Tcl_HashTable *tablePtr = masterStyle->layoutTemplates;
+    Tcl_HashEntry *hPtr;
+    Tcl_HashSearch search;
+
+    if (tablePtr == NULL)
+	return;
+    hPtr = Tcl_FirstHashEntry(tablePtr, &search);
+    while (hPtr != NULL) {
+	ckfree((char *) Tcl_GetHashValue(hPtr));
+	hPtr = Tcl_NextHashEntry(&search);
+    }
+    Tcl_DeleteHashTable(tablePtr);
+    ckfree((char *) tablePtr);
+    masterStyle->layoutTemplates = NULL;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * Layout_IsShareable --
+ *
+ *	Determine whether a layout calculated by Style_DoLayout() may be
+ *	used by other instances of the same master style. This is not
+ *	the case when an element with a heightProc was squeezed, since
+ *	its height then depends on the content of the element and not
+ *	only on its needed size.
+ *
+ * Results:
+ *	TRUE if the layout may be shared.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+Layout_IsShareable(
+    IStyle *style,		/* Instance style. */
+    struct Layout layouts[]	/* Result of Style_DoLayout(). */
+    )
+{
+    int i;
+
+    for (i = 0; i < style->master->numElements; i++) {
+	struct Layout *layout = &layouts[i];
+	IElementLink *eLink2 = layout->eLink;
+
+	if (IS_HIDDEN(layout) || IS_UNION(layout->master))
+	    continue;
+	if (eLink2->elem->typePtr->heightProc == NULL)
+	    continue;
+	if (layout->master->fixedHeight >= 0)
+	    continue;
+	if (layout->useWidth < eLink2->neededWidth)
+	    return FALSE;
+    }
+    return TRUE;
+}
+
+#endif /* CACHE_ELEM_SIZE */
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * Style_DoLayoutCached --
+ *
+ *	Same as Style_DoLayout() with neededV=FALSE, but the style's cached
+ *	layout is used if it was calculated with the same arguments.
+ *	Style_CheckNeededSize() must be called first; it discards the
+ *	cached layout whenever the size of the style is recalculated.
+ *	Otherwise a layout calculated for another instance of the same
+ *	master style is copied if its elements needed the same sizes.
+ *
+ * Results:
+ *	layouts[] is updated.
+ *
+ * Side effects:
+ *	If 'remember' is TRUE, the layout is cached until the style is
+ *	changed or goes offscreen. The layout may be added to the
+ *	master style's templates. Memory may be allocated.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+Style_DoLayoutCached(
+    StyleDrawArgs *drawArgs,	/* Various args. */
+    struct Layout layouts[],	/* Uninitialized records to be filled in. */
+    int remember,		/* TRUE to cache the layout. */
+    char *file,			/* debug */
+    int line			/* debug */
+    )
+{
+    IStyle *style = (IStyle *) drawArgs->style;
+    LayoutCache *cache = style->layoutCache;
+    int numElements = style->master->numElements;
+    int size = sizeof(struct Layout) * numElements;
+#ifdef CACHE_ELEM_SIZE
+    MStyle *masterStyle = style->master;
+    Tcl_HashTable *tablePtr;
+    Tcl_HashEntry *hPtr = NULL;
+    int staticKey[STATIC_SIZE], *key = staticKey;
+    int i, isNew, keyWords = LAYOUT_KEY_WORDS(numElements);
+    int shared = (numElements > 0) && !masterStyle->hasHeaderElem;
+#endif
+
+    if ((cache != NULL) &&
+	    (cache->width == drawArgs->width) &&
+	    (cache->height == drawArgs->height) &&
+	    (cache->indent == drawArgs->indent) &&
+	    (cache->justify == (int) drawArgs->justify) &&
+	    (cache->state == drawArgs->state)) {
+	memcpy(layouts, cache->layouts, size);
+	return;
+    }
+
+#ifdef CACHE_ELEM_SIZE
+    /* Header elements have content margins that depend on more than
+     * their needed size, so those styles don't share layouts. */
+    if (shared) {
+	STATIC_ALLOC(key, int, keyWords);
+	key[0] = drawArgs->width;
+	key[1] = drawArgs->height;
+	key[2] = drawArgs->indent;
+	key[3] = (int) drawArgs->justify;
+	key[4] = drawArgs->state;
+	for (i = 0; i < numElements; i++) {
+	    key[5 + i * 2] = style->elements[i].neededWidth;
+	    key[6 + i * 2] = style->elements[i].neededHeight;
+	}
+	if (masterStyle->layoutTemplates != NULL)
+	    hPtr = Tcl_FindHashEntry(masterStyle->layoutTemplates,
+		    (char *) key);
+    }
+    if (hPtr != NULL) {
+	memcpy(layouts, Tcl_GetHashValue(hPtr), size);
+	for (i = 0; i < numElements; i++)
+	    layouts[i].eLink = &style->elements[i];
+    } else {
+	Style_DoLayout(drawArgs, layouts, FALSE, file, line);
+	if (shared && Layout_IsShareable(style, layouts)) {
+	    tablePtr = masterStyle->layoutTemplates;
+	    if ((tablePtr != NULL) &&
+		    (tablePtr->numEntries >= LAYOUT_TEMPLATE_MAX)) {
+		MStyle_ForgetLayouts(masterStyle);
+		tablePtr = NULL;
+	    }
+	    if (tablePtr == NULL) {
+		tablePtr = (Tcl_HashTable *) ckalloc(sizeof(Tcl_HashTable));
+		Tcl_InitHashTable(tablePtr, keyWords);
+		masterStyle->layoutTemplates = tablePtr;
+	    }
+	    hPtr = Tcl_CreateHashEntry(tablePtr, (char *) key, &isNew);
+	    Tcl_SetHashValue(hPtr, (ClientData) ckalloc(size));
+	    memcpy(Tcl_GetHashValue(hPtr), layouts, size);
+	}
+    }
+    if (shared)
+	STATIC_FREE(key, int, keyWords);
+#else
+    Style_DoLayout(drawArgs, layouts, FALSE, file, line);
+#endif
+
+    if (!remember || (numElements == 0))
+	return;
+    if (cache == NULL) {
+	cache = (LayoutCache *) ckalloc(Tk_Offset(LayoutCache, layouts) +
+		size);
+	style->layoutCache = cache;
+    }
+    cache->width = drawArgs->width;
+    cache->height = drawArgs->height;
+    cache->indent = drawArgs->indent;
+    cache->justify = (int) drawArgs->justify;
+    cache->state = drawArgs->state;
+    memcpy(cache->layouts, layouts, size);
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -2797,6 +3066,9 @@ Style_CheckNeededSize(
     if (style->neededWidth == -1) {
 	int minWidth, minHeight;
 
+	/* Whatever invalidated the size may have changed the layout. */
+	IStyle_ForgetLayout(style);
+
 	Style_NeededSize(tree, style, state,
 	    &style->neededWidth, &style->neededHeight, &minWidth, &minHeight);
 #ifdef CACHE_STYLE_SIZE
@@ -3057,7 +3329,7 @@ TreeStyle_Draw(
 
     STATIC_ALLOC(layouts, struct Layout, masterStyle->numElements);
 
-    Style_DoLayout(drawArgs, layouts, FALSE, __FILE__, __LINE__);
+    Style_DoLayoutCached(drawArgs, layouts, TRUE, __FILE__, __LINE__);
 
     args.tree = tree;
     args.state = drawArgs->state;
@@ -3255,7 +3527,7 @@ TreeStyle_UpdateWindowPositions(
 
     STATIC_ALLOC(layouts, struct Layout, numElements);
 
-    Style_DoLayout(drawArgs, layouts, FALSE, __FILE__, __LINE__);
+    Style_DoLayoutCached(drawArgs, layouts, FALSE, __FILE__, __LINE__);
 
     args.tree = tree;
     args.state = drawArgs->state;
@@ -3327,6 +3599,9 @@ TreeStyle_UpdateWindowPositions(
 void
 TreeStyle_OnScreen(
     TreeCtrl *tree,		/* Widget info. */
+    TreeItem item,		/* Item using the style. */
+    TreeColumn column,		/* Column the style is displayed in, or
+				 * NULL if unknown. */
     TreeStyle style_,		/* Style token. */
     int onScreen		/* Boolean indicating whether the item
 				 * using the style is on screen anymore. */
@@ -3336,7 +3611,12 @@ TreeStyle_OnScreen(
     TreeElementArgs args;
     int i;
 
+    if (!onScreen)
+	IStyle_ForgetLayout(style);
+
     args.tree = tree;
+    args.screen.item = item;
+    args.screen.column = column;
     args.screen.visible = onScreen;
 
     for (i = 0; i < style->master->numElements; i++) {
@@ -3513,6 +3793,9 @@ MStyle_FreeResources(
     hPtr = Tcl_FindHashEntry(&tree->styleHash, style->name);
     Tcl_DeleteHashEntry(hPtr);
 
+#ifdef CACHE_ELEM_SIZE
+    MStyle_ForgetLayouts(style);
+#endif
     if (style->numElements > 0) {
 	for (i = 0; i < style->numElements; i++)
 	    MElementLink_FreeResources(tree, &style->elements[i]);
@@ -3555,6 +3838,7 @@ IStyle_FreeResources(
     MStyle *masterStyle = style->master;
     int i;
 
+    IStyle_ForgetLayout(style);
     if (masterStyle->numElements > 0) {
 	for (i = 0; i < masterStyle->numElements; i++)
 	    IElementLink_FreeResources(tree, &style->elements[i]);
@@ -4179,6 +4463,10 @@ Style_Changed(
     IStyle *style;
     int tailOK;
 
+#ifdef CACHE_ELEM_SIZE
+    MStyle_ForgetLayouts(masterStyle);
+#endif
+
     hPtr = Tcl_FirstHashEntry(tablePtr, &search);
     if (hPtr == NULL) {
 	tablePtr = &tree->headerHash;
@@ -4439,6 +4727,10 @@ Style_ChangeElements(
     int i, j, k, oldCount;
     int tailOK;
 
+#ifdef CACHE_ELEM_SIZE
+    MStyle_ForgetLayouts(masterStyle);
+#endif
+
     /* Update -union lists */
     for (i = 0; i < masterStyle->numElements; i++) {
 	MElementLink *eLink = &masterStyle->elements[i];
@@ -5375,7 +5667,8 @@ Tree_ElementChangedItself(
 	style->neededWidth = style->neededHeight = -1;
 
 	if (TreeItem_GetHeader(tree, item) == NULL)
-	    TreeColumns_InvalidateWidthOfItems(tree, Tree_FindColumn(tree, columnIndex));
+	    TreeColumns_InvalidateWidthOfItem(tree, item,
+		Tree_FindColumn(tree, columnIndex));
 	TreeItemColumn_InvalidateSize(tree, column);
 	TreeItem_InvalidateHeight(tree, item);
 	Tree_FreeItemDInfo(tree, item, NULL);
@@ -5400,7 +5693,7 @@ void Tree_ElementIterateChanged(TreeIterate iter_, int mask)
 	iter->eLink->neededWidth = iter->eLink->neededHeight = -1;
 #endif
 	iter->style->neededWidth = iter->style->neededHeight = -1;
-	TreeColumns_InvalidateWidthOfItems(iter->tree,
+	TreeColumns_InvalidateWidthOfItem(iter->tree, iter->item,
 	    Tree_FindColumn(iter->tree, iter->columnIndex));
 	TreeItemColumn_InvalidateSize(iter->tree, iter->column);
 	TreeItem_InvalidateHeight(iter->tree, iter->item);
@@ -7118,7 +7411,7 @@ TreeStyle_Identify(
 
     STATIC_ALLOC(layouts, struct Layout, masterStyle->numElements);
 
-    Style_DoLayout(drawArgs, layouts, FALSE, __FILE__, __LINE__);
+    Style_DoLayoutCached(drawArgs, layouts, FALSE, __FILE__, __LINE__);
 
     for (i = style->master->numElements - 1; i >= 0; i--) {
 	struct Layout *layout = &layouts[i];
@@ -7189,7 +7482,7 @@ TreeStyle_Identify2(
 
     STATIC_ALLOC(layouts, struct Layout, masterStyle->numElements);
 
-    Style_DoLayout(drawArgs, layouts, FALSE, __FILE__, __LINE__);
+    Style_DoLayoutCached(drawArgs, layouts, FALSE, __FILE__, __LINE__);
 
     for (i = style->master->numElements - 1; i >= 0; i--) {
 	struct Layout *layout = &layouts[i];
@@ -7485,7 +7778,7 @@ TreeStyle_GetElemRects(
 
     STATIC_ALLOC(layouts, struct Layout, master->numElements);
 
-    Style_DoLayout(drawArgs, layouts, FALSE, __FILE__, __LINE__);
+    Style_DoLayoutCached(drawArgs, layouts, FALSE, __FILE__, __LINE__);
 
     for (i = master->numElements - 1; i >= 0; i--) {
 	struct Layout *layout = &layouts[i];
@@ -7675,6 +7968,9 @@ Tree_UndefineState(
 	    PerStateInfo_Undefine(tree, &pstBoolean, &eLink1->draw, masterStyle->stateDomain, state);
 	    PerStateInfo_Undefine(tree, &pstBoolean, &eLink1->visible, masterStyle->stateDomain, state);
 	}
+#ifdef CACHE_ELEM_SIZE
+	MStyle_ForgetLayouts(masterStyle);
+#endif
 	hPtr = Tcl_NextHashEntry(&search);
     }
 
@@ -7801,6 +8097,34 @@ TreeStyle_IsHeaderStyle(
     return FALSE;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * TreeStyle_HasWindowElement --
+ *
+ *	Determine if a style has a 'window' type element.
+ *
+ * Results:
+ *	TRUE if the style has a 'window' type element, FALSE otherwise.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+TreeStyle_HasWindowElement(
+    TreeCtrl *tree,		/* Widget info. */
+    TreeStyle style		/* The style. */
+    )
+{
+    MStyle *mstyle = (MStyle *) style;
+    if (mstyle->master != NULL)
+	mstyle = (MStyle *) mstyle->master;
+    return mstyle->hasWindowElem;
+}
+
 /*
  *----------------------------------------------------------------------
  *
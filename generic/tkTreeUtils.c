@@ -1729,6 +1729,122 @@ ObjectIsEmpty(
 
 #define PERSTATE_ROUNDUP 5
 
+/*
+ * When a PerStateInfo has more than one PerStateData, the results of
+ * PerStateInfo_ForState() are remembered in a small direct-mapped cache
+ * kept in front of the PerStateData array. Reconfiguring the option
+ * allocates a new array, so the cache only needs to be cleared when the
+ * array is modified in place by PerStateInfo_Undefine().
+ */
+
+#define PERSTATE_CACHE_SIZE 4	/* Must match PERSTATE_CACHE_SLOT(). */
+
+typedef struct PerStateCache
+{
+    struct {
+	int state;		/* State bit-flags that were looked up. */
+	int result;		/* ((index + 1) << 2) | MATCH_xxx, where
+				 * index is -1 if nothing matched, or -1 if
+				 * this entry is unused. */
+    } entry[PERSTATE_CACHE_SIZE];
+} PerStateCache;
+
+/* Number of PerStateData-sized units taken by the cache. */
+#define PERSTATE_CACHE_UNITS(typePtr) \
+    ((int) ((sizeof(PerStateCache) + (typePtr)->size - 1) / (typePtr)->size))
+
+#define PERSTATE_CACHE(typePtr,data) \
+    ((PerStateCache *) (((char *) (data)) - \
+	PERSTATE_CACHE_UNITS(typePtr) * (typePtr)->size))
+
+/* Fibonacci hashing of the state to one of 4 entries. */
+#define PERSTATE_CACHE_SLOT(state) \
+    ((int) ((((unsigned int) (state)) * 0x9E3779B1U) >> 30))
+
+static void
+PerStateCache_Clear(
+    PerStateCache *cache
+    )
+{
+    int i;
+
+    for (i = 0; i < PERSTATE_CACHE_SIZE; i++)
+	cache->entry[i].result = -1;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * PerStateData_Alloc --
+ *
+ *	Allocate an array of PerStateData, with room for a
+ *	PerStateCache in front of it if there is more than one element.
+ *
+ * Results:
+ *	Pointer to the first PerStateData.
+ *
+ * Side effects:
+ *	Memory is allocated.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static PerStateData *
+PerStateData_Alloc(
+    TreeCtrl *tree,		/* Widget info. */
+    PerStateType *typePtr,	/* Type-specific functions and values. */
+    int count			/* Number of elements. */
+    )
+{
+    int units = (count > 1) ? PERSTATE_CACHE_UNITS(typePtr) : 0;
+    char *block;
+
+#ifdef ALLOC_HAX
+    block = TreeAlloc_CAlloc(tree->allocData, typePtr->name,
+	typePtr->size, count + units, PERSTATE_ROUNDUP);
+#else
+    block = ckalloc(typePtr->size * (count + units));
+#endif
+    if (units)
+	PerStateCache_Clear((PerStateCache *) block);
+    return (PerStateData *) (block + units * typePtr->size);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * PerStateData_Free --
+ *
+ *	Free an array allocated by PerStateData_Alloc.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Memory is deallocated.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+PerStateData_Free(
+    TreeCtrl *tree,		/* Widget info. */
+    PerStateType *typePtr,	/* Type-specific functions and values. */
+    PerStateData *pData,	/* First element. */
+    int count			/* Number of elements. */
+    )
+{
+    int units = (count > 1) ? PERSTATE_CACHE_UNITS(typePtr) : 0;
+    char *block = ((char *) pData) - units * typePtr->size;
+
+#ifdef ALLOC_HAX
+    TreeAlloc_CFree(tree->allocData, typePtr->name, block,
+	typePtr->size, count + units, PERSTATE_ROUNDUP);
+#else
+    WIPEFREE(block, typePtr->size * (count + units));
+#endif
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -1768,12 +1884,7 @@ PerStateInfo_Free(
 	(*typePtr->freeProc)(tree, pData);
 	pData = (PerStateData *) (((char *) pData) + typePtr->size);
     }
-#ifdef ALLOC_HAX
-    TreeAlloc_CFree(tree->allocData, typePtr->name, (char *) pInfo->data,
-	typePtr->size, pInfo->count, PERSTATE_ROUNDUP);
-#else
-    WIPEFREE(pInfo->data, typePtr->size * pInfo->count);
-#endif
+    PerStateData_Free(tree, typePtr, pInfo->data, pInfo->count);
     pInfo->data = NULL;
     pInfo->count = 0;
 }
@@ -1828,20 +1939,10 @@ PerStateInfo_FromObj(
 	return TCL_OK;
 
     if (objc == 1) {
-#ifdef ALLOC_HAX
-	pData = (PerStateData *) TreeAlloc_CAlloc(tree->allocData,
-	    typePtr->name, typePtr->size, 1, PERSTATE_ROUNDUP);
-#else
-	pData = (PerStateData *) ckalloc(typePtr->size);
-#endif
+	pData = PerStateData_Alloc(tree, typePtr, 1);
 	pData->stateOff = pData->stateOn = 0; /* all states */
 	if ((*typePtr->fromObjProc)(tree, objv[0], pData) != TCL_OK) {
-#ifdef ALLOC_HAX
-	    TreeAlloc_CFree(tree->allocData, typePtr->name, (char *) pData,
-		typePtr->size, 1, PERSTATE_ROUNDUP);
-#else
-	    WIPEFREE(pData, typePtr->size);
-#endif
+	    PerStateData_Free(tree, typePtr, pData, 1);
 	    return TCL_ERROR;
 	}
 	pInfo->data = pData;
@@ -1854,12 +1955,7 @@ PerStateInfo_FromObj(
 	return TCL_ERROR;
     }
 
-#ifdef ALLOC_HAX
-    pData = (PerStateData *) TreeAlloc_CAlloc(tree->allocData,
-	typePtr->name, typePtr->size, objc / 2, PERSTATE_ROUNDUP);
-#else
-    pData = (PerStateData *) ckalloc(typePtr->size * (objc / 2));
-#endif
+    pData = PerStateData_Alloc(tree, typePtr, objc / 2);
     pInfo->data = pData;
     for (i = 0; i < objc; i += 2) {
 	if ((*typePtr->fromObjProc)(tree, objv[i], pData) != TCL_OK) {
@@ -1885,12 +1981,7 @@ freeIt:
 	(*typePtr->freeProc)(tree, pData);
 	pData = (PerStateData *) (((char *) pData) + typePtr->size);
     }
-#ifdef ALLOC_HAX
-    TreeAlloc_CFree(tree->allocData, typePtr->name, (char *) pInfo->data,
-	typePtr->size, objc / 2, PERSTATE_ROUNDUP);
-#else
-    WIPEFREE(pInfo->data, typePtr->size * (objc / 2));
-#endif
+    PerStateData_Free(tree, typePtr, pInfo->data, objc / 2);
     pInfo->data = NULL;
     pInfo->count = 0;
     return TCL_ERROR;
@@ -1925,7 +2016,9 @@ PerStateInfo_ForState(
 {
     PerStateData *pData = pInfo->data;
     int stateOff = ~state, stateOn = state;
-    int i;
+    int i, m = MATCH_NONE;
+    PerStateCache *cache = NULL;
+    int slot = 0;
 
 #ifdef TREECTRL_DEBUG
     if ((pInfo->data != NULL) && (pInfo->type != typePtr)) {
@@ -1934,33 +2027,55 @@ PerStateInfo_ForState(
     }
 #endif
 
+    if (pInfo->count > 1) {
+	cache = PERSTATE_CACHE(typePtr, pInfo->data);
+	slot = PERSTATE_CACHE_SLOT(state);
+	if ((cache->entry[slot].result >= 0) &&
+		(cache->entry[slot].state == state)) {
+	    i = (cache->entry[slot].result >> 2) - 1;
+	    if (match) (*match) = cache->entry[slot].result & 3;
+	    if (i < 0)
+		return NULL;
+	    return (PerStateData *) (((char *) pData) + i * typePtr->size);
+	}
+    }
+
     for (i = 0; i < pInfo->count; i++) {
 	/* Any state */
 	if ((pData->stateOff == 0) &&
 		(pData->stateOn == 0)) {
-	    if (match) (*match) = MATCH_ANY;
-	    return pData;
+	    m = MATCH_ANY;
+	    break;
 	}
 
 	/* Exact match */
 	if ((pData->stateOff == stateOff) &&
 		(pData->stateOn == stateOn)) {
-	    if (match) (*match) = MATCH_EXACT;
-	    return pData;
+	    m = MATCH_EXACT;
+	    break;
 	}
 
 	/* Partial match */
 	if (((pData->stateOff & stateOff) == pData->stateOff) &&
 		((pData->stateOn & stateOn) == pData->stateOn)) {
-	    if (match) (*match) = MATCH_PARTIAL;
-	    return pData;
+	    m = MATCH_PARTIAL;
+	    break;
 	}
 
 	pData = (PerStateData *) (((char *) pData) + typePtr->size);
     }
+    if (m == MATCH_NONE) {
+	i = -1;
+	pData = NULL;
+    }
 
-    if (match) (*match) = MATCH_NONE;
-    return NULL;
+    if (cache != NULL) {
+	cache->entry[slot].state = state;
+	cache->entry[slot].result = ((i + 1) << 2) | m;
+    }
+
+    if (match) (*match) = m;
+    return pData;
 }
 
 /*
@@ -2108,6 +2223,10 @@ PerStateInfo_Undefine(
 	pData = (PerStateData *) (((char *) pData) + typePtr->size);
     }
 
+    /* The states of the array elements changed. */
+    if (modified && (pInfo->count > 1))
+	PerStateCache_Clear(PERSTATE_CACHE(typePtr, pInfo->data));
+
     return modified;
 }
 
@@ -2121,7 +2240,8 @@ Tree_GetGC(
 {
     GCCache *pGC;
     unsigned long valid = GCBackground | GCDashList | GCDashOffset | GCFont |
-	    GCForeground | GCFunction | GCGraphicsExposures | GCLineStyle;
+	    GCForeground | GCFunction | GCGraphicsExposures | GCLineStyle |
+	    GCLineWidth | GCCapStyle | GCJoinStyle;
 
     if ((mask | valid) != valid)
 	panic("Tree_GetGC: unsupported mask");
@@ -2150,6 +2270,15 @@ Tree_GetGC(
 	if ((mask & GCGraphicsExposures) &&
 		(pGC->gcValues.graphics_exposures != gcValues->graphics_exposures))
 	    continue;
+	if ((mask & GCLineWidth) &&
+		(pGC->gcValues.line_width != gcValues->line_width))
+	    continue;
+	if ((mask & GCCapStyle) &&
+		(pGC->gcValues.cap_style != gcValues->cap_style))
+	    continue;
+	if ((mask & GCJoinStyle) &&
+		(pGC->gcValues.join_style != gcValues->join_style))
+	    continue;
 	return pGC->gc;
     }
 
@@ -2804,6 +2933,12 @@ PSTRestore(
  * allocates blocks of same-sized chunks, and holds on to those chunks when
  * they are freed so they can be reused quickly. If you don't want to use it
  * just comment out #define ALLOC_HAX in tkTreeCtrl.h.
+ *
+ * Chunks are pooled by the ID passed by the caller as well as by size. This
+ * keeps, for example, all the instances of one element type together in
+ * memory in the order they were created, instead of mixed in with items,
+ * styles and dynamic options of the same size. Drawing or measuring many
+ * rows then reads each kind of data from a few contiguous blocks.
  */
 
 typedef struct AllocElem AllocElem;
@@ -2848,6 +2983,7 @@ struct AllocBlock
  */
 struct AllocList
 {
+    Tk_Uid id;		/* ID passed to TreeAlloc_Alloc(). */
     int size;		/* Size of every AllocElem.body[] */
     AllocElem *head;	/* Top of stack of unused pieces of memory. */
     AllocBlock *blocks;	/* Linked list of allocated blocks. The blocks
@@ -2951,6 +3087,46 @@ TreeAlloc_Stats(
 
 #endif /* ALLOC_STATS */
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * AllocList_Find --
+ *
+ *	Find the list of pieces of memory with the given ID and size.
+ *	The list is moved to the front so the most-used lists are found
+ *	quickly.
+ *
+ * Results:
+ *	Pointer to the list, or NULL if it doesn't exist.
+ *
+ * Side effects:
+ *	The order of the lists may change.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static AllocList *
+AllocList_Find(
+    AllocData *data,		/* Token returned by TreeAlloc_Init(). */
+    Tk_Uid id,			/* ID for the list. */
+    int size			/* Size of every piece of memory. */
+    )
+{
+    AllocList *freeList = data->freeLists, *prev = NULL;
+
+    while ((freeList != NULL) &&
+	    ((freeList->size != size) || (freeList->id != id))) {
+	prev = freeList;
+	freeList = freeList->next;
+    }
+    if ((freeList != NULL) && (prev != NULL)) {
+	prev->next = freeList->next;
+	freeList->next = data->freeLists;
+	data->freeLists = freeList;
+    }
+    return freeList;
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -2976,8 +3152,7 @@ TreeAlloc_Alloc(
     )
 {
     AllocData *data = (AllocData *) _data;
-    AllocList *freeLists = data->freeLists;
-    AllocList *freeList = freeLists;
+    AllocList *freeList;
     AllocBlock *block;
     AllocElem *elem, *result;
 #ifdef ALLOC_STATS
@@ -2990,18 +3165,17 @@ TreeAlloc_Alloc(
     stats->size += size;
 #endif
 
-    while ((freeList != NULL) && (freeList->size != size))
-	freeList = freeList->next;
+    freeList = AllocList_Find(data, id, size);
 
     if (freeList == NULL) {
 	freeList = (AllocList *) ckalloc(sizeof(AllocList));
+	freeList->id = id;
 	freeList->size = size;
 	freeList->head = NULL;
-	freeList->next = freeLists;
+	freeList->next = data->freeLists;
 	freeList->blocks = NULL;
 	freeList->blockSize = 16;
-	freeLists = freeList;
-	((AllocData *) data)->freeLists = freeLists;
+	data->freeLists = freeList;
     }
 
     if (freeList->head == NULL) {
@@ -3090,7 +3264,7 @@ TreeAlloc_Realloc(
  *
  * Results:
  *	The piece of memory is added to a list of free pieces of the
- *	same size.
+ *	same ID and size.
  *
  * Side effects:
  *	None.
@@ -3109,8 +3283,7 @@ TreeAlloc_Free(
     )
 {
     AllocData *data = (AllocData *) _data;
-    AllocList *freeLists = data->freeLists;
-    AllocList *freeList = freeLists;
+    AllocList *freeList;
     AllocElem *elem;
 #ifdef ALLOC_STATS
     AllocStats *stats = AllocStats_Get(_data, id);
@@ -3141,10 +3314,9 @@ TreeAlloc_Free(
     if (elem->size != size)
 	panic("TreeAlloc_Free: element size %d != size %d", elem->size, size);
 #endif
-    while (freeList != NULL && freeList->size != size)
-	freeList = freeList->next;
+    freeList = AllocList_Find(data, id, size);
     if (freeList == NULL)
-	panic("TreeAlloc_Free: can't find free list for size %d", size);
+	panic("TreeAlloc_Free: can't find free list for %s size %d", id, size);
 
     WIPE(ptr, size);
     elem->next = freeList->head;
@@ -3202,7 +3374,7 @@ TreeAlloc_CAlloc(
  *
  * Results:
  *	The piece of memory is added to a list of free pieces of the
- *	same size.
+ *	same ID and size.
  *
  * Side effects:
  *	None.
@@ -3496,6 +3668,206 @@ TreePtrList_Free(
     tplPtr->pointers[0] = NULL;
 }
 
+#define IDSET_BITS ((int) (sizeof(unsigned long) * 8))
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TreeIdSet_Init --
+ *
+ *	Initialize an empty id set.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+TreeIdSet_Init(
+    TreeIdSet *set		/* Set to initialize. */
+    )
+{
+    set->words = NULL;
+    set->numWords = 0;
+    set->count = 0;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TreeIdSet_Free --
+ *
+ *	Frees up any memory allocated for the id set and reinitializes
+ *	the set to an empty state.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Memory may be freed.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+TreeIdSet_Free(
+    TreeIdSet *set		/* Set to free. */
+    )
+{
+    if (set->words != NULL)
+	ckfree((char *) set->words);
+    TreeIdSet_Init(set);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TreeIdSet_Add --
+ *
+ *	Add an id to an id set.
+ *
+ * Results:
+ *	TRUE if the id was not already in the set, FALSE otherwise.
+ *
+ * Side effects:
+ *	Memory may be (re)allocated.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+TreeIdSet_Add(
+    TreeIdSet *set,		/* Set to add to. */
+    int id			/* Non-negative id. */
+    )
+{
+    int w = id / IDSET_BITS;
+    unsigned long bit = 1UL << (id % IDSET_BITS);
+
+    if (w >= set->numWords) {
+	int numWords = set->numWords ? set->numWords : 4;
+
+	while (numWords <= w)
+	    numWords *= 2;
+	set->words = (unsigned long *) ckrealloc((char *) set->words,
+		numWords * sizeof(unsigned long));
+	memset(set->words + set->numWords, '\0',
+		(numWords - set->numWords) * sizeof(unsigned long));
+	set->numWords = numWords;
+    }
+    if (set->words[w] & bit)
+	return FALSE;
+    set->words[w] |= bit;
+    set->count++;
+    return TRUE;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TreeIdSet_Remove --
+ *
+ *	Remove an id from an id set.
+ *
+ * Results:
+ *	TRUE if the id was in the set, FALSE otherwise.
+ *
+ * Side effects:
+ *	Memory is freed when the set becomes empty.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+TreeIdSet_Remove(
+    TreeIdSet *set,		/* Set to remove from. */
+    int id			/* Non-negative id. */
+    )
+{
+    if (!TreeIdSet_Contains(set, id))
+	return FALSE;
+    set->words[id / IDSET_BITS] &= ~(1UL << (id % IDSET_BITS));
+    if (--set->count == 0)
+	TreeIdSet_Free(set);
+    return TRUE;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TreeIdSet_Contains --
+ *
+ *	Test whether an id is in an id set.
+ *
+ * Results:
+ *	TRUE if the id is in the set, FALSE otherwise.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+TreeIdSet_Contains(
+    TreeIdSet *set,		/* Set to search. */
+    int id			/* Non-negative id. */
+    )
+{
+    int w = id / IDSET_BITS;
+
+    if (w >= set->numWords)
+	return FALSE;
+    return (set->words[w] & (1UL << (id % IDSET_BITS))) != 0;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TreeIdSet_Next --
+ *
+ *	Find the smallest id in an id set that is not less than the
+ *	given id. Use TreeIdSet_Next(set, 0) to get the first id and
+ *	TreeIdSet_Next(set, id + 1) to get the one after id.
+ *
+ * Results:
+ *	The id found, or -1 if there are no more ids in the set.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+TreeIdSet_Next(
+    TreeIdSet *set,		/* Set to search. */
+    int id			/* Non-negative id to start at. */
+    )
+{
+    int w = id / IDSET_BITS, b = id % IDSET_BITS;
+    unsigned long word;
+
+    if (w >= set->numWords)
+	return -1;
+    word = set->words[w] >> b;
+    while (word == 0) {
+	b = 0;
+	if (++w == set->numWords)
+	    return -1;
+	word = set->words[w];
+    }
+    while (!(word & 1)) {
+	word >>= 1;
+	b++;
+    }
+    return w * IDSET_BITS + b;
+}
+
 #define TAG_INFO_SIZE(tagSpace) \
     (Tk_Offset(TagInfo, tagPtr) + ((tagSpace) * sizeof(Tk_Uid)))
 
@@ -3901,95 +4273,68 @@ Tk_ObjCustomOption TreeCtrlCO_tagInfo =
 };
 
 /*
- *----------------------------------------------------------------------
- *
- * TagExpr_Init --
- *
- *	This procedure initializes a TagExpr struct by parsing a Tcl_Obj
- *	string representation of a tag expression.
- *
- * Results:
- *	A standard Tcl result.
- *
- * Side effects:
- *	Memory may be allocated.
- *
- *----------------------------------------------------------------------
+ * The following structure holds the state of the scanner while the string
+ * representation of a tag expression is parsed into an array of Tk_Uids.
  */
+typedef struct TagExprScan {
+    Tcl_Interp *interp;		/* For error messages. */
 
-int
-TagExpr_Init(
-    TreeCtrl *tree,		/* Widget info. */
-    Tcl_Obj *exprObj,		/* Tag expression string. */
-    TagExpr *expr		/* Struct to initialize. */
-    )
-{
-    int i;
-    char *tag;
+    Tk_Uid *uids;		/* expresion scanned to an array of uids */
+    Tk_Uid staticUids[15];
+    int allocated;		/* available space for array of uids */
+    int length;			/* number of uids */
+    int index;			/* current position in scan or compile */
 
-    expr->tree = tree;
-    expr->index = 0;
-    expr->length = 0;
-    expr->uid = NULL;
-    expr->allocated = sizeof(expr->staticUids) / sizeof(Tk_Uid);
-    expr->uids = expr->staticUids;
-    expr->simple = TRUE;
-    expr->rewritebuffer = expr->staticRWB;
+    char *string;		/* tag expression string */
+    int stringIndex;		/* current position in string scan */
+    int stringLength;		/* length of tag expression string */
 
-    tag = Tcl_GetStringFromObj(exprObj, &expr->stringLength);
+    char *rewritebuffer;	/* tag string (after removing escapes) */
+    char staticRWB[100];
+} TagExprScan;
 
-    /* short circuit impossible searches for null tags */
-    if (expr->stringLength == 0) {
-	return TCL_OK;
-    }
-
-    /*
-     * Pre-scan tag for at least one unquoted "&&" "||" "^" "!"
-     *   if not found then use string as simple tag
-     */
-    for (i = 0; i < expr->stringLength ; i++) {
-	if (tag[i] == '"') {
-	    i++;
-	    for ( ; i < expr->stringLength; i++) {
-		if (tag[i] == '\\') {
-		    i++;
-		    continue;
-		}
-		if (tag[i] == '"') {
-		    break;
-		}
-	    }
-	} else {
-	    if ((tag[i] == '&' && tag[i+1] == '&')
-	     || (tag[i] == '|' && tag[i+1] == '|')
-	     || (tag[i] == '^')
-	     || (tag[i] == '!')) {
-		expr->simple = FALSE;
-		break;
-	    }
-	}
-    }
-
-    if (expr->simple) {
-	expr->uid = Tk_GetUid(tag);
-	return TCL_OK;
-    }
-
-    expr->string = tag;
-    expr->stringIndex = 0;
-
-    /* Allocate buffer for rewritten tags (after de-escaping) */
-    if (expr->stringLength >= sizeof(expr->staticRWB))
-	expr->rewritebuffer = ckalloc(expr->stringLength + 1);
-
-    if (TagExpr_Scan(expr) != TCL_OK) {
-	TagExpr_Free(expr);
-	return TCL_ERROR;
-    }
-    expr->length = expr->index;
+/*
+ * Instructions in a compiled tag expression. A compiled expression is
+ * evaluated using a small stack of boolean values.
+ */
+#define TEOP_TAG	0	/* Push 1 if the tags contain the uid in the
+				 * next slot, otherwise push 0. */
+#define TEOP_NOT	1	/* Negate the top of the stack. */
+#define TEOP_XOR	2	/* Pop 2 values, push their exclusive-or. */
+#define TEOP_JUMP_FALSE	3	/* If the top of the stack is 0 then jump to
+				 * the instruction in the next slot, otherwise
+				 * pop the stack. */
+#define TEOP_JUMP_TRUE	4	/* If the top of the stack is 1 then jump to
+				 * the instruction in the next slot, otherwise
+				 * pop the stack. */
+
+typedef union TagExprInstr {
+    int op;			/* TEOP_xxx */
+    int target;			/* Operand of TEOP_JUMP_xxx. */
+    Tk_Uid uid;			/* Operand of TEOP_TAG. */
+} TagExprInstr;
 
-    return TCL_OK;
-}
+/*
+ * A structure of the following type is the compiled form of a tag
+ * expression. It is stored in the internal rep of a Tcl_Obj so an
+ * expression used repeatedly is only parsed once.
+ */
+struct TagExprCode {
+    int refCount;		/* Number of Tcl_Objs and TagExprs using
+				 * this. */
+    int empty;			/* TRUE if the expression is an empty string,
+				 * which doesn't match anything. */
+    int simple;			/* TRUE if expr is single tag */
+    Tk_Uid uid;			/* single tag if 'simple' is TRUE */
+    TagExprInstr *instrs;	/* Compiled expression. */
+    int numInstrs;		/* Number of slots in instrs[]. */
+    int stackDepth;		/* Size of the stack needed by instrs[]. */
+    Tk_Uid *cands;		/* Any set of tags that matches the expression
+				 * includes at least one of these. NULL if a
+				 * set of tags may match without including
+				 * any particular tag, such as for "!a". */
+    int numCands;		/* Number of tags in cands[]. */
+};
 
 /*
  * Uids for operands in compiled tag expressions.
@@ -4065,12 +4410,12 @@ GetStaticUids()
  *----------------------------------------------------------------------
  */
 
-int
+static int
 TagExpr_Scan(
-    TagExpr *expr		/* Info about a tag expression. */
+    TagExprScan *expr		/* Info about a tag expression. */
     )
 {
-    Tcl_Interp *interp = expr->tree->interp;
+    Tcl_Interp *interp = expr->interp;
     int looking_for_tag;        /* When true, scanner expects
 				 * next char(s) to be a tag,
 				 * else operand expected */
@@ -4089,7 +4434,8 @@ TagExpr_Scan(
     while (expr->stringIndex < expr->stringLength) {
 	c = expr->string[expr->stringIndex++];
 
-	if (expr->allocated == expr->index) {
+	/* A tag takes two slots (operator and uid). */
+	if (expr->allocated - expr->index < 2) {
 	    expr->allocated += 15;
 	    if (expr->uids != expr->staticUids) {
 		expr->uids =
@@ -4280,191 +4626,631 @@ breakwhile:
     return TCL_ERROR;
 }
 
+/*
+ * The following structures are used while compiling the scanned form of a
+ * tag expression into a TagExprCode.
+ */
+typedef struct TagExprCompiler {
+    TagExprScan *scan;		/* Scanned expression. */
+    SearchUids *searchUids;	/* Operator uids. */
+    TagExprInstr *instrs;	/* Compiled instructions. */
+    int numInstrs;		/* Number of used slots in instrs[]. */
+    int space;			/* Number of slots allocated for instrs[]. */
+    int depth;			/* Stack depth after the last instruction. */
+    int maxDepth;		/* Max stack depth so far. */
+} TagExprCompiler;
+
+typedef struct TagCands {
+    int any;			/* TRUE if tags[] doesn't limit the matches. */
+    int count;			/* Number of tags in tags[]. */
+    Tk_Uid *tags;		/* Array of tags, or NULL. */
+} TagCands;
+
+static void
+TagCands_Free(
+    TagCands *cands
+    )
+{
+    if (cands->tags != NULL)
+	ckfree((char *) cands->tags);
+    cands->tags = NULL;
+    cands->count = 0;
+}
+
+static void
+TagCands_Any(
+    TagCands *cands
+    )
+{
+    TagCands_Free(cands);
+    cands->any = TRUE;
+}
+
+/* A set of tags matches "a || b" or "a ^ b" only if it matches "a" or "b",
+ * so the candidates are the union of the candidates of each side. */
+static void
+TagCands_Union(
+    TagCands *cands,		/* In: left side. Out: result. */
+    TagCands *cands2		/* Right side. Freed. */
+    )
+{
+    int i, j;
+
+    if (cands->any || cands2->any) {
+	TagCands_Any(cands);
+	TagCands_Free(cands2);
+	return;
+    }
+    cands->tags = (Tk_Uid *) ckrealloc((char *) cands->tags,
+	sizeof(Tk_Uid) * (cands->count + cands2->count));
+    for (i = 0; i < cands2->count; i++) {
+	for (j = 0; j < cands->count; j++) {
+	    if (cands->tags[j] == cands2->tags[i])
+		break;
+	}
+	if (j == cands->count)
+	    cands->tags[cands->count++] = cands2->tags[i];
+    }
+    TagCands_Free(cands2);
+}
+
+/* A set of tags matches "a && b" only if it matches both "a" and "b", so
+ * the candidates of either side will do. Keep the more selective one. */
+static void
+TagCands_Narrow(
+    TagCands *cands,		/* In: left side. Out: result. */
+    TagCands *cands2		/* Right side. Freed. */
+    )
+{
+    if (cands->any || (!cands2->any && (cands2->count < cands->count))) {
+	TagCands tmp = *cands;
+	*cands = *cands2;
+	*cands2 = tmp;
+    }
+    TagCands_Free(cands2);
+}
+
+static void
+TagExpr_Emit(
+    TagExprCompiler *c,
+    int op,
+    Tk_Uid uid
+    )
+{
+    if (c->numInstrs + 2 > c->space) {
+	c->space = c->space ? c->space * 2 : 16;
+	c->instrs = (TagExprInstr *) ckrealloc((char *) c->instrs,
+	    sizeof(TagExprInstr) * c->space);
+    }
+    c->instrs[c->numInstrs++].op = op;
+    switch (op) {
+	case TEOP_TAG:
+	    c->instrs[c->numInstrs++].uid = uid;
+	    if (++c->depth > c->maxDepth)
+		c->maxDepth = c->depth;
+	    break;
+	case TEOP_XOR:
+	    c->depth--;
+	    break;
+	case TEOP_JUMP_FALSE:
+	case TEOP_JUMP_TRUE:
+	    /* The target is filled in by the caller. When the jump isn't
+	     * taken the stack is popped. */
+	    c->instrs[c->numInstrs++].target = -1;
+	    c->depth--;
+	    break;
+    }
+}
+
+static void TagExpr_CompileSequence(TagExprCompiler *c, TagCands *cands);
+
 /*
  *----------------------------------------------------------------------
  *
- * TagExpr_Eval --
+ * TagExpr_CompileOperand --
  *
- *	This procedure recursively evaluates a compiled tag expression.
+ *	Compile a single (possibly negated) tag or a parenthesized
+ *	subexpression.
  *
  * Results:
- *	The return value indicates if the tag expression
- *	successfully matched the tags of the given item.
+ *	Instructions are added to the compiler. The candidate tags for
+ *	the operand are returned.
  *
  * Side effects:
+ *	Memory may be allocated.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+TagExpr_CompileOperand(
+    TagExprCompiler *c,		/* Compiler state. */
+    TagCands *cands		/* Out: candidate tags. */
+    )
+{
+    TagExprScan *scan = c->scan;
+    SearchUids *searchUids = c->searchUids;
+    Tk_Uid uid = scan->uids[scan->index++];
+
+    cands->any = FALSE;
+    cands->count = 0;
+    cands->tags = NULL;
+
+    if (uid == searchUids->tagvalUid || uid == searchUids->negtagvalUid) {
+	TagExpr_Emit(c, TEOP_TAG, scan->uids[scan->index]);
+	if (uid == searchUids->negtagvalUid) {
+	    TagExpr_Emit(c, TEOP_NOT, NULL);
+	    TagCands_Any(cands);
+	} else {
+	    cands->tags = (Tk_Uid *) ckalloc(sizeof(Tk_Uid));
+	    cands->tags[cands->count++] = scan->uids[scan->index];
+	}
+	scan->index++;
+    } else if (uid == searchUids->parenUid) {
+	TagExpr_CompileSequence(c, cands);
+    } else /* if (uid == searchUids->negparenUid) */ {
+	TagExpr_CompileSequence(c, cands);
+	TagExpr_Emit(c, TEOP_NOT, NULL);
+	TagCands_Any(cands);
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TagExpr_CompileSequence --
+ *
+ *	Compile operands and operators up to the end of the current
+ *	subexpression. Operators are evaluated left-to-right, and
+ *	everything to the right of "&&" or "||" is skipped when the
+ *	left side decides the result (as with canvas tag searches).
+ *
+ * Results:
+ *	Instructions are added to the compiler. The candidate tags for
+ *	the subexpression are returned.
+ *
+ * Side effects:
+ *	Memory may be allocated.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+TagExpr_CompileSequence(
+    TagExprCompiler *c,		/* Compiler state. */
+    TagCands *cands		/* Out: candidate tags. */
+    )
+{
+    TagExprScan *scan = c->scan;
+    SearchUids *searchUids = c->searchUids;
+    TagCands cands2;
+    Tk_Uid uid;
+    int slot;
+
+    TagExpr_CompileOperand(c, cands);
+    while (scan->index < scan->length) {
+	uid = scan->uids[scan->index++];
+	if (uid == searchUids->endparenUid)
+	    return;
+	if (uid == searchUids->xorUid) {
+	    TagExpr_CompileOperand(c, &cands2);
+	    TagExpr_Emit(c, TEOP_XOR, NULL);
+	    TagCands_Union(cands, &cands2);
+	    continue;
+	}
+	TagExpr_Emit(c, (uid == searchUids->andUid) ? TEOP_JUMP_FALSE :
+	    TEOP_JUMP_TRUE, NULL);
+	slot = c->numInstrs - 1;
+	TagExpr_CompileSequence(c, &cands2);
+	c->instrs[slot].target = c->numInstrs;
+	if (uid == searchUids->andUid)
+	    TagCands_Narrow(cands, &cands2);
+	else
+	    TagCands_Union(cands, &cands2);
+	return;
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TagExprCode_Free --
+ *
+ *	Release a reference to a compiled tag expression.
+ *
+ * Results:
  *	None.
  *
+ * Side effects:
+ *	Memory is freed when the last reference goes away.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+TagExprCode_Free(
+    TagExprCode *code
+    )
+{
+    if (--code->refCount > 0)
+	return;
+    if (code->instrs != NULL)
+	ckfree((char *) code->instrs);
+    if (code->cands != NULL)
+	ckfree((char *) code->cands);
+    WFREE(code, TagExprCode);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TagExprCode_Compile --
+ *
+ *	Parse the string representation of a tag expression and compile
+ *	it.
+ *
+ * Results:
+ *	A standard Tcl result. If TCL_OK, *codePtr is set to a new
+ *	TagExprCode with a zero reference count.
+ *
+ * Side effects:
+ *	Memory is allocated.
+ *
  *----------------------------------------------------------------------
  */
 
 static int
-_TagExpr_Eval(
-    TagExpr *expr,		/* Info about a tag expression. */
-    TagInfo *tagInfo		/* Tags to test. */
+TagExprCode_Compile(
+    Tcl_Interp *interp,		/* For error messages. */
+    Tcl_Obj *exprObj,		/* Tag expression string. */
+    TagExprCode **codePtr	/* Out: compiled expression. */
     )
 {
-    int looking_for_tag;        /* When true, scanner expects
-				 * next char(s) to be a tag,
-				 * else operand expected */
-    int negate_result;          /* Pending negation of next tag value */
-    Tk_Uid uid;
-    Tk_Uid *tagPtr;
-    int count;
-    int result;                 /* Value of expr so far */
-    int parendepth;
-    SearchUids *searchUids;	/* Collection of uids for basic search
-				 * expression terms. */
-    TagInfo dummy;
+    TagExprScan scan;
+    TagExprCompiler compiler;
+    TagExprCode *code;
+    TagCands cands;
+    int i, simple = TRUE;
+    char *tag;
 
-    if (expr->stringLength == 0) /* empty expression (an error?) */
-	return 0;
+    tag = Tcl_GetStringFromObj(exprObj, &scan.stringLength);
 
-    /* No tags given. */
-    if (tagInfo == NULL) {
-	dummy.numTags = 0;
-	tagInfo = &dummy;
+    code = (TagExprCode *) ckalloc(sizeof(TagExprCode));
+    memset(code, '\0', sizeof(TagExprCode));
+
+    /* short circuit impossible searches for null tags */
+    if (scan.stringLength == 0) {
+	code->empty = TRUE;
+	*codePtr = code;
+	return TCL_OK;
     }
 
-    /* A single tag. */
-    if (expr->simple) {
-	for (tagPtr = tagInfo->tagPtr, count = tagInfo->numTags;
-	    count > 0; tagPtr++, count--) {
-	    if (*tagPtr == expr->uid) {
-		return 1;
+    /*
+     * Pre-scan tag for at least one unquoted "&&" "||" "^" "!"
+     *   if not found then use string as simple tag
+     */
+    for (i = 0; i < scan.stringLength ; i++) {
+	if (tag[i] == '"') {
+	    i++;
+	    for ( ; i < scan.stringLength; i++) {
+		if (tag[i] == '\\') {
+		    i++;
+		    continue;
+		}
+		if (tag[i] == '"') {
+		    break;
+		}
+	    }
+	} else {
+	    if ((tag[i] == '&' && tag[i+1] == '&')
+	     || (tag[i] == '|' && tag[i+1] == '|')
+	     || (tag[i] == '^')
+	     || (tag[i] == '!')) {
+		simple = FALSE;
+		break;
 	    }
 	}
-	return 0;
     }
 
-    searchUids = GetStaticUids();
-    result = 0;  /* just to keep the compiler quiet */
+    if (simple) {
+	code->simple = TRUE;
+	code->uid = Tk_GetUid(tag);
+	*codePtr = code;
+	return TCL_OK;
+    }
+
+    scan.interp = interp;
+    scan.index = 0;
+    scan.length = 0;
+    scan.allocated = sizeof(scan.staticUids) / sizeof(Tk_Uid);
+    scan.uids = scan.staticUids;
+    scan.string = tag;
+    scan.stringIndex = 0;
+    scan.rewritebuffer = scan.staticRWB;
+
+    /* Allocate buffer for rewritten tags (after de-escaping) */
+    if (scan.stringLength >= sizeof(scan.staticRWB))
+	scan.rewritebuffer = ckalloc(scan.stringLength + 1);
+
+    if (TagExpr_Scan(&scan) != TCL_OK) {
+	if (scan.rewritebuffer != scan.staticRWB)
+	    ckfree(scan.rewritebuffer);
+	if (scan.uids != scan.staticUids)
+	    ckfree((char *) scan.uids);
+	ckfree((char *) code);
+	return TCL_ERROR;
+    }
+    scan.length = scan.index;
+    scan.index = 0;
+
+    compiler.scan = &scan;
+    compiler.searchUids = GetStaticUids();
+    compiler.instrs = NULL;
+    compiler.numInstrs = compiler.space = 0;
+    compiler.depth = compiler.maxDepth = 0;
+    TagExpr_CompileSequence(&compiler, &cands);
+
+    code->instrs = compiler.instrs;
+    code->numInstrs = compiler.numInstrs;
+    code->stackDepth = compiler.maxDepth;
+    if (!cands.any) {
+	code->cands = cands.tags;
+	code->numCands = cands.count;
+    }
+
+    if (scan.rewritebuffer != scan.staticRWB)
+	ckfree(scan.rewritebuffer);
+    if (scan.uids != scan.staticUids)
+	ckfree((char *) scan.uids);
+
+    *codePtr = code;
+    return TCL_OK;
+}
 
-    negate_result = 0;
-    looking_for_tag = 1;
-    while (expr->index < expr->length) {
-	uid = expr->uids[expr->index++];
-	if (looking_for_tag) {
-	    if (uid == searchUids->tagvalUid) {
 /*
- *              assert(expr->index < expr->length);
+ *----------------------------------------------------------------------
+ *
+ * TagExprObj_FreeIntRep --
+ * TagExprObj_DupIntRep --
+ * TagExprObj_SetFromAny --
+ *
+ *	These procedures implement a Tcl_ObjType whose internal rep
+ *	is a compiled tag expression.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
  */
-		uid = expr->uids[expr->index++];
-		result = 0;
-		/*
-		 * set result 1 if tag is found in item's tags
-		 */
-		for (tagPtr = tagInfo->tagPtr, count = tagInfo->numTags;
-		    count > 0; tagPtr++, count--) {
-		    if (*tagPtr == uid) {
-			result = 1;
-			break;
-		    }
-		}
 
-	    } else if (uid == searchUids->negtagvalUid) {
-		negate_result = ! negate_result;
+static void TagExprObj_FreeIntRep(Tcl_Obj *objPtr);
+static void TagExprObj_DupIntRep(Tcl_Obj *srcPtr, Tcl_Obj *dupPtr);
+static int TagExprObj_SetFromAny(Tcl_Interp *interp, Tcl_Obj *objPtr);
+
+static Tcl_ObjType tagExprObjType = {
+    "TreeCtrlTagExpr",
+    TagExprObj_FreeIntRep,
+    TagExprObj_DupIntRep,
+    NULL,
+    TagExprObj_SetFromAny
+};
+
+static void
+TagExprObj_FreeIntRep(
+    Tcl_Obj *objPtr
+    )
+{
+    TagExprCode_Free((TagExprCode *) objPtr->internalRep.otherValuePtr);
+    objPtr->typePtr = NULL;
+}
+
+static void
+TagExprObj_DupIntRep(
+    Tcl_Obj *srcPtr,
+    Tcl_Obj *dupPtr
+    )
+{
+    TagExprCode *code = (TagExprCode *) srcPtr->internalRep.otherValuePtr;
+
+    code->refCount++;
+    dupPtr->internalRep.otherValuePtr = (VOID *) code;
+    dupPtr->typePtr = &tagExprObjType;
+}
+
+static int
+TagExprObj_SetFromAny(
+    Tcl_Interp *interp,
+    Tcl_Obj *objPtr
+    )
+{
+    TagExprCode *code;
+
+    /* This also ensures the string rep is valid before the old internal
+     * rep is freed. */
+    if (TagExprCode_Compile(interp, objPtr, &code) != TCL_OK)
+	return TCL_ERROR;
+    if ((objPtr->typePtr != NULL) &&
+	    (objPtr->typePtr->freeIntRepProc != NULL)) {
+	objPtr->typePtr->freeIntRepProc(objPtr);
+    }
+    code->refCount++;
+    objPtr->internalRep.otherValuePtr = (VOID *) code;
+    objPtr->typePtr = &tagExprObjType;
+    return TCL_OK;
+}
+
 /*
- *              assert(expr->index < expr->length);
+ *----------------------------------------------------------------------
+ *
+ * TagExpr_Init --
+ *
+ *	This procedure initializes a TagExpr struct from a Tcl_Obj
+ *	tag expression. The expression is compiled the first time it
+ *	is used and the result is kept in the Tcl_Obj.
+ *
+ * Results:
+ *	A standard Tcl result.
+ *
+ * Side effects:
+ *	Memory may be allocated.
+ *
+ *----------------------------------------------------------------------
  */
-		uid = expr->uids[expr->index++];
-		result = 0;
-		/*
-		 * set result 1 if tag is found in item's tags
-		 */
-		for (tagPtr = tagInfo->tagPtr, count = tagInfo->numTags;
-		    count > 0; tagPtr++, count--) {
-		    if (*tagPtr == uid) {
-			result = 1;
-			break;
-		    }
-		}
 
-	    } else if (uid == searchUids->parenUid) {
-		/*
-		 * evaluate subexpressions with recursion
-		 */
-		result = _TagExpr_Eval(expr, tagInfo);
+int
+TagExpr_Init(
+    TreeCtrl *tree,		/* Widget info. */
+    Tcl_Obj *exprObj,		/* Tag expression string. */
+    TagExpr *expr		/* Struct to initialize. */
+    )
+{
+    if (exprObj->typePtr != &tagExprObjType) {
+	if (TagExprObj_SetFromAny(tree->interp, exprObj) != TCL_OK)
+	    return TCL_ERROR;
+    }
+    expr->tree = tree;
+    expr->code = (TagExprCode *) exprObj->internalRep.otherValuePtr;
+
+    /* Keep the code alive even if exprObj changes type. */
+    expr->code->refCount++;
+
+    return TCL_OK;
+}
+
+static int
+TagInfo_HasTag(
+    TagInfo *tagInfo,		/* Tags to test. May be NULL. */
+    Tk_Uid tag			/* Tag to look for. */
+    )
+{
+    Tk_Uid *tagPtr;
+    int count;
+
+    if (tagInfo == NULL)
+	return 0;
+    for (tagPtr = tagInfo->tagPtr, count = tagInfo->numTags;
+	count > 0; tagPtr++, count--) {
+	if (*tagPtr == tag) {
+	    return 1;
+	}
+    }
+    return 0;
+}
 
-	    } else if (uid == searchUids->negparenUid) {
-		negate_result = ! negate_result;
-		/*
-		 * evaluate subexpressions with recursion
-		 */
-		result = _TagExpr_Eval(expr, tagInfo);
 /*
- *          } else {
- *              assert(0);
+ *----------------------------------------------------------------------
+ *
+ * TagExpr_Eval --
+ *
+ *	This procedure evaluates a compiled tag expression.
+ *
+ * Results:
+ *	The return value indicates if the tag expression
+ *	successfully matched the tags of the given item.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
  */
-	    }
-	    if (negate_result) {
-		result = ! result;
-		negate_result = 0;
-	    }
-	    looking_for_tag = 0;
-	} else {    /* ! looking_for_tag */
-	    if (((uid == searchUids->andUid) && (!result)) ||
-		    ((uid == searchUids->orUid) && result)) {
+
+int
+TagExpr_Eval(
+    TagExpr *expr,		/* Info about a tag expression. */
+    TagInfo *tagInfo		/* Tags to test. */
+    )
+{
+    TagExprCode *code = expr->code;
+    TagExprInstr *instrs = code->instrs;
+    int staticStack[STATIC_SIZE], *stack = staticStack;
+    int pc = 0, sp = -1, result;
+
+    if (code->empty) /* empty expression (an error?) */
+	return 0;
+
+    /* A single tag. */
+    if (code->simple)
+	return TagInfo_HasTag(tagInfo, code->uid);
+
+    STATIC_ALLOC(stack, int, code->stackDepth);
+    stack[0] = 0;
+    while (pc < code->numInstrs) {
+	switch (instrs[pc++].op) {
+	    case TEOP_TAG:
+		stack[++sp] = TagInfo_HasTag(tagInfo, instrs[pc++].uid);
+		break;
+	    case TEOP_NOT:
+		stack[sp] = !stack[sp];
+		break;
+	    case TEOP_XOR:
+		sp--;
+		stack[sp] = (stack[sp] != stack[sp + 1]);
+		break;
+	    case TEOP_JUMP_FALSE:
 		/*
-		 * short circuit expression evaluation
-		 *
 		 * if result before && is 0, or result before || is 1,
 		 *   then the expression is decided and no further
 		 *   evaluation is needed.
 		 */
-
-		    parendepth = 0;
-		while (expr->index < expr->length) {
-		    uid = expr->uids[expr->index++];
-		    if (uid == searchUids->tagvalUid ||
-			    uid == searchUids->negtagvalUid) {
-			expr->index++;
-			continue;
-		    }
-		    if (uid == searchUids->parenUid ||
-			    uid == searchUids->negparenUid) {
-			parendepth++;
-			continue;
-		    }
-		    if (uid == searchUids->endparenUid) {
-			parendepth--;
-			if (parendepth < 0) {
-			    break;
-			}
-		    }
-		}
-		return result;
-
-	    } else if (uid == searchUids->xorUid) {
-		/*
-		 * if the previous result was 1
-		 *   then negate the next result
-		 */
-		negate_result = result;
-
-	    } else if (uid == searchUids->endparenUid) {
-		return result;
-/*
- *          } else {
- *               assert(0);
- */
-	    }
-	    looking_for_tag = 1;
+		if (!stack[sp])
+		    pc = instrs[pc].target;
+		else
+		    sp--, pc++;
+		break;
+	    case TEOP_JUMP_TRUE:
+		if (stack[sp])
+		    pc = instrs[pc].target;
+		else
+		    sp--, pc++;
+		break;
 	}
     }
-/*
- *  assert(! looking_for_tag);
- */
+    result = stack[0];
+    STATIC_FREE(stack, int, code->stackDepth);
     return result;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * TagExpr_Candidates --
+ *
+ *	Use a tag index to find every owner (item etc) whose tags might
+ *	match a tag expression. The expression must still be evaluated
+ *	for each owner found since things like "a && !b" only limit
+ *	the search to owners with tag "a".
+ *
+ * Results:
+ *	If the index can't narrow the search (for example, "!a") then
+ *	the result is 0 and every owner must be tested. Otherwise the
+ *	result is 1 and the candidates are appended to the given list,
+ *	each one once.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
 int
-TagExpr_Eval(
+TagExpr_Candidates(
     TagExpr *expr,		/* Info about a tag expression. */
-    TagInfo *tagInfo		/* Tags to test. */
+    Tcl_HashTable *tagIndex,	/* Initialized by TagIndex_Init. */
+    TreePtrList *owners		/* Initialized list to append to. */
     )
 {
-    expr->index = 0;
-    return _TagExpr_Eval(expr, tagInfo);
+    TagExprCode *code = expr->code;
+
+    if (code->empty)
+	return 1;
+    if (code->simple)
+	return TagIndex_Find(tagIndex, &code->uid, 1, owners);
+    if (code->cands == NULL)
+	return 0;
+    return TagIndex_Find(tagIndex, code->cands, code->numCands, owners);
 }
 
 /*
@@ -4488,10 +5274,182 @@ TagExpr_Free(
     TagExpr *expr
     )
 {
-    if (expr->rewritebuffer != expr->staticRWB)
-	ckfree(expr->rewritebuffer);
-    if (expr->uids != expr->staticUids)
-	ckfree((char *) expr->uids);
+    TagExprCode_Free(expr->code);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TagIndex_Init --
+ * TagIndex_Free --
+ *
+ *	Initialize or free a tag index. A tag index maps each tag to
+ *	the set of owners (items etc) that have the tag. Each owner set
+ *	is a Tcl_HashTable with TCL_ONE_WORD_KEYS.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Memory may be allocated or freed.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+TagIndex_Init(
+    Tcl_HashTable *tagIndex	/* Uninitialized hash table. */
+    )
+{
+    Tcl_InitHashTable(tagIndex, TCL_ONE_WORD_KEYS);
+}
+
+void
+TagIndex_Free(
+    Tcl_HashTable *tagIndex	/* Initialized by TagIndex_Init. */
+    )
+{
+    Tcl_HashEntry *hPtr;
+    Tcl_HashSearch search;
+
+    hPtr = Tcl_FirstHashEntry(tagIndex, &search);
+    while (hPtr != NULL) {
+	Tcl_HashTable *owners = (Tcl_HashTable *) Tcl_GetHashValue(hPtr);
+	Tcl_DeleteHashTable(owners);
+	WFREE(owners, Tcl_HashTable);
+	hPtr = Tcl_NextHashEntry(&search);
+    }
+    Tcl_DeleteHashTable(tagIndex);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TagIndex_Add --
+ * TagIndex_Remove --
+ *
+ *	Record that an owner (item etc) gained or lost some tags. These
+ *	should be called along with TagInfo_Add and TagInfo_Remove for
+ *	owners that are indexed. Adding a tag the owner already has,
+ *	or removing one it doesn't have, is harmless.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Memory may be allocated or freed.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+TagIndex_Add(
+    Tcl_HashTable *tagIndex,	/* Initialized by TagIndex_Init. */
+    ClientData owner,		/* Item etc that has the tags. */
+    Tk_Uid tags[],		/* Tags to add. */
+    int numTags			/* Number of tags in tags[]. */
+    )
+{
+    Tcl_HashTable *owners;
+    Tcl_HashEntry *hPtr;
+    int i, isNew;
+
+    for (i = 0; i < numTags; i++) {
+	hPtr = Tcl_CreateHashEntry(tagIndex, tags[i], &isNew);
+	if (isNew) {
+	    owners = (Tcl_HashTable *) ckalloc(sizeof(Tcl_HashTable));
+	    Tcl_InitHashTable(owners, TCL_ONE_WORD_KEYS);
+	    Tcl_SetHashValue(hPtr, (ClientData) owners);
+	} else {
+	    owners = (Tcl_HashTable *) Tcl_GetHashValue(hPtr);
+	}
+	(void) Tcl_CreateHashEntry(owners, (char *) owner, &isNew);
+    }
+}
+
+void
+TagIndex_Remove(
+    Tcl_HashTable *tagIndex,	/* Initialized by TagIndex_Init. */
+    ClientData owner,		/* Item etc that had the tags. */
+    Tk_Uid tags[],		/* Tags to remove. */
+    int numTags			/* Number of tags in tags[]. */
+    )
+{
+    Tcl_HashTable *owners;
+    Tcl_HashEntry *hPtr, *hPtr2;
+    int i;
+
+    for (i = 0; i < numTags; i++) {
+	hPtr = Tcl_FindHashEntry(tagIndex, tags[i]);
+	if (hPtr == NULL)
+	    continue;
+	owners = (Tcl_HashTable *) Tcl_GetHashValue(hPtr);
+	hPtr2 = Tcl_FindHashEntry(owners, (char *) owner);
+	if (hPtr2 == NULL)
+	    continue;
+	Tcl_DeleteHashEntry(hPtr2);
+	if (owners->numEntries == 0) {
+	    Tcl_DeleteHashTable(owners);
+	    WFREE(owners, Tcl_HashTable);
+	    Tcl_DeleteHashEntry(hPtr);
+	}
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TagIndex_Find --
+ *
+ *	Append to a list every owner (item etc) that has at least one
+ *	of the given tags. Each owner is appended once.
+ *
+ * Results:
+ *	Returns 1.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+TagIndex_Find(
+    Tcl_HashTable *tagIndex,	/* Initialized by TagIndex_Init. */
+    Tk_Uid tags[],		/* Tags to look for. */
+    int numTags,		/* Number of tags in tags[]. */
+    TreePtrList *owners		/* Initialized list to append to. */
+    )
+{
+    Tcl_HashTable *staticSets[STATIC_SIZE], **sets = staticSets;
+    Tcl_HashEntry *hPtr;
+    Tcl_HashSearch search;
+    ClientData owner;
+    int i, j, numSets = 0;
+
+    STATIC_ALLOC(sets, Tcl_HashTable *, numTags);
+    for (i = 0; i < numTags; i++) {
+	hPtr = Tcl_FindHashEntry(tagIndex, tags[i]);
+	if (hPtr != NULL)
+	    sets[numSets++] = (Tcl_HashTable *) Tcl_GetHashValue(hPtr);
+    }
+    for (i = 0; i < numSets; i++) {
+	hPtr = Tcl_FirstHashEntry(sets[i], &search);
+	while (hPtr != NULL) {
+	    owner = (ClientData) Tcl_GetHashKey(sets[i], hPtr);
+
+	    /* Skip owners already found via a previous tag. */
+	    for (j = 0; j < i; j++) {
+		if (Tcl_FindHashEntry(sets[j], (char *) owner) != NULL)
+		    break;
+	    }
+	    if (j == i)
+		TreePtrList_Append(owners, owner);
+	    hPtr = Tcl_NextHashEntry(&search);
+	}
+    }
+    STATIC_FREE(sets, Tcl_HashTable *, numTags);
+    return 1;
 }
 
 /*
@@ -4824,6 +5782,20 @@ PerStateCO_Init(
 static CONST char *DynamicOptionUid = "DynamicOption";
 #endif
 
+/*
+ * The first record in a non-empty list of dynamic options is an index whose
+ * data is an array of DO_SLOTS pointers. Each slot points to the most-recently
+ * created record whose id has the same low bits, so finding an option takes
+ * one lookup unless two ids of the same element type share a slot. Records
+ * with the same slot that were created earlier follow it in the list.
+ */
+#define DOID_INDEX 0
+#define DO_SLOTS 16
+#define DO_SLOT(id) ((id) & (DO_SLOTS - 1))
+#define DO_INDEX(first) ((DynamicOption **) (first)->data)
+#define DO_INDEX_SIZE (Tk_Offset(DynamicOption, data) + \
+    sizeof(DynamicOption *) * DO_SLOTS)
+
 /*
  *----------------------------------------------------------------------
  *
@@ -4846,8 +5818,11 @@ DynamicOption_Find(
     int id			/* Unique id. */
     )
 {
-    DynamicOption *opt = first;
+    DynamicOption *opt;
 
+    if (first == NULL)
+	return NULL;
+    opt = DO_INDEX(first)[DO_SLOT(id)];
     while (opt != NULL) {
 	if (opt->id == id)
 	    return opt;
@@ -4914,12 +5889,22 @@ DynamicOption_AllocIfNeeded(
 				 * data. May be NULL. */
     )
 {
-    DynamicOption *opt = *firstPtr;
+    DynamicOption *first = *firstPtr, *opt;
 
-    while (opt != NULL) {
-	if (opt->id == id)
-	    return opt;
-	opt = opt->next;
+    opt = DynamicOption_Find(first, id);
+    if (opt != NULL)
+	return opt;
+    if (first == NULL) {
+#ifdef ALLOC_HAX
+	first = (DynamicOption *) TreeAlloc_Alloc(tree->allocData,
+		DynamicOptionUid, DO_INDEX_SIZE);
+#else
+	first = (DynamicOption *) ckalloc(DO_INDEX_SIZE);
+#endif
+	first->id = DOID_INDEX;
+	first->next = NULL;
+	memset(first->data, '\0', sizeof(DynamicOption *) * DO_SLOTS);
+	*firstPtr = first;
     }
 #ifdef DEBUG_DYNAMIC
 dbwin("DynamicOption_AllocIfNeeded allocated id=%d\n", id);
@@ -4934,8 +5919,9 @@ dbwin("DynamicOption_AllocIfNeeded allocated id=%d\n", id);
     memset(opt->data, '\0', size);
     if (init != NULL)
 	(*init)(opt->data);
-    opt->next = *firstPtr;
-    *firstPtr = opt;
+    opt->next = first->next;
+    first->next = opt;
+    DO_INDEX(first)[DO_SLOT(id)] = opt;
     return opt;
 }
 
@@ -5290,11 +6276,14 @@ DynamicOption_Free(
     Tk_OptionSpec *optionTable
     )
 {
-    DynamicOption *opt = first;
+    DynamicOption *opt;
     DynamicCOClientData *cd;
     Tk_ObjCustomOption *co;
     int i;
 
+    if (first == NULL)
+	return;
+    opt = first->next;
     while (opt != NULL) {
 	DynamicOption *next = opt->next;
 	for (i = 0; optionTable[i].type != TK_OPTION_END; i++) {
@@ -5320,6 +6309,12 @@ DynamicOption_Free(
 	}
 	opt = next;
     }
+#ifdef ALLOC_HAX
+    TreeAlloc_Free(tree->allocData, DynamicOptionUid, (char *) first,
+	    DO_INDEX_SIZE);
+#else
+    ckfree((char *) first);
+#endif
 }
 
 /*
@@ -5348,25 +6343,45 @@ DynamicOption_Free1(
     int size
     )
 {
-    DynamicOption *opt = *firstPtr, *prev = NULL;
+    DynamicOption *first = *firstPtr, *opt, *prev = first, **slotPtr;
 
+    if (first == NULL)
+	return;
+    opt = first->next;
     while (opt != NULL) {
 	if (opt->id == id) {
-	    if (prev == NULL)
-		*firstPtr = opt->next;
-	    else
-		prev->next = opt->next;
+	    prev->next = opt->next;
+
+	    /* Point the slot at the next record with the same slot. */
+	    slotPtr = &DO_INDEX(first)[DO_SLOT(id)];
+	    if (*slotPtr == opt) {
+		*slotPtr = opt->next;
+		while ((*slotPtr != NULL) &&
+			(DO_SLOT((*slotPtr)->id) != DO_SLOT(id)))
+		    *slotPtr = (*slotPtr)->next;
+	    }
 #ifdef ALLOC_HAX
 	    TreeAlloc_Free(tree->allocData, DynamicOptionUid, (char *) opt,
 		    Tk_Offset(DynamicOption, data) + size);
 #else
 	    ckfree((char *) opt);
 #endif
-	    return;
+	    break;
 	}
 	prev = opt;
 	opt = opt->next;
     }
+
+    /* Free the index when the last record is gone. */
+    if (first->next == NULL) {
+#ifdef ALLOC_HAX
+	TreeAlloc_Free(tree->allocData, DynamicOptionUid, (char *) first,
+		DO_INDEX_SIZE);
+#else
+	ckfree((char *) first);
+#endif
+	*firstPtr = NULL;
+    }
 }
 
 /*